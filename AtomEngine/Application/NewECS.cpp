@@ -14,11 +14,14 @@
 #include <GLM/gtx/rotate_vector.hpp>
 #include "RigidBodyComponent.h"
 #include "BoundingVolumeHeirarchy.h"
+#include "NarrowPhaseDispatcher.h"
 
 
 NewECS::NewECS() :
 m_renderMeshSystem(m_instanceRenderer),
-m_renderDebugSystem(m_debugRenderer)
+m_renderDebugSystem(m_debugRenderer),
+m_contactSolver(m_collisionDetection),
+m_islandSystem(m_collisionDetection)
 {
     JobSystem::Instance();
 }
@@ -99,9 +102,15 @@ bool NewECS::Initialize()
     m_renderPipeline.AddSystem(&m_renderDebugSystem);
 
     m_physicsSystems.AddSystem(&m_physicsMovementSystem);
+    m_physicsSystems.AddSystem(&m_broadPhaseHintSystem);
     m_collisionDetection.SetBroadPhase<BoundingVolumeHeirarchy>(&m_debugRenderer);
-    m_collisionDetection.SetNarrowPhase<GJK>();
+    m_collisionDetection.SetNarrowPhase<NarrowPhaseDispatcher>();
     m_physicsSystems.AddSystem(&m_collisionDetection);
+    m_ecs.AddListener(&m_collisionDetection);
+    //Contacts are solved after detection, ready for the next step's integration.
+    m_physicsSystems.AddSystem(&m_contactSolver);
+    //Islands are built from the solved velocities, so resting bodies can sleep before the next step.
+    m_physicsSystems.AddSystem(&m_islandSystem);
 
     GUI::Instance()->SetRenderDebugSystem(&m_renderDebugSystem);
     GUI::Instance()->SetCollisionDetectionSystem(&m_collisionDetection);
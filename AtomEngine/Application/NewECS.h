@@ -10,9 +10,12 @@
 #include "PostRenderer.h"
 #include "SkyboxRenderer.h"
 #include "PhysicsMovementSystem.h"
+#include "BroadPhaseHintSystem.h"
 #include "DebugRenderer.h"
 #include "RenderDebugSystem.h"
 #include "CollisionDetectionSystem.h"
+#include "ContactSolverSystem.h"
+#include "IslandSystem.h"
 
 class NewECS : public State
 {
@@ -47,7 +50,10 @@ public:
     RenderMeshSystem m_renderMeshSystem;
     RenderDebugSystem m_renderDebugSystem;
     PhysicsMovementSystem m_physicsMovementSystem;
+    BroadPhaseHintSystem m_broadPhaseHintSystem;
     CollisionDetectionSystem m_collisionDetection;
+    ContactSolverSystem m_contactSolver;
+    IslandSystem m_islandSystem;
 
     ECSSystemList m_renderPipeline;
     ECSSystemList m_physicsSystems;
@@ -0,0 +1,85 @@
+#include "MemoryTracker.h"
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+    std::atomic<size_t> s_currentBytes{ 0 };
+    std::atomic<size_t> s_peakBytes{ 0 };
+
+    //Each block starts with its size, padded so the memory handed out keeps the default alignment.
+    constexpr size_t HEADER_SIZE = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+
+    void* Allocate(size_t size)
+    {
+        auto block = static_cast<unsigned char*>(std::malloc(size + HEADER_SIZE));
+        if(!block) {
+            return nullptr;
+        }
+        *reinterpret_cast<size_t*>(block) = size;
+
+        const size_t current = s_currentBytes.fetch_add(size) + size;
+        size_t peak = s_peakBytes.load();
+        while(current > peak && !s_peakBytes.compare_exchange_weak(peak, current)) {}
+
+        return block + HEADER_SIZE;
+    }
+
+    void Free(void* memory)
+    {
+        if(!memory) {
+            return;
+        }
+        auto block = static_cast<unsigned char*>(memory) - HEADER_SIZE;
+        s_currentBytes.fetch_sub(*reinterpret_cast<size_t*>(block));
+        std::free(block);
+    }
+}
+
+namespace MemoryTracker {
+
+    size_t GetCurrentBytes()
+    {
+        return s_currentBytes.load();
+    }
+
+    size_t GetPeakBytes()
+    {
+        return s_peakBytes.load();
+    }
+
+    void ResetPeak()
+    {
+        s_peakBytes.store(s_currentBytes.load());
+    }
+}
+
+void* operator new(size_t size)
+{
+    void* memory = Allocate(size);
+    if(!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    Free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+    Free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    Free(memory);
+}
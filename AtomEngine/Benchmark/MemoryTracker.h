@@ -0,0 +1,28 @@
+/*!
+    * \brief Counts the bytes allocated through operator new by this executable.
+    *
+    * The global operator new and delete are replaced so every allocation made by code compiled into the benchmark
+    * is counted, including the header only broad phases and their containers. The peak can be reset before each run
+    * so it only covers that run.
+*/
+#pragma once
+
+#include <cstddef>
+
+namespace MemoryTracker {
+
+    /*!
+        * \brief Gets the number of bytes currently allocated.
+    */
+    size_t GetCurrentBytes();
+
+    /*!
+        * \brief Gets the largest number of bytes allocated at once since the last reset.
+    */
+    size_t GetPeakBytes();
+
+    /*!
+        * \brief Sets the peak to the number of bytes currently allocated.
+    */
+    void ResetPeak();
+}
@@ -0,0 +1,157 @@
+#include "Scene.h"
+
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+namespace {
+    const float BOX_SPACING = 4.0f;        /*!< Average distance between boxes in the spread out patterns.*/
+    const uint32_t CLUSTER_SIZE = 2000;    /*!< Average number of boxes in each cluster.*/
+    const uint32_t STACK_HEIGHT = 16;      /*!< Number of boxes in each stacked column.*/
+}
+
+Scene::Scene(MotionPattern pattern, uint32_t count, uint32_t seed, float staticFraction) :
+    m_pattern(pattern),
+    m_staticCount(static_cast<uint32_t>(count * glm::clamp(staticFraction, 0.0f, 1.0f)))
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> size(0.5f, 1.5f);
+
+    m_halfSize = 0.5f * BOX_SPACING * std::cbrt(static_cast<float>(count));
+
+    m_transforms.resize(count);
+    m_origins.resize(count);
+    m_velocities.resize(count);
+
+    //Every AABB is built around a unit box and scaled by its transform.
+    m_aabbs.reserve(count);
+    for(uint32_t i = 0; i < count; i++) {
+        m_aabbs.emplace_back(glm::vec3(-0.5f), glm::vec3(0.5f));
+    }
+
+    switch(pattern) {
+        case UNIFORM:
+        case FAST: {
+            //Fast boxes move 30 to 60 units a second, about half a box each step at 60Hz.
+            const float minSpeed = pattern == FAST ? 30.0f : 0.0f;
+            const float maxSpeed = pattern == FAST ? 60.0f : 2.0f;
+            std::uniform_real_distribution<float> speed(minSpeed, maxSpeed);
+            for(uint32_t i = 0; i < count; i++) {
+                m_origins[i] = glm::vec3(unit(random), unit(random), unit(random)) * m_halfSize;
+                m_transforms[i].SetScale(glm::vec3(size(random), size(random), size(random)));
+                glm::vec3 direction(unit(random), unit(random), unit(random));
+                if(glm::length(direction) < 0.001f) {
+                    direction = glm::vec3(1.0f, 0.0f, 0.0f);
+                }
+                m_velocities[i] = glm::normalize(direction) * speed(random);
+            }
+            break;
+        }
+        case CLUSTERED: {
+            const uint32_t clusterCount = (std::max)(1u, count / CLUSTER_SIZE);
+            std::vector<glm::vec3> centres(clusterCount);
+            for(auto& centre : centres) {
+                centre = glm::vec3(unit(random), unit(random), unit(random)) * m_halfSize * 0.8f;
+            }
+
+            //Clusters are about as dense as touching boxes.
+            std::normal_distribution<float> spread(0.0f, std::cbrt(static_cast<float>(CLUSTER_SIZE)) * 0.5f);
+            for(uint32_t i = 0; i < count; i++) {
+                const glm::vec3& centre = centres[random() % clusterCount];
+                const glm::vec3 position = centre + glm::vec3(spread(random), spread(random), spread(random));
+                m_origins[i] = glm::clamp(position, glm::vec3(-m_halfSize), glm::vec3(m_halfSize));
+                m_transforms[i].SetScale(glm::vec3(size(random), size(random), size(random)));
+                m_velocities[i] = glm::vec3(unit(random), unit(random), unit(random));
+            }
+            break;
+        }
+        case STACKED: {
+            //Columns of unit boxes resting on each other, laid out on a square grid.
+            const uint32_t columns = (count + STACK_HEIGHT - 1) / STACK_HEIGHT;
+            const uint32_t rows = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(columns))));
+            const float columnSpacing = 1.5f;
+            const float width = rows * columnSpacing;
+            m_halfSize = (std::max)(width, static_cast<float>(STACK_HEIGHT)) * 0.5f + 1.0f;
+
+            for(uint32_t i = 0; i < count; i++) {
+                const uint32_t column = i / STACK_HEIGHT;
+                const uint32_t level = i % STACK_HEIGHT;
+                m_origins[i] = glm::vec3((column % rows) * columnSpacing - width * 0.5f,
+                                         level - STACK_HEIGHT * 0.5f + 0.5f,
+                                         (column / rows) * columnSpacing - width * 0.5f);
+                //A random phase so the jitter is not in step.
+                m_velocities[i] = glm::vec3(unit(random), unit(random), unit(random)) * 3.14159f;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    for(uint32_t i = 0; i < count; i++) {
+        m_transforms[i].SetPosition(m_origins[i]);
+        m_aabbs[i].SetStatic(i < m_staticCount);
+        Recalculate(i);
+    }
+}
+
+void Scene::Step(float deltaTime)
+{
+    m_time += deltaTime;
+
+    for(uint32_t i = m_staticCount; i < m_aabbs.size(); i++) {
+        if(m_pattern == STACKED) {
+            //Resting contacts only shift by a fraction of a box.
+            const glm::vec3& phase = m_velocities[i];
+            const glm::vec3 jitter(std::sin(m_time * 5.0f + phase.x), std::sin(m_time * 5.0f + phase.y), std::sin(m_time * 5.0f + phase.z));
+            m_transforms[i].SetPosition(m_origins[i] + jitter * 0.01f);
+        }
+        else {
+            //Bounce off the walls so the boxes stay inside the world.
+            glm::vec3 position = m_transforms[i].GetPosition() + m_velocities[i] * deltaTime;
+            for(int axis = 0; axis < 3; axis++) {
+                if(position[axis] < -m_halfSize || position[axis] > m_halfSize) {
+                    m_velocities[i][axis] = -m_velocities[i][axis];
+                    position[axis] = glm::clamp(position[axis], -m_halfSize, m_halfSize);
+                }
+            }
+            m_transforms[i].SetPosition(position);
+            //Hint the broad phase with how far the box will move next step.
+            m_aabbs[i].SetDisplacement(m_velocities[i] * deltaTime);
+        }
+        Recalculate(i);
+    }
+}
+
+const char* Scene::GetPatternName(MotionPattern pattern)
+{
+    switch(pattern) {
+        case UNIFORM:
+            return "uniform";
+        case CLUSTERED:
+            return "clustered";
+        case STACKED:
+            return "stacked";
+        case FAST:
+            return "fast";
+        default:
+            return "unknown";
+    }
+}
+
+bool Scene::ParsePattern(const std::string& name, MotionPattern& pattern)
+{
+    for(int i = 0; i < PATTERN_COUNT; i++) {
+        if(name == GetPatternName(static_cast<MotionPattern>(i))) {
+            pattern = static_cast<MotionPattern>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scene::Recalculate(uint32_t index)
+{
+    m_aabbs[index].RecalculateAABB(&m_transforms[index], nullptr);
+}
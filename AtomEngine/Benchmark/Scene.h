@@ -0,0 +1,72 @@
+/*!
+    * \class Scene "Scene.h"
+    * \brief A reproducible set of moving boxes to drive a broad phase with.
+    *
+    * Every box has a transform and an AABB built from a unit box, and the AABB is recalculated from the transform
+    * each step the same way the collision detection system does it. The same pattern, count and seed always give
+    * the same boxes and the same motion.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <GLM/glm.hpp>
+
+#include "AABB.h"
+#include "POD_Transform.h"
+
+/*!
+    * \enum MotionPattern
+    * How the boxes are laid out and how they move.
+*/
+enum MotionPattern {
+    UNIFORM = 0,    /*!< Spread evenly through the world, drifting slowly.*/
+    CLUSTERED,      /*!< Packed into dense clusters, drifting slowly.*/
+    STACKED,        /*!< Stacked in resting columns that only jitter.*/
+    FAST,           /*!< Spread evenly, moving around half a box per step.*/
+    PATTERN_COUNT
+};
+
+class Scene
+{
+public:
+    /*!
+        * \brief Builds the boxes for a pattern.
+        * \param pattern The layout and motion of the boxes.
+        * \param count The number of boxes.
+        * \param seed The seed for the random layout.
+        * \param staticFraction The fraction of boxes that are flagged static and never move.
+    */
+    Scene(MotionPattern pattern, uint32_t count, uint32_t seed, float staticFraction = 0.0f);
+    ~Scene() = default;
+
+    /*!
+        * \brief Moves every box and recalculates its AABB.
+        * \param deltaTime The time step in seconds.
+    */
+    void Step(float deltaTime);
+
+    std::vector<AABB>& GetAABBs() { return m_aabbs; }
+
+    /*!
+        * \brief Gets the half size of the cube centred on the origin that holds every box.
+    */
+    float GetHalfSize() const { return m_halfSize; }
+
+    static const char* GetPatternName(MotionPattern pattern);
+    static bool ParsePattern(const std::string& name, MotionPattern& pattern);
+
+private:
+    MotionPattern m_pattern;
+    uint32_t m_staticCount;     /*!< The first boxes are static.*/
+    float m_halfSize;
+    float m_time = 0.0f;
+
+    std::vector<AABB> m_aabbs;
+    std::vector<POD_Transform> m_transforms;
+    std::vector<glm::vec3> m_origins;       /*!< Where each box started, used by the stacked pattern.*/
+    std::vector<glm::vec3> m_velocities;
+
+    void Recalculate(uint32_t index);
+};
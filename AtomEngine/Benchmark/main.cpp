@@ -0,0 +1,327 @@
+/*!
+    * Headless benchmark of every broad phase.
+    *
+    * Each broad phase is driven by the same reproducible scenes over a range of box counts, and the average time
+    * of Update and CalculatePairs per frame, the checks made, the proxies reinserted, the pairs found and the peak
+    * memory of each run are written out as CSV or JSON. No window or GL context is created.
+    *
+    * Usage: Benchmark [options]
+    *   --broadphase all|brute,sap,grid,octree,bvh   Broad phases to run (default all).
+    *   --pattern all|uniform,clustered,stacked,fast  Motion patterns to run (default all).
+    *   --counts 1000,10000,100000,1000000           Box counts to run (default 1k, 10k, 100k and 1M).
+    *   --frames 30                                  Frames measured for each run.
+    *   --warmup 5                                   Frames run before measuring.
+    *   --brute-max 20000                            Largest count brute force is run at.
+    *   --seed 1                                     Seed for the scene layout.
+    *   --static 0.9                                 Fraction of boxes that are static (default 0).
+    *   --csv file                                   Write CSV results to a file.
+    *   --json file                                  Write JSON results to a file.
+    * With no output file the CSV is written to the console.
+*/
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <functional>
+
+#include "BroadPhase.h"
+#include "BruteForce.h"
+#include "SweepAndPrune.h"
+#include "SpatialHashGrid.h"
+#include "Octree.h"
+#include "BoundingVolumeHeirarchy.h"
+#include "PairManager.h"
+
+#include "Scene.h"
+#include "MemoryTracker.h"
+
+namespace {
+
+    const float TIME_STEP = 1.0f / 60.0f;
+
+    struct Options
+    {
+        std::vector<std::string> broadPhases = { "brute", "sap", "grid", "octree", "bvh" };
+        std::vector<MotionPattern> patterns = { UNIFORM, CLUSTERED, STACKED, FAST };
+        std::vector<uint32_t> counts = { 1000, 10000, 100000, 1000000 };
+        uint32_t frames = 30;
+        uint32_t warmup = 5;
+        uint32_t bruteMax = 20000;
+        uint32_t seed = 1;
+        float staticFraction = 0.0f;
+        std::string csvPath;
+        std::string jsonPath;
+    };
+
+    struct Result
+    {
+        std::string broadPhase;
+        std::string pattern;
+        uint32_t count;
+        uint32_t frames;
+        double buildNs;         /*!< Time to add every box and run the first update.*/
+        double updateNs;        /*!< Average time of Update per frame.*/
+        double pairsNs;         /*!< Average time of CalculatePairs per frame, including the pair manager.*/
+        double checks;          /*!< Average checks made per frame.*/
+        double reinserts;       /*!< Average proxies reinserted per frame.*/
+        double pairs;           /*!< Average pairs found per frame.*/
+        size_t peakBytes;       /*!< Most memory allocated at once during the run, not counting the scene.*/
+    };
+
+    std::vector<std::string> Split(const std::string& list)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        std::string item;
+        while(std::getline(stream, item, ',')) {
+            if(!item.empty()) {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for(int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if(i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                return false;
+            }
+            const std::string value = argv[++i];
+
+            if(arg == "--broadphase") {
+                if(value != "all") {
+                    options.broadPhases = Split(value);
+                }
+            }
+            else if(arg == "--pattern") {
+                if(value != "all") {
+                    options.patterns.clear();
+                    for(const auto& name : Split(value)) {
+                        MotionPattern pattern;
+                        if(!Scene::ParsePattern(name, pattern)) {
+                            std::cerr << "Unknown pattern " << name << std::endl;
+                            return false;
+                        }
+                        options.patterns.push_back(pattern);
+                    }
+                }
+            }
+            else if(arg == "--counts") {
+                options.counts.clear();
+                for(const auto& count : Split(value)) {
+                    options.counts.push_back(static_cast<uint32_t>(std::stoul(count)));
+                }
+            }
+            else if(arg == "--frames") {
+                options.frames = (std::max)(1u, static_cast<uint32_t>(std::stoul(value)));
+            }
+            else if(arg == "--warmup") {
+                options.warmup = static_cast<uint32_t>(std::stoul(value));
+            }
+            else if(arg == "--brute-max") {
+                options.bruteMax = static_cast<uint32_t>(std::stoul(value));
+            }
+            else if(arg == "--seed") {
+                options.seed = static_cast<uint32_t>(std::stoul(value));
+            }
+            else if(arg == "--static") {
+                options.staticFraction = std::stof(value);
+            }
+            else if(arg == "--csv") {
+                options.csvPath = value;
+            }
+            else if(arg == "--json") {
+                options.jsonPath = value;
+            }
+            else {
+                std::cerr << "Unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*!
+        * \brief Makes a broad phase by name.
+        * \return Returns the broad phase, or nullptr if the name is unknown.
+    */
+    std::unique_ptr<BroadPhase> MakeBroadPhase(const std::string& name, const Scene& scene)
+    {
+        if(name == "brute") {
+            return std::make_unique<BruteForce>(nullptr);
+        }
+        if(name == "sap") {
+            return std::make_unique<SweepAndPrune>(nullptr);
+        }
+        if(name == "grid") {
+            return std::make_unique<SpatialHashGrid>(nullptr);
+        }
+        if(name == "octree") {
+            //The octree needs to know the size of the world up front.
+            return std::make_unique<Octree>(nullptr, glm::vec3(0.0f), scene.GetHalfSize() + 2.0f);
+        }
+        if(name == "bvh") {
+            return std::make_unique<BoundingVolumeHeirarchy>(nullptr);
+        }
+        return nullptr;
+    }
+
+    double ElapsedNs(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+    {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    bool Run(const std::string& name, MotionPattern pattern, uint32_t count, const Options& options, Result& result)
+    {
+        Scene scene(pattern, count, options.seed, options.staticFraction);
+
+        //Only count memory used by the broad phase and the pair manager.
+        const size_t baseBytes = MemoryTracker::GetCurrentBytes();
+        MemoryTracker::ResetPeak();
+
+        auto broadPhase = MakeBroadPhase(name, scene);
+        if(!broadPhase) {
+            return false;
+        }
+        PairManager pairs;
+
+        auto start = std::chrono::steady_clock::now();
+        for(AABB& aabb : scene.GetAABBs()) {
+            broadPhase->Add(&aabb);
+        }
+        broadPhase->Update();
+        auto end = std::chrono::steady_clock::now();
+
+        result.broadPhase = name;
+        result.pattern = Scene::GetPatternName(pattern);
+        result.count = count;
+        result.frames = options.frames;
+        result.buildNs = ElapsedNs(start, end);
+        result.updateNs = 0.0;
+        result.pairsNs = 0.0;
+        result.checks = 0.0;
+        result.reinserts = 0.0;
+        result.pairs = 0.0;
+
+        for(uint32_t frame = 0; frame < options.warmup + options.frames; frame++) {
+            scene.Step(TIME_STEP);
+
+            start = std::chrono::steady_clock::now();
+            broadPhase->Update();
+            const auto updated = std::chrono::steady_clock::now();
+            pairs.BeginFrame();
+            broadPhase->CalculatePairs(pairs);
+            pairs.EndFrame();
+            end = std::chrono::steady_clock::now();
+
+            if(frame >= options.warmup) {
+                result.updateNs += ElapsedNs(start, updated);
+                result.pairsNs += ElapsedNs(updated, end);
+                result.checks += broadPhase->GetChecksMade();
+                result.reinserts += broadPhase->GetReinsertsMade();
+                result.pairs += static_cast<double>(pairs.GetPairCount());
+            }
+        }
+
+        result.updateNs /= options.frames;
+        result.pairsNs /= options.frames;
+        result.checks /= options.frames;
+        result.reinserts /= options.frames;
+        result.pairs /= options.frames;
+
+        const size_t peakBytes = MemoryTracker::GetPeakBytes();
+        result.peakBytes = peakBytes > baseBytes ? peakBytes - baseBytes : 0;
+        return true;
+    }
+
+    void WriteCSV(std::ostream& out, const std::vector<Result>& results)
+    {
+        out << "broadphase,pattern,count,frames,build_ns,update_ns,pairs_ns,total_ns,checks,reinserts,pairs,peak_bytes\n";
+        for(const auto& r : results) {
+            out << r.broadPhase << ',' << r.pattern << ',' << r.count << ',' << r.frames << ','
+                << static_cast<uint64_t>(r.buildNs) << ',' << static_cast<uint64_t>(r.updateNs) << ','
+                << static_cast<uint64_t>(r.pairsNs) << ',' << static_cast<uint64_t>(r.updateNs + r.pairsNs) << ','
+                << static_cast<uint64_t>(r.checks) << ',' << static_cast<uint64_t>(r.reinserts) << ','
+                << static_cast<uint64_t>(r.pairs) << ','
+                << r.peakBytes << '\n';
+        }
+    }
+
+    void WriteJSON(std::ostream& out, const std::vector<Result>& results)
+    {
+        out << "[\n";
+        for(size_t i = 0; i < results.size(); i++) {
+            const auto& r = results[i];
+            out << "  {\"broadphase\": \"" << r.broadPhase << "\", \"pattern\": \"" << r.pattern << "\""
+                << ", \"count\": " << r.count << ", \"frames\": " << r.frames
+                << ", \"build_ns\": " << static_cast<uint64_t>(r.buildNs)
+                << ", \"update_ns\": " << static_cast<uint64_t>(r.updateNs)
+                << ", \"pairs_ns\": " << static_cast<uint64_t>(r.pairsNs)
+                << ", \"total_ns\": " << static_cast<uint64_t>(r.updateNs + r.pairsNs)
+                << ", \"checks\": " << static_cast<uint64_t>(r.checks)
+                << ", \"reinserts\": " << static_cast<uint64_t>(r.reinserts)
+                << ", \"pairs\": " << static_cast<uint64_t>(r.pairs)
+                << ", \"peak_bytes\": " << r.peakBytes << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "]\n";
+    }
+
+    bool WriteFile(const std::string& path, const std::vector<Result>& results, const std::function<void(std::ostream&, const std::vector<Result>&)>& write)
+    {
+        std::ofstream file(path);
+        if(!file) {
+            std::cerr << "Could not open " << path << std::endl;
+            return false;
+        }
+        write(file, results);
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+
+    Options options;
+    if(!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    std::vector<Result> results;
+    for(uint32_t count : options.counts) {
+        for(MotionPattern pattern : options.patterns) {
+            for(const auto& name : options.broadPhases) {
+                //Brute force is quadratic, so it is skipped for large counts.
+                if(name == "brute" && count > options.bruteMax) {
+                    continue;
+                }
+
+                std::cerr << name << " " << Scene::GetPatternName(pattern) << " " << count << "..." << std::endl;
+                Result result;
+                if(!Run(name, pattern, count, options, result)) {
+                    std::cerr << "Unknown broadphase " << name << std::endl;
+                    return 1;
+                }
+                results.push_back(result);
+            }
+        }
+    }
+
+    bool written = true;
+    if(!options.csvPath.empty()) {
+        written &= WriteFile(options.csvPath, results, WriteCSV);
+    }
+    if(!options.jsonPath.empty()) {
+        written &= WriteFile(options.jsonPath, results, WriteJSON);
+    }
+    if(options.csvPath.empty() && options.jsonPath.empty()) {
+        WriteCSV(std::cout, results);
+    }
+
+    return written ? 0 : 1;
+}
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <array>
+#include <cmath>
+#include <algorithm>
 #include <GLM/glm.hpp>
+#include <GLM/gtc/quaternion.hpp>
 
 #include "POD_Transform.h"
 #include "POD_Mesh.h"
@@ -19,6 +22,9 @@ public:
         COLLIDING
     };
 
+    static constexpr uint32_t NULL_PROXY = 0xFFFFFFFF; /*!< Proxy value for an AABB that is not in a broadphase.*/
+    static constexpr uint32_t NULL_ID = 0xFFFFFFFF;    /*!< Unique ID of an AABB that has never been in a broadphase.*/
+
     AABB(POD_Mesh* meshIn)
     {
         meshIn->GetBounds(m_minBounds, m_maxBounds);
@@ -87,17 +93,54 @@ public:
             if (vertices[i].y < m_minBounds.y) m_minBounds.y = vertices[i].y;
             if (vertices[i].z < m_minBounds.z) m_minBounds.z = vertices[i].z;
         }
+
+        //A continuous AABB covers its whole sweep, so the broad phase pairs it with anything it passed through.
+        if(m_continuous) {
+            POD_Transform start;
+            start.SetPosition(m_sweepPosition);
+            start.SetRotation(m_sweepRotation);
+            start.SetScale(transform->GetScale());
+            vertices = m_vertices;
+            RecalculateOBB(vertices, &start);
+            for(const auto& vertex : vertices) {
+                m_minBounds = glm::min(m_minBounds, vertex);
+                m_maxBounds = glm::max(m_maxBounds, vertex);
+            }
+
+            //Points on a rotating body bow out from the line between their start and end, by at most the sagitta of their arc.
+            const float sagitta = GetBoundingRadius() * (1.0f - std::cos(0.5f * GetSweepAngle()));
+            m_minBounds -= glm::vec3(sagitta);
+            m_maxBounds += glm::vec3(sagitta);
+        }
+    }
+
+    const glm::vec3& GetMinBounds() const {
+        return m_minBounds;
+    }
+
+    const glm::vec3& GetMaxBounds() const {
+        return m_maxBounds;
     }
 
-    glm::vec3 GetExtents() {
+    glm::vec3 GetExtents() const {
         return (m_maxBounds - m_minBounds);
     }
 
-    float GetVolume() {
+    float GetVolume() const {
         glm::vec3 extents = GetExtents();
         return extents.x * extents.y * extents.z;
     }
 
+    /*!
+     * \brief Gets the ID given to the AABB when it last joined a broadphase.
+     *
+     * Unlike its address, the ID stays the same when the ECS moves the component, and it is never reused, so
+     * pairs are keyed on it.
+     */
+    uint32_t GetUniqueID() const {
+        return m_uniqueID;
+    }
+
     bool Collides(AABB* other) {
         return ((other->m_minBounds.y <= m_maxBounds.y && other->m_maxBounds.y >= m_minBounds.y) &&
             (other->m_minBounds.x <= m_maxBounds.x && other->m_maxBounds.x >= m_minBounds.x) &&
@@ -114,10 +157,140 @@ public:
         return ((aabb.m_minBounds >= m_minBounds && aabb.m_maxBounds <= m_maxBounds));
     }
 
+    /*!
+     * \brief Gets the transform set by the last RecalculateAABB.
+     */
+    POD_Transform* GetTransform() const {
+        return m_transform;
+    }
+
+    /*!
+     * \brief Gets the mesh set by the last RecalculateAABB.
+     */
+    POD_Mesh* GetMesh() const {
+        return m_mesh;
+    }
+
     CollisionStatus& IsColliding() {
         return m_collisionStatus;
     }
 
+    /*!
+     * \brief Sets how far the AABB is expected to move over the next step.
+     * \param displacement The expected movement, zero for objects that are not moving.
+     *
+     * This is only a hint, broad phases with padded proxies use it to stretch the padding in the direction of motion.
+     */
+    void SetDisplacement(const glm::vec3& displacement) {
+        m_displacement = displacement;
+    }
+
+    const glm::vec3& GetDisplacement() const {
+        return m_displacement;
+    }
+
+    /*!
+     * \brief Flags the AABB as static, for objects that never move.
+     * \param isStatic Is the AABB static.
+     *
+     * Must be set before the AABB is added to a broad phase, broad phases may keep static AABB's apart
+     * and never pair two static AABB's.
+     */
+    void SetStatic(bool isStatic) {
+        m_static = isStatic;
+    }
+
+    bool IsStatic() const {
+        return m_static;
+    }
+
+    /*!
+     * \brief Flags the AABB as belonging to a sleeping body.
+     * \param isSleeping Is the body asleep.
+     *
+     * Sleeping AABB's are not recalculated or refit, and pairs with nothing awake keep last frame's result.
+     */
+    void SetSleeping(bool isSleeping) {
+        m_sleeping = isSleeping;
+    }
+
+    bool IsSleeping() const {
+        return m_sleeping;
+    }
+
+    /*!
+     * \brief Gets whether the AABB can have moved since last frame, neither static nor asleep.
+     */
+    bool IsMoving() const {
+        return !m_static && !m_sleeping;
+    }
+
+    /*!
+     * \brief Marks the AABB for continuous collision detection over the current step.
+     * \param startPosition The position the transform had at the start of the step.
+     * \param startRotation The rotation the transform had at the start of the step.
+     *
+     * The transform holds the pose at the end of the step. RecalculateAABB then bounds the whole sweep between
+     * the two, and the time of impact is reset to the end of the step.
+     */
+    void SetSweep(const glm::vec3& startPosition, const glm::quat& startRotation) {
+        m_continuous = true;
+        m_sweepPosition = startPosition;
+        m_sweepRotation = glm::normalize(startRotation);
+        m_timeOfImpact = 1.0f;
+    }
+
+    /*!
+     * \brief Stops the AABB using continuous collision detection.
+     */
+    void ClearSweep() {
+        m_continuous = false;
+        m_timeOfImpact = 1.0f;
+    }
+
+    bool IsContinuous() const {
+        return m_continuous;
+    }
+
+    const glm::vec3& GetSweepPosition() const {
+        return m_sweepPosition;
+    }
+
+    const glm::quat& GetSweepRotation() const {
+        return m_sweepRotation;
+    }
+
+    /*!
+     * \brief Gets the angle the transform turns through over the sweep, in radians.
+     */
+    float GetSweepAngle() const {
+        const float cosHalfAngle = std::abs(glm::dot(m_sweepRotation, glm::normalize(m_transform->GetRotation())));
+        return 2.0f * std::acos((std::min)(cosHalfAngle, 1.0f));
+    }
+
+    /*!
+     * \brief Gets the furthest any point of the mesh bounds is from the transform's position, at its current scale.
+     */
+    float GetBoundingRadius() const {
+        const glm::vec3 scale = m_transform->GetScale();
+        float radius = 0.0f;
+        for(const auto& vertex : m_vertices) {
+            radius = (std::max)(radius, glm::length(vertex * scale));
+        }
+        return radius;
+    }
+
+    /*!
+     * \brief Gets the fraction of the step the AABB's transform reached before its first impact, one if it hit nothing.
+     */
+    float GetTimeOfImpact() const {
+        return m_timeOfImpact;
+    }
+
+    void SetTimeOfImpact(float timeOfImpact) {
+        m_timeOfImpact = timeOfImpact;
+    }
+
     static AABB MergeAABB(const AABB& a, const AABB& b) {
         glm::vec3 min;
         glm::vec3 max;
@@ -131,8 +304,14 @@ public:
 
 protected:
 
+    friend class BroadPhase;
     friend class BoundingVolumeHeirarchy;
     friend class BVHNode;
+    friend class SweepAndPrune;
+    friend class SpatialHashGrid;
+    friend class Octree;
+    friend class BruteForce;
+    friend class BoundsStore;
     friend class GJK;
 
     inline void RecalculateOBB(std::array<glm::vec3, 8>& vertices, POD_Transform* transform) {
@@ -153,7 +332,15 @@ protected:
     glm::vec3 m_minBounds;
     glm::vec3 m_maxBounds;
 
-    void* m_containingNode;
+    uint32_t m_proxyID = NULL_PROXY; /*!< Handle of this AABB inside the broadphase that holds it.*/
+    uint32_t m_uniqueID = NULL_ID;  /*!< Given when the AABB joins a broadphase, kept when the ECS moves it and never given to another.*/
+    glm::vec3 m_displacement = glm::vec3(0.0f); /*!< Expected movement over the next step.*/
+    bool m_static = false;  /*!< Static AABB's never move.*/
+    bool m_sleeping = false;    /*!< Sleeping AABB's do not move until their body wakes.*/
+    bool m_continuous = false;  /*!< Is the AABB swept for continuous collision detection.*/
+    glm::vec3 m_sweepPosition = glm::vec3(0.0f);    /*!< Position of the transform at the start of the step.*/
+    glm::quat m_sweepRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);  /*!< Rotation of the transform at the start of the step.*/
+    float m_timeOfImpact = 1.0f;    /*!< Fraction of the step reached before the first impact.*/
     POD_Transform* m_transform;
     POD_Mesh* m_mesh;
 };
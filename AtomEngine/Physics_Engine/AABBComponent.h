@@ -4,8 +4,11 @@
 
 struct AABBComponent : public ECSComponent<AABBComponent>
 {
-    AABBComponent(POD_Mesh* meshIn) :
-        m_aabb(AABB(meshIn)) { }
+    AABBComponent(POD_Mesh* meshIn, bool isStatic = false) :
+        m_aabb(AABB(meshIn))
+    {
+        m_aabb.SetStatic(isStatic);
+    }
 
     AABB m_aabb;
 };
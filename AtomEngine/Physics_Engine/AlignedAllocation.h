@@ -19,6 +19,7 @@
 
 const  size_t BYTE8 = 8; /*!< Constant for aligning memory to 8 Bytes. */
 const  size_t BYTE16 = 16; /*!< Constant for aligning memory to 16 Bytes. */
+const  size_t BYTE32 = 32; /*!< Constant for aligning memory to 32 Bytes. */
 
 template<size_t Alignment>
 class ATOM_API AlignedAllocation
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "POD_Transform.h"
+#include "POD_RigidBody.h"
+#include "AlignedAllocation.h"
+
+/*!
+ * \class BodyStore "BodyStore.h"
+ * \brief Keeps the state integrated each step for many rigid bodies as separate arrays of each value, so they can be integrated several at a time.
+ *
+ * Each array is aligned to 32 bytes and padded to a multiple of 8 entries, so the SIMD kernels can always load
+ * whole registers. Padding entries hold a body at rest with no mass, which integrates to itself.
+ * Bodies are copied in before integrating and back out after, the rigid bodies themselves stay the state every
+ * other system works with.
+ */
+class BodyStore
+{
+public:
+    static constexpr uint32_t WIDTH = 8;    /*!< The array length is always a multiple of this.*/
+
+    /*!
+     * \enum Field
+     * Each value held per body, one array each.
+     */
+    enum Field {
+        POSITION_X = 0,
+        POSITION_Y,
+        POSITION_Z,
+        ROTATION_W,
+        ROTATION_X,
+        ROTATION_Y,
+        ROTATION_Z,
+        LINEAR_MOMENTUM_X,
+        LINEAR_MOMENTUM_Y,
+        LINEAR_MOMENTUM_Z,
+        ANGULAR_MOMENTUM_X,
+        ANGULAR_MOMENTUM_Y,
+        ANGULAR_MOMENTUM_Z,
+        INVERSE_MASS,
+        GRAVITY,                /*!< The momentum gravity adds each second, zero for bodies without gravity.*/
+        INVERSE_INERTIA_XX,     /*!< The inverse inertia tensor in body space, which is symmetric so only six entries are kept.*/
+        INVERSE_INERTIA_XY,
+        INVERSE_INERTIA_XZ,
+        INVERSE_INERTIA_YY,
+        INVERSE_INERTIA_YZ,
+        INVERSE_INERTIA_ZZ,
+        FIELD_COUNT
+    };
+
+    /*!
+     * \brief Default Constructor
+     */
+    BodyStore() = default;
+
+    /*!
+     * \brief Default Destructor
+     */
+    ~BodyStore() {
+        _aligned_free(m_data);
+    }
+
+    BodyStore(const BodyStore&) = delete;
+    BodyStore& operator=(const BodyStore&) = delete;
+
+    /*!
+     * \brief Sets the number of bodies held, keeping the bodies already stored.
+     * \param count The new number of bodies.
+     */
+    void Resize(uint32_t count) {
+        const uint32_t capacity = (count + WIDTH - 1) & ~(WIDTH - 1);
+        if(capacity > m_capacity) {
+            Grow((std::max)(capacity, m_capacity * 2));
+        }
+
+        //Anything past the end is emptied so stale bodies are never integrated.
+        for(uint32_t i = count; i < m_size; i++) {
+            SetEmpty(i);
+        }
+        m_size = count;
+    }
+
+    /*!
+     * \brief Copies a rigid body and its transform into the store.
+     * \param index The slot to write to.
+     * \param transform The transform moved by the body.
+     * \param body The rigid body to copy.
+     */
+    inline void Set(uint32_t index, POD_Transform& transform, const POD_RigidBody& body) {
+        const glm::vec3 position = transform.GetPosition();
+        const glm::quat rotation = transform.GetRotation();
+        const glm::mat3& inverseInertia = body.m_inverseInertiaTensorIntegral;
+
+        m_fields[POSITION_X][index] = position.x;
+        m_fields[POSITION_Y][index] = position.y;
+        m_fields[POSITION_Z][index] = position.z;
+        m_fields[ROTATION_W][index] = rotation.w;
+        m_fields[ROTATION_X][index] = rotation.x;
+        m_fields[ROTATION_Y][index] = rotation.y;
+        m_fields[ROTATION_Z][index] = rotation.z;
+        m_fields[LINEAR_MOMENTUM_X][index] = body.m_linearMomentum.x;
+        m_fields[LINEAR_MOMENTUM_Y][index] = body.m_linearMomentum.y;
+        m_fields[LINEAR_MOMENTUM_Z][index] = body.m_linearMomentum.z;
+        m_fields[ANGULAR_MOMENTUM_X][index] = body.m_angularMomentum.x;
+        m_fields[ANGULAR_MOMENTUM_Y][index] = body.m_angularMomentum.y;
+        m_fields[ANGULAR_MOMENTUM_Z][index] = body.m_angularMomentum.z;
+        m_fields[INVERSE_MASS][index] = 1.0f / body.m_mass;
+        m_fields[GRAVITY][index] = body.m_gravity ? -9.81f * body.m_mass : 0.0f;
+        m_fields[INVERSE_INERTIA_XX][index] = inverseInertia[0][0];
+        m_fields[INVERSE_INERTIA_XY][index] = inverseInertia[0][1];
+        m_fields[INVERSE_INERTIA_XZ][index] = inverseInertia[0][2];
+        m_fields[INVERSE_INERTIA_YY][index] = inverseInertia[1][1];
+        m_fields[INVERSE_INERTIA_YZ][index] = inverseInertia[1][2];
+        m_fields[INVERSE_INERTIA_ZZ][index] = inverseInertia[2][2];
+    }
+
+    /*!
+     * \brief Copies the integrated pose and momentum of a body back out of the store.
+     * \param index The slot to read from.
+     * \param transform Receives the position and rotation.
+     * \param body Receives the momentum.
+     */
+    inline void Get(uint32_t index, POD_Transform& transform, POD_RigidBody& body) const {
+        transform.SetPosition(glm::vec3(m_fields[POSITION_X][index], m_fields[POSITION_Y][index], m_fields[POSITION_Z][index]));
+        transform.SetRotation(glm::quat(m_fields[ROTATION_W][index], m_fields[ROTATION_X][index], m_fields[ROTATION_Y][index], m_fields[ROTATION_Z][index]));
+        body.m_linearMomentum = glm::vec3(m_fields[LINEAR_MOMENTUM_X][index], m_fields[LINEAR_MOMENTUM_Y][index], m_fields[LINEAR_MOMENTUM_Z][index]);
+        body.m_angularMomentum = glm::vec3(m_fields[ANGULAR_MOMENTUM_X][index], m_fields[ANGULAR_MOMENTUM_Y][index], m_fields[ANGULAR_MOMENTUM_Z][index]);
+    }
+
+    /*!
+     * \brief Removes every body, keeping the memory.
+     */
+    void Clear() {
+        Resize(0);
+    }
+
+    inline uint32_t Size() const { return m_size; }
+    inline uint32_t Capacity() const { return m_capacity; }
+
+    inline float* operator[](Field field) { return m_fields[field]; }
+    inline const float* operator[](Field field) const { return m_fields[field]; }
+
+private:
+    float* m_data = nullptr;            /*!< One block holding every array.*/
+    float* m_fields[FIELD_COUNT] = {};  /*!< The start of each array within the block.*/
+    uint32_t m_size = 0;                /*!< Number of bodies held.*/
+    uint32_t m_capacity = 0;            /*!< Length of each array, always a multiple of WIDTH.*/
+
+    inline void SetEmpty(uint32_t index) {
+        for(uint32_t f = 0; f < FIELD_COUNT; f++) {
+            m_fields[f][index] = 0.0f;
+        }
+        m_fields[ROTATION_W][index] = 1.0f;
+    }
+
+    /*!
+     * \brief Reallocates the arrays with a larger capacity.
+     * \param capacity The new length of each array, must be a multiple of WIDTH.
+     */
+    void Grow(uint32_t capacity) {
+        float* data = static_cast<float*>(_aligned_malloc(sizeof(float) * capacity * FIELD_COUNT, BYTE32));
+        for(uint32_t f = 0; f < FIELD_COUNT; f++) {
+            if(m_capacity > 0) {
+                std::memcpy(data + f * capacity, m_fields[f], sizeof(float) * m_capacity);
+            }
+            m_fields[f] = data + f * capacity;
+        }
+        _aligned_free(m_data);
+        m_data = data;
+
+        for(uint32_t i = m_capacity; i < capacity; i++) {
+            SetEmpty(i);
+        }
+        m_capacity = capacity;
+    }
+};
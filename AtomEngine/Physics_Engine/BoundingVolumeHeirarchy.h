@@ -1,137 +1,128 @@
 #pragma once
 #include "BroadPhase.h"
 #include <set>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <cfloat>
 #include "AABB.h"
+#include "ThreadPool.h"
 #include <SDL/SDL_syswm.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 /*!
  * \class BVHNode "BoundingVolumeHeirarchy.h"
  * \brief Node structure for each part of the Bounding Volume Tree.
- * 
- * Allows for the tree structure to be built as each node has a link to parent and child nodes.
- * Each node also has its own AABB that contains child nodes AABB's, and inside the leaf nodes will
+ *
+ * Nodes live inside one contiguous pool owned by the tree and link to each other with 32-bit indices
+ * into that pool rather than pointers, so the whole tree can grow without scattering across the heap.
+ * Each node also has its own bounds that contain child nodes bounds, and inside the leaf nodes will
  * contain the actual AABB's of objects in the simulation.
- * The nodes AABB will contain child nodes inside a tight fitting box, but if the node is a leaf padding is applied
+ * The nodes bounds will contain child nodes inside a tight fitting box, but if the node is a leaf padding is applied
  * so that it is larger than the AABB it contains so there must be significant movement of the object before an update is applied.
+ * The node is padded to exactly one cache line.
  */
-class BVHNode
+class alignas(64) BVHNode
 {
 public:
     //Allow the overall tree structure access to the nodes.
     friend class BoundingVolumeHeirarchy;
 
+    static constexpr uint32_t NULL_NODE = 0xFFFFFFFF; /*!< Index used to represent no node.*/
+
     /*!
      * \brief Default Constructor
      */
     BVHNode() :
-        m_parent(nullptr),
-        m_objectAABB(nullptr)
-    {        
-        m_childNodes[0] = nullptr;
-        m_childNodes[1] = nullptr;
-    }
-
-    /*!
-     * \brief Default Destructor
-     */
-    ~BVHNode()
+        m_minBounds(0.0f),
+        m_maxBounds(0.0f),
+        m_objectAABB(nullptr),
+        m_parent(NULL_NODE),
+        m_height(0)
     {
-        if (m_childNodes[0]) delete m_childNodes[0];
-        if (m_childNodes[1]) delete m_childNodes[1];
+        m_childNodes[0] = NULL_NODE;
+        m_childNodes[1] = NULL_NODE;
     }
 
     /*!
      * \brief Test if node is leaf node or not.
      */
     bool IsLeaf() const {
-        return m_childNodes[0] == nullptr;
+        return m_childNodes[0] == NULL_NODE;
     }
 
     /*!
-     * \brief Clears all pointers from the node for safe deletion.
+     * \brief Gets the extents of the nodes bounds.
      */
-    void Clear() {
-        m_childNodes[0] = nullptr;
-        m_childNodes[1] = nullptr;
-        m_parent = nullptr;
+    glm::vec3 GetExtents() const {
+        return m_maxBounds - m_minBounds;
     }
 
     /*!
-     * \brief Turns the node into a branch node
-     * \param n0 Child Node Pointer to add to this node.
-     * \param n1 Child Node Pointer to add to this node.
-     * 
-     * Adds to children node to this node, sets each of their parents to this node.
+     * \brief Tests if the bounds of this node overlap the bounds of another node.
+     * \param other The node to test against.
      */
-    void MakeNodeIntoBranch(BVHNode* n0, BVHNode* n1) {
-        n0->m_parent = this;
-        n1->m_parent = this;
-
-        m_childNodes[0] = n0;
-        m_childNodes[1] = n1;
+    bool Collides(const BVHNode& other) const {
+        return ((other.m_minBounds.y <= m_maxBounds.y && other.m_maxBounds.y >= m_minBounds.y) &&
+            (other.m_minBounds.x <= m_maxBounds.x && other.m_maxBounds.x >= m_minBounds.x) &&
+            (other.m_minBounds.z <= m_maxBounds.z && other.m_maxBounds.z >= m_minBounds.z));
     }
 
     /*!
-     * \brief Turns the node into a leaf node.
-     * \param data The object AABB to be contained inside this node.
-     * 
-     * Stores the object AABB data inside this node. then sets the AABB containing node pointer
-     * to this node.
-     * After this sets both child nodes to nullptr.
+     * \brief Tests if an object AABB still fits entirely inside this node.
+     * \param aabb The AABB to test.
      */
-    void MakeNodeIntoLeaf(AABB* data) {
-        m_objectAABB = data;
-        data->m_containingNode = this;
+    bool Contains(const AABB& aabb) const {
+        return ((aabb.m_minBounds >= m_minBounds && aabb.m_maxBounds <= m_maxBounds));
+    }
 
-        m_childNodes[0] = nullptr;
-        m_childNodes[1] = nullptr;
+    /*!
+     * \brief Gets the surface area of the nodes bounds.
+     *
+     * The surface area is proportional to the chance of a random ray or box hitting the node,
+     * which is what the surface area heuristic uses as the cost of visiting it.
+     */
+    float GetSurfaceArea() const {
+        return SurfaceArea(m_minBounds, m_maxBounds);
     }
 
     /*!
-     * \brief Updates the nodes AABB
-     * \param margin How much gap to add around the contained object for the nodes AABB
-     * 
-     * If the node is a leaf node, adds the margin as padding around the object.
-     * Else it will merge the two child nodes AABB returning a perfect fitting AABB of the child nodes.
+     * \brief Gets the surface area the merged bounds of two nodes would have.
+     * \param a The first node.
+     * \param b The second node.
      */
-    void UpdateAABB(float margin)
-    {
-        if(IsLeaf()) {
-            const glm::vec3 marginVector(margin);
-            m_nodeAABB.m_minBounds = m_objectAABB->m_minBounds - marginVector;
-            m_nodeAABB.m_maxBounds = m_objectAABB->m_maxBounds + marginVector;
-        }else {
-            m_nodeAABB = AABB::MergeAABB(m_childNodes[0]->m_nodeAABB, m_childNodes[1]->m_nodeAABB);
-        }
+    static float MergedSurfaceArea(const BVHNode& a, const BVHNode& b) {
+        return SurfaceArea(glm::min(a.m_minBounds, b.m_minBounds), glm::max(a.m_maxBounds, b.m_maxBounds));
     }
 
     /*!
-     * \brief Gets the sibling node of the current node.
-     * \return Returns a BVHNode pointer to the sibling node.
-     * 
-     * Gets the parent node and tests which of its child nodes are not equal to this node.
-     * Then returns it.
+     * \brief Gets the surface area of a box.
+     * \param min The minimum corner of the box.
+     * \param max The maximum corner of the box.
      */
-    BVHNode* GetSibling() const {
-        if(this == m_parent->m_childNodes[0]) {
-            return m_parent->m_childNodes[1];
-        }
-        else {
-            return m_parent->m_childNodes[0];
-        }
+    static float SurfaceArea(const glm::vec3& min, const glm::vec3& max) {
+        const glm::vec3 extents = max - min;
+        return 2.0f * (extents.x * extents.y + extents.y * extents.z + extents.z * extents.x);
     }
 
 protected:
-    BVHNode* m_parent;              /*!< Pointer to the parent node.*/
-    BVHNode* m_childNodes[2] = {};  /*!< Two component Array of nodes to children.*/
-
-    AABB m_nodeAABB;                /*!< This nodes AABB.*/
-    AABB* m_objectAABB;             /*!< Pointer to the contained objects AABB.*/
+    glm::vec3 m_minBounds;          /*!< Minimum corner of this nodes bounds.*/
+    glm::vec3 m_maxBounds;          /*!< Maximum corner of this nodes bounds.*/
 
-    bool m_childrenChecked = false; /*!< Flag to see if this node has been checked during queries.*/
+    AABB* m_objectAABB;             /*!< Pointer to the contained objects AABB, nullptr for branches and free nodes.*/
 
+    uint32_t m_parent;              /*!< Index of the parent node. While the node is free this links to the next free node.*/
+    uint32_t m_childNodes[2];       /*!< Indices of the two child nodes.*/
+    int32_t m_height;               /*!< Height of the subtree below this node, leaves are 0.*/
 };
 
+static_assert(sizeof(BVHNode) == 64, "BVHNode should fill exactly one cache line.");
+
 
 /*!
  * \class BoundingVolumeHeirarchy "BoundingVolumeHeirarchy.h"
@@ -139,6 +130,12 @@ protected:
  *
  * Handles the storage of all AABB's in simulation including insertion, deletion and updating them.
  * Allows for collision queries of AABB's vs AABB's in the tree, by testing the AABB against the tree nodes.
+ * All nodes are stored in a single growable pool, released nodes are kept on a free list and reused
+ * so that removing and reinserting leaves never touches the heap once the pool has grown large enough.
+ * New leaves are held back until the next update, a large enough batch rebuilds the whole tree at once
+ * as a linear BVH sorted by Morton code, which is far quicker than inserting each leaf in turn.
+ * AABB's flagged as static go into a second tree that is never refit, and pairs are only found between
+ * two dynamic AABB's or a dynamic and a static AABB, never two static ones.
  */
 class BoundingVolumeHeirarchy : public BroadPhase
 {
@@ -146,10 +143,11 @@ public:
     /*!
      * \brief Default Constructor
      */
-    BoundingVolumeHeirarchy (DebugRenderer* debugRenderer): BroadPhase(debugRenderer), m_root(nullptr)
+    BoundingVolumeHeirarchy (DebugRenderer* debugRenderer): BroadPhase(debugRenderer),
+        m_root(BVHNode::NULL_NODE),
+        m_freeList(BVHNode::NULL_NODE)
     {
         m_debugRenderer = debugRenderer;
-        m_debugCuboid.SetColor(glm::vec3(1, 1, 1));
     }
 
     /*!
@@ -160,173 +158,138 @@ public:
     /*!
      * \brief Removes an AABB from the tree.
      * \param aabb The AABB to remove.
-     * 
-     * Gets the containing node from the "aabb" parameter, and casts it to a BVHNode.
-     * After this sets that node AABB to nullptr, and the "aabb" containing node to nullptr.
-     * Then removes the node from the tree.
+     *
+     * Gets the containing node index from the "aabb" parameter.
+     * After this sets the "aabb" proxy to null, then removes the leaf from the tree and
+     * returns it to the free list.
      */
     void Remove(AABB* aabb) override {
-        BVHNode* node = static_cast<BVHNode*>(aabb->m_containingNode);
+        if(aabb->IsStatic() && !m_isStaticTree) {
+            m_staticTree->Remove(aabb);
+            return;
+        }
+
+        const uint32_t node = aabb->m_proxyID;
 
-        node->m_objectAABB = nullptr;
-        aabb->m_containingNode = nullptr;
+        aabb->m_proxyID = AABB::NULL_PROXY;
+        m_leafCount--;
 
-        RemoveNode(node);
+        //Leaves waiting to be inserted have no parent and are not the root.
+        if(node != m_root && m_nodes[node].m_parent == BVHNode::NULL_NODE) {
+            auto pending = std::find(m_pendingLeaves.begin(), m_pendingLeaves.end(), node);
+            *pending = m_pendingLeaves.back();
+            m_pendingLeaves.pop_back();
+        }
+        else {
+            RemoveLeaf(node);
+        }
+        FreeNode(node);
     }
 
     /*!
-     * \brief Removes a node from the tree.
-     * \param node The node to remove from the tree.
-     * 
-     * Removes a BVHNode from the tree.
+     * \brief Points the leaf of an AABB at its new address.
+     * \param aabb The AABB, which has moved in memory since it was added.
      */
-    void RemoveNode(BVHNode* node) {
-        //Remove node from node list
-        m_nodeList.remove(node);
-        //First get the parent node, of node being removed.
-        BVHNode* parent = node->m_parent;
-        //If there is a parent
-        if(parent) {
-            //Get the sibling of the node being removed.
-            BVHNode* sibling = node->GetSibling();
-            //If the parent has a parent.
-            if(parent->m_parent) {
-                //Set the sibling nodes parent to the grandparent.
-                sibling->m_parent = parent->m_parent;
-                //Find which of the grandparents nodes is the parent.
-                //And replace with sibling
-                if(parent == parent->m_parent->m_childNodes[0]) {
-                    parent->m_parent->m_childNodes[0] = sibling;
-                }
-                else {
-                    parent->m_parent->m_childNodes[1] = sibling;
-                }
-            }
-            //If no grandparent then parent must be root node.
-            else {
-                //Set the root node to be the sibling.
-                m_root = sibling;
-                //Set sibling node to have to parent.
-                sibling->m_parent = nullptr;
-            }
-            //Delete the node being removed.
-            node->Clear();
-            delete node;
-            m_nodeList.remove(node);
-            //Delete the obsolete parent node.
-            parent->Clear();
-            delete parent;
-            m_nodeList.remove(node);
-        }
-        //If node parent node, the this node must be root node.
-        else {
-            //Set root node to nullptr.
-            m_root = nullptr;
-            //Delete this node.
-            delete node;
-            //Tree is empty at this point.
+    void Relocate(AABB* aabb) override {
+        if(aabb->IsStatic() && !m_isStaticTree) {
+            m_staticTree->Relocate(aabb);
+            return;
         }
+        m_nodes[aabb->m_proxyID].m_objectAABB = aabb;
     }
 
     /*!
      * \brief Will clear the tree of all nodes.
-     * 
-     * Removes all nodes from the tree by deleting root node, this will propagate down tree deleting all nodes.
+     *
+     * Releases every node in the pool at once, the pool keeps its memory so the tree can be rebuilt without reallocating.
      */
     void Clear() override {
-        delete m_root;
+        for(BVHNode& node : m_nodes) {
+            if(node.m_objectAABB) {
+                node.m_objectAABB->m_proxyID = AABB::NULL_PROXY;
+            }
+        }
+        m_nodes.clear();
+        m_pendingLeaves.clear();
+        m_root = BVHNode::NULL_NODE;
+        m_freeList = BVHNode::NULL_NODE;
+        m_leafCount = 0;
+
+        if(m_staticTree) {
+            m_staticTree->Clear();
+        }
     }
 
     /*!
      * \brief Updates Tree.
-     * 
+     *
      * Updates the AABB tree so that all AABB's are in the correct parent and of the right size.
+     * Any leaves added since the last update are inserted first.
+     * The static tree only has its new leaves inserted, it is never refit.
      */
     void Update() override {
+        FlushPendingLeaves();
+        if(m_staticTree) {
+            m_staticTree->FlushPendingLeaves();
+        }
+        m_reinsertsMade = 0;
+
         //If root node exists.
-        if(m_root) {
+        if(m_root != BVHNode::NULL_NODE) {
             //Is the root the only node
-            if(m_root->IsLeaf()) {
+            if(m_nodes[m_root].IsLeaf()) {
                 //Update the AABB with margin.
-                m_root->UpdateAABB(m_margin);
+                UpdateAABB(m_root);
             }
             //If root is not only node
             else {
-                //Grab all nodes requiring update
+                //Grab all nodes requiring update, in pool order.
                 m_invalidNodes.clear();
-                FindInvalidNodes(m_root, m_invalidNodes);
-
-                //Reinsert all invalid nodes into tree;
-                for(BVHNode* node : m_invalidNodes) {
-                    //Get parent of invalid node.
-                    BVHNode* parent = node->m_parent;
-                    //Get sibling of invalid node.
-                    BVHNode* sibling = node->GetSibling();
-
-                    BVHNode** parentLink;
-                    //If there is a grandparent.
-                    if(parent->m_parent) {
-                        //Find which of grandparents children is the parent.
-                        if(parent == parent->m_parent->m_childNodes[0]) {
-                            //set the parentLink to be that grandparents child.
-                            parentLink = &parent->m_parent->m_childNodes[0];
-                        }
-                        else {
-                            parentLink = &parent->m_parent->m_childNodes[1];
-                        }
-                        //Set the siblings parent to the grandparent.
-                        sibling->m_parent = parent->m_parent;
-                    }
-                    else {
-                        //If no grandparent then the new parent needs to be the root.
-                        parentLink = &m_root;
-                        //And siblings parent needs to be nullptr.
-                        sibling->m_parent = nullptr;
-                    }
+                FindInvalidNodes(m_invalidNodes);
+
+                //Unlink every invalid leaf first, their old parents go back on the free list.
+                for(uint32_t node : m_invalidNodes) {
+                    RemoveLeaf(node);
+                }
 
-                    //Make the parentLink the sibling
-                    *parentLink = sibling;
-                    //At this point we have removed the node from the tree without deletion
-                    //And the sibling is the new parent node.
-                    //Now the old parent is cleared and deleted as its now useless.
-                    parent->Clear();
-                    delete parent;
-                    m_nodeList.remove(parent);
-
-                    //Set nodes parent to nullptr
-                    node->m_parent = nullptr;
-                    //Update the node so its size is correct for either its child nodes or contained object.
-                    node->UpdateAABB(m_margin);
-                    //Reinsert the node at the top of the tree so it finds its correct place.
-                    //m_nodeList.remove(node);
-                    InsertNode(node, &m_root);
+                //Refit the unlinked leaves, each job only touches its own leaves.
+                const uint32_t invalidCount = static_cast<uint32_t>(m_invalidNodes.size());
+                m_reinsertsMade = static_cast<int>(invalidCount);
+                ParallelFor(invalidCount, GetParallelJobCount(invalidCount, REFIT_LEAVES_PER_JOB), [this](uint32_t, uint32_t begin, uint32_t end) {
+                    for(uint32_t i = begin; i < end; i++) {
+                        UpdateAABB(m_invalidNodes[i]);
+                    }
+                });
 
+                //Reinsert in pool order so the tree comes out the same however many threads are used.
+                for(uint32_t node : m_invalidNodes) {
+                    InsertLeaf(node);
                 }
                 //Clear all invalid nodes as they are no longer needed.
                 m_invalidNodes.clear();
             }
         }
 
-        if (m_showBVHDebug) {
-            //Add all nodes in node list to debug renderer
-            auto aabb = m_root->m_nodeAABB;
-            auto pos = aabb.m_minBounds + aabb.GetExtents() * 0.5f;
-
-            glm::mat4 trans = glm::mat4(1.0f);
-            trans = glm::translate(trans, pos);
-            trans = glm::scale(trans, aabb.GetExtents());
-            m_debugRenderer->AddToBuffer(&m_debugCuboid, m_debugCuboid.GetColor(), trans);
+        if (m_showBVHDebug && m_root != BVHNode::NULL_NODE) {
+            //Walk the tree from the root and add every node to the debug renderer.
+            m_debugStack.clear();
+            m_debugStack.push_back(m_root);
+            while(!m_debugStack.empty()) {
+                const BVHNode& node = m_nodes[m_debugStack.back()];
+                m_debugStack.pop_back();
 
-            for (auto node : m_nodeList)
-            {
-                aabb = node->m_nodeAABB;
-                pos = aabb.m_minBounds + aabb.GetExtents() * 0.5f;
+                const glm::vec3 extents = node.GetExtents();
+                const glm::vec3 pos = node.m_minBounds + extents * 0.5f;
 
-                trans = glm::mat4(1.0f);
+                glm::mat4 trans = glm::mat4(1.0f);
                 trans = glm::translate(trans, pos);
+                trans = glm::scale(trans, extents);
+                m_debugRenderer->AddToBuffer(&GetDebugCuboid(), GetDebugCuboid().GetColor(), trans);
 
-                trans = glm::scale(trans, aabb.GetExtents());
-                m_debugRenderer->AddToBuffer(&m_debugCuboid, m_debugCuboid.GetColor(), trans);
+                if(!node.IsLeaf()) {
+                    m_debugStack.push_back(node.m_childNodes[0]);
+                    m_debugStack.push_back(node.m_childNodes[1]);
+                }
             }
         }
     }
@@ -334,113 +297,259 @@ public:
     /*!
      * \brief Add an AABB to the Bounding Tree
      * \param aabb A pointer to the new aabb to add to the tree.
-     * 
-     * Adds AABB's into the bounding tree, by first creating a new node and then adding the new object into it.
+     *
+     * Adds AABB's into the bounding tree, by first taking a node from the pool and then adding the new object into it.
      * Makes the new Node fatter so there is a amount of wiggle room for the objects to move before the tree updates.
+     * The leaf is only queued here, it is placed in the tree on the next update so that a large batch of
+     * additions can be built in bulk.
+     * Static AABB's go into the static tree instead, they must not be moved or have their static flag changed
+     * while in the tree. To move one remove it and add it again.
      */
     void Add(AABB* aabb) override {
-        //If there is a root node.
-        if(m_root) {
-            //Create a new node
-            BVHNode* node = new BVHNode();
-            //Make it a leaf that contains the new "aabb"
-            node->MakeNodeIntoLeaf(aabb);
-            //Make the node AABB fatter to fit the "aabb"
-            node->UpdateAABB(m_margin);
-            //Insert the new node at the top of the tree to find correct spot.
-            InsertNode(node, &m_root);
-        }
-        //If tree is empty
-        else {
-            //Create the root node
-            m_root = new BVHNode();
-            //Make it a leaf with "aabb"
-            m_root->MakeNodeIntoLeaf(aabb);
-            //Make it fatter 
-            m_root->UpdateAABB(m_margin);
+        if(aabb->IsStatic() && !m_isStaticTree) {
+            if(!m_staticTree) {
+                //Static leaves never move, so they need no padding.
+                m_staticTree = std::make_unique<BoundingVolumeHeirarchy>(m_debugRenderer);
+                m_staticTree->SetMargin(0.0f);
+                m_staticTree->m_isStaticTree = true;
+            }
+            m_staticTree->Add(aabb);
+            return;
         }
+        AssignUniqueID(aabb);
+
+        //Take a node from the pool.
+        const uint32_t node = AllocateNode();
+        //Make it a leaf that contains the new "aabb"
+        MakeNodeIntoLeaf(node, aabb);
+        //Make the node AABB fatter to fit the "aabb"
+        UpdateAABB(node);
+        //Queue the new node to be inserted on the next update.
+        m_pendingLeaves.push_back(node);
+        m_leafCount++;
     }
 
     /*!
-     * \brief Inserts a node into the Bounding Tree.
-     * \param node A pointer to the node you wish to insert.
-     * \param parent A double pointer to the parent node.
-     * 
-     * Inserts a node into the tree at the specified parent node.
-     * If the parent is not a leaf not, it will test both sides of the children
-     * to see which will have a smaller increase of volume after insertion and chooses
-     * that one as the parent for the inserted node.
+     * \brief Calculates The Collision Pairs.
+     * \param pairs The pair manager to report every overlapping pair to.
      */
-    void InsertNode(BVHNode* node, BVHNode** parent)
-    {
-        //Get parent from double pointer.
-        BVHNode* p = *parent;
-        //If the parent is a leaf
-        if(p->IsLeaf()) {
-            //Make a new node.
-            //And swap its place with parent.
-            //Then insert both parent and new node into the new parent.
-            BVHNode* newParent = new BVHNode();
-            newParent->m_parent = p->m_parent;
-            newParent->MakeNodeIntoBranch(node, p);
-            *parent = newParent;
-            if (m_showBVHDebug) {
-                m_nodeList.push_back(newParent);
-            }
-        }
-        //If the node inserted into is a branch.
-        else {
-            //Get both child nodes AABB's
-            AABB aabb0 = p->m_childNodes[0]->m_nodeAABB;
-            AABB aabb1 = p->m_childNodes[1]->m_nodeAABB;
+    void CalculatePairs(PairManager& pairs) override {
+        //Make sure no added leaves are missed if the tree was not updated.
+        FlushPendingLeaves();
+
+        //Reset Checks made.
+        m_checksMade = 0;
+
+        FindDynamicPairs(pairs);
+        if(m_staticTree) {
+            m_staticTree->FlushPendingLeaves();
+            FindStaticPairs(pairs);
+        }
+    }
+
+    /*!
+     * \brief Finds the nearest AABB hit by a ray.
+     * \param ray The ray to cast.
+     * \param hit Receives the nearest hit.
+     * \return Returns true if anything was hit.
+     *
+     * The nearer child of each branch is searched first, and any node the ray enters beyond the nearest hit so far is skipped.
+     */
+    bool RaycastClosest(const Ray& ray, RaycastHit& hit) override {
+        FlushPendingLeaves();
+
+        bool found = false;
+        float nearest = ray.m_maxDistance;
+        float distance;
+        m_rayStack.clear();
+        if(m_root != BVHNode::NULL_NODE && SceneQuery::RayIntersectsBox(ray, m_nodes[m_root].m_minBounds, m_nodes[m_root].m_maxBounds, nearest, distance)) {
+            m_rayStack.emplace_back(distance, m_root);
+        }
+
+        while(!m_rayStack.empty()) {
+            const SearchCandidate candidate = m_rayStack.back();
+            m_rayStack.pop_back();
+            //A nearer hit may have been found since this node was pushed.
+            if(candidate.first > nearest) {
+                continue;
+            }
+
+            const BVHNode& node = m_nodes[candidate.second];
+            if(node.IsLeaf()) {
+                AABB* aabb = node.m_objectAABB;
+                if(SceneQuery::RayIntersectsBox(ray, aabb->m_minBounds, aabb->m_maxBounds, nearest, distance)) {
+                    hit = SceneQuery::MakeHit(ray, aabb, distance);
+                    nearest = distance;
+                    found = true;
+                }
+                continue;
+            }
+
+            float distances[2];
+            bool hits[2];
+            for(int i = 0; i < 2; i++) {
+                const BVHNode& child = m_nodes[node.m_childNodes[i]];
+                hits[i] = SceneQuery::RayIntersectsBox(ray, child.m_minBounds, child.m_maxBounds, nearest, distances[i]);
+            }
+            //Push the further child first so the nearer one is searched first.
+            const int first = distances[0] <= distances[1] ? 0 : 1;
+            const int second = 1 - first;
+            if(hits[second]) {
+                m_rayStack.emplace_back(distances[second], node.m_childNodes[second]);
+            }
+            if(hits[first]) {
+                m_rayStack.emplace_back(distances[first], node.m_childNodes[first]);
+            }
+        }
+
+        //Only static hits nearer than the dynamic hit matter.
+        if(m_staticTree) {
+            Ray staticRay = ray;
+            staticRay.m_maxDistance = nearest;
+            RaycastHit staticHit;
+            if(m_staticTree->RaycastClosest(staticRay, staticHit)) {
+                hit = staticHit;
+                found = true;
+            }
+        }
+        return found;
+    }
 
-            //Calculate the volume difference after inserting new node into both children.
-            const float volumeDiff1 = AABB::MergeAABB(aabb0, node->m_nodeAABB).GetVolume() - aabb0.GetVolume();
-            const float volumeDiff2 = AABB::MergeAABB(aabb1, node->m_nodeAABB).GetVolume() - aabb1.GetVolume();
+    /*!
+     * \brief Finds every AABB hit by a ray.
+     * \param ray The ray to cast.
+     * \param hits The buffer to write the hits to, sorted nearest first.
+     * \param maxHits The size of the buffer, the search stops once it is full.
+     * \return Returns the number of hits written.
+     */
+    uint32_t RaycastAll(const Ray& ray, RaycastHit* hits, uint32_t maxHits) override {
+        FlushPendingLeaves();
 
-            //Choose child node with the smallest volume increase and insert node into it.
-            if(volumeDiff1 < volumeDiff2) {
-                InsertNode(node, &p->m_childNodes[0]);
+        uint32_t count = 0;
+        float distance;
+        m_queryStack.clear();
+        if(m_root != BVHNode::NULL_NODE) {
+            m_queryStack.push_back(m_root);
+        }
+
+        while(!m_queryStack.empty() && count < maxHits) {
+            const BVHNode& node = m_nodes[m_queryStack.back()];
+            m_queryStack.pop_back();
+            if(!SceneQuery::RayIntersectsBox(ray, node.m_minBounds, node.m_maxBounds, ray.m_maxDistance, distance)) {
+                continue;
+            }
+
+            if(node.IsLeaf()) {
+                AABB* aabb = node.m_objectAABB;
+                if(SceneQuery::RayIntersectsBox(ray, aabb->m_minBounds, aabb->m_maxBounds, ray.m_maxDistance, distance)) {
+                    hits[count++] = SceneQuery::MakeHit(ray, aabb, distance);
+                }
             }
             else {
-                InsertNode(node, &p->m_childNodes[1]);
+                m_queryStack.push_back(node.m_childNodes[0]);
+                m_queryStack.push_back(node.m_childNodes[1]);
             }
         }
 
-        //After all Insertion is done, Will recursively exit the tree while updating all AABB's that
-        //were modified to fit properly.
-        (*parent)->UpdateAABB(m_margin);
-        
+        if(m_staticTree && count < maxHits) {
+            count += m_staticTree->RaycastAll(ray, hits + count, maxHits - count);
+        }
+
+        SortHits(hits, count);
+        return count;
     }
 
     /*!
-     * \brief Calculates The Collision Pairs.
-     * \return Returns a list of all collision pairs found.
+     * \brief Finds every AABB overlapping a box.
+     * \param bounds The box to test.
+     * \param results The buffer to write the AABB's to.
+     * \param maxResults The size of the buffer, the search stops once it is full.
+     * \return Returns the number of AABB's written.
      */
-    CollisionPairList CalculatePairs() override {
-        //Clear all collision pairs.
-        m_collisionPairs.clear();
-        //Reset Checks made.
-        m_checksMade = 0;
-        //If root does not exist or it is a leaf
-        //return empty collision list.
-        if(!m_root || m_root->IsLeaf()) {
-            return m_collisionPairs;
+    uint32_t QueryOverlap(const AABB& bounds, AABB** results, uint32_t maxResults) override {
+        FlushPendingLeaves();
+
+        uint32_t count = 0;
+        m_queryStack.clear();
+        if(m_root != BVHNode::NULL_NODE) {
+            m_queryStack.push_back(m_root);
         }
-        //Reset all nodes checked flag.
-        ClearCheckedFlags(m_root);
 
-        //Find all collision pairs starting from first two child nodes in tree.
-        FindPairs(m_root->m_childNodes[0], m_root->m_childNodes[1]);
+        while(!m_queryStack.empty() && count < maxResults) {
+            const BVHNode& node = m_nodes[m_queryStack.back()];
+            m_queryStack.pop_back();
+            if(!SceneQuery::BoxesOverlap(node.m_minBounds, node.m_maxBounds, bounds.m_minBounds, bounds.m_maxBounds)) {
+                continue;
+            }
 
-        //Loop through all pairs and set their collision status
-        for(auto pair : m_collisionPairs) {
-            pair.first->IsColliding() = AABB::POTENTIAL;
-            pair.second->IsColliding() = AABB::POTENTIAL;
+            if(node.IsLeaf()) {
+                //Leaves are padded, so test the object itself.
+                AABB* aabb = node.m_objectAABB;
+                if(SceneQuery::BoxesOverlap(aabb->m_minBounds, aabb->m_maxBounds, bounds.m_minBounds, bounds.m_maxBounds)) {
+                    results[count++] = aabb;
+                }
+            }
+            else {
+                m_queryStack.push_back(node.m_childNodes[0]);
+                m_queryStack.push_back(node.m_childNodes[1]);
+            }
         }
 
-        //Return all found pairs.
-        return m_collisionPairs;
+        if(m_staticTree && count < maxResults) {
+            count += m_staticTree->QueryOverlap(bounds, results + count, maxResults - count);
+        }
+        return count;
+    }
+
+    /*!
+     * \brief Finds every AABB inside or crossing a frustum.
+     * \param frustum The frustum to test.
+     * \param results The buffer to write the AABB's to.
+     * \param maxResults The size of the buffer, the search stops once it is full.
+     * \return Returns the number of AABB's written.
+     *
+     * Once a branch is found to be entirely inside the frustum, every leaf below it is taken without testing any planes.
+     */
+    uint32_t QueryFrustum(const Frustum& frustum, AABB** results, uint32_t maxResults) override {
+        FlushPendingLeaves();
+
+        uint32_t count = 0;
+        m_queryStack.clear();
+        if(m_root != BVHNode::NULL_NODE) {
+            m_queryStack.push_back(m_root);
+        }
+
+        while(!m_queryStack.empty() && count < maxResults) {
+            const uint32_t entry = m_queryStack.back();
+            m_queryStack.pop_back();
+            const BVHNode& node = m_nodes[entry & ~INSIDE_FLAG];
+
+            Frustum::FrustumTest test = Frustum::INSIDE;
+            if(!(entry & INSIDE_FLAG)) {
+                test = frustum.TestBox(node.m_minBounds, node.m_maxBounds);
+                if(test == Frustum::OUTSIDE) {
+                    continue;
+                }
+            }
+
+            if(node.IsLeaf()) {
+                //A padded leaf inside the frustum means the object is too.
+                AABB* aabb = node.m_objectAABB;
+                if(test == Frustum::INSIDE || frustum.TestBox(aabb->m_minBounds, aabb->m_maxBounds) != Frustum::OUTSIDE) {
+                    results[count++] = aabb;
+                }
+            }
+            else {
+                const uint32_t flag = test == Frustum::INSIDE ? INSIDE_FLAG : 0;
+                m_queryStack.push_back(node.m_childNodes[0] | flag);
+                m_queryStack.push_back(node.m_childNodes[1] | flag);
+            }
+        }
+
+        if(m_staticTree && count < maxResults) {
+            count += m_staticTree->QueryFrustum(frustum, results + count, maxResults - count);
+        }
+        return count;
     }
 
     /*!
@@ -451,6 +560,43 @@ public:
         return m_checksMade;
     }
 
+    int GetReinsertsMade() override {
+        return m_reinsertsMade;
+    }
+
+    /*!
+     * \brief Gets the surface area heuristic cost of the tree.
+     * \return Returns the summed surface area of every branch relative to the root.
+     *
+     * This is the expected number of branches a query will visit, it rises as the tree degrades.
+     */
+    float GetTreeCost() override {
+        if(m_root == BVHNode::NULL_NODE) {
+            return 0.0f;
+        }
+        const float rootArea = m_nodes[m_root].GetSurfaceArea();
+        if(rootArea <= 0.0f) {
+            return 0.0f;
+        }
+
+        float totalArea = 0.0f;
+        for(const BVHNode& node : m_nodes) {
+            //Free nodes have no children so only live branches are counted.
+            if(!node.IsLeaf()) {
+                totalArea += node.GetSurfaceArea();
+            }
+        }
+        return totalArea / rootArea;
+    }
+
+    /*!
+     * \brief Gets the depth of the tree.
+     * \return Returns the height of the root node.
+     */
+    int GetTreeDepth() override {
+        return m_root == BVHNode::NULL_NODE ? 0 : m_nodes[m_root].m_height;
+    }
+
     /*!
      * \brief Sets whether the debug rendering should show or not.
      * \param enable Should debug rendering be enabled.
@@ -458,141 +604,967 @@ public:
     bool* GetShowDebug() override {
         return &m_showBVHDebug;
     }
-    
+
+    /*!
+     * \brief Sets the smallest batch of additions that rebuilds the tree in bulk.
+     * \param threshold The number of leaves added between updates needed for a bulk build.
+     *
+     * A batch also has to be at least as large as the tree it is added to, so a few hundred leaves
+     * joining a huge scene are still inserted one at a time.
+     */
+    void SetBulkBuildThreshold(uint32_t threshold) {
+        m_bulkBuildThreshold = threshold;
+    }
+
+    /*!
+     * \brief Sets the padding applied around every leaf.
+     * \param margin The padding added on every side of a leaf.
+     */
+    void SetMargin(float margin) {
+        m_margin = margin;
+    }
+
+    /*!
+     * \brief Sets how far ahead leaves are stretched along their AABB's displacement.
+     * \param scale How many steps of displacement a leaf is stretched by.
+     *
+     * Larger values mean fast objects are reinserted less often, at the cost of larger leaves.
+     */
+    void SetPredictionScale(float scale) {
+        m_predictionScale = scale;
+    }
+
+    /*!
+     * \brief Sets how much larger than its object's current motion needs a leaf may get before it is rebuilt.
+     * \param ratio How many times the predicted size a leaf can be on any axis, must be above one.
+     *
+     * Leaves stretched while an object was moving fast are shrunk back once it slows down or comes to rest.
+     */
+    void SetShrinkRatio(float ratio) {
+        m_shrinkRatio = ratio;
+    }
+
+    /*!
+     * \brief Sets how deep the pair search is split into tasks for the job system.
+     * \param depth The depth of the tree the search is split at, zero searches the whole tree in one task.
+     *
+     * Deeper splits give more, smaller tasks that share out more evenly between threads.
+     */
+    void SetParallelPairDepth(uint32_t depth) {
+        m_parallelPairDepth = depth;
+    }
+
+    /*!
+     * \brief Rebuilds the static tree from all of its leaves at once.
+     *
+     * Static leaves added in small batches are inserted one at a time, which can leave the tree worse than
+     * building it in one go. Call this once the level has been loaded to rebuild it in bulk.
+     */
+    void RebuildStaticTree() {
+        if(!m_staticTree) {
+            return;
+        }
+        m_staticTree->m_pendingLeaves.clear();
+        if(m_staticTree->m_leafCount > 0) {
+            m_staticTree->BulkBuild();
+        }
+    }
+
+protected:
+    void GatherAABBs(std::vector<AABB*>& aabbs) override {
+        aabbs.clear();
+        for(const BVHNode& node : m_nodes) {
+            if(node.m_objectAABB) {
+                aabbs.push_back(node.m_objectAABB);
+            }
+        }
+        if(m_staticTree) {
+            for(const BVHNode& node : m_staticTree->m_nodes) {
+                if(node.m_objectAABB) {
+                    aabbs.push_back(node.m_objectAABB);
+                }
+            }
+        }
+    }
+
 private:
-    BVHNode* m_root;        /*!< The root node of the bounding tree.*/
-    float m_margin = 0.5f;  /*!< The margin to apply around all leaf nodes.*/
+    uint32_t m_root;        /*!< Index of the root node of the bounding tree.*/
+    uint32_t m_freeList;    /*!< Index of the first node on the free list.*/
+    uint32_t m_leafCount = 0;               /*!< Number of leaves in the tree, including those waiting to be inserted.*/
+    uint32_t m_bulkBuildThreshold = 256;    /*!< Smallest batch of new leaves that rebuilds the tree in bulk.*/
+    float m_margin = 0.1f;  /*!< The margin to apply around all leaf nodes.*/
+    float m_predictionScale = 2.0f; /*!< How many steps of displacement leaves are stretched by.*/
+    float m_shrinkRatio = 2.0f;     /*!< How many times its predicted size a leaf can grow to before it is rebuilt.*/
     int m_checksMade = 0;   /*!< A counter for how many actual checks were performed during this broadphase.*/
+    int m_reinsertsMade = 0;    /*!< A counter for how many leaves were reinserted during the last update.*/
     bool m_showBVHDebug = false;
 
-    CollisionPairList m_collisionPairs;     /*!< The list of collision pairs found.*/
-    std::vector<BVHNode*> m_invalidNodes;   /*!< The list of invalid nodes found.*/
-    std::list<BVHNode*> m_nodeList;       /*!< List of all nodes in tree.*/
+    std::vector<BVHNode> m_nodes;           /*!< The pool every node of the tree is stored in.*/
+    std::unique_ptr<BoundingVolumeHeirarchy> m_staticTree;  /*!< Tree of static AABB's, created when the first is added.*/
+    bool m_isStaticTree = false;            /*!< Is this the static tree of another tree, so it holds static AABB's itself.*/
+    std::vector<uint32_t> m_invalidNodes;   /*!< The list of invalid nodes found.*/
+    std::vector<uint32_t> m_debugStack;     /*!< Traversal stack reused when drawing the tree.*/
+
+    typedef std::pair<float, uint32_t> SearchCandidate; /*!< Inherited cost and node index used by the sibling search.*/
+    std::vector<SearchCandidate> m_searchHeap;          /*!< Heap reused by the sibling search.*/
+    std::vector<SearchCandidate> m_rayStack;            /*!< Entry distance and node index stack reused by ray casts.*/
+    std::vector<uint32_t> m_queryStack;                 /*!< Traversal stack reused by the scene queries.*/
+
+    static constexpr uint32_t INSIDE_FLAG = 0x80000000; /*!< Marks a frustum query stack entry whose node is known to be inside.*/
+
+    std::vector<uint32_t> m_pendingLeaves;  /*!< Leaves added since the last update, waiting to be inserted.*/
+    std::vector<uint32_t> m_bulkLeaves;     /*!< Every leaf of a bulk build in pool order.*/
+    std::vector<uint32_t> m_bulkBranches;   /*!< Branch nodes of a bulk build, indexed by their place in the sorted order.*/
+    std::vector<uint64_t> m_mortonKeys;     /*!< Morton code in the high half and leaf index in the low half, sorted during a bulk build.*/
+    std::vector<uint64_t> m_sortScratch;    /*!< Second buffer for the radix sort.*/
+    std::vector<uint32_t> m_radixCounts;    /*!< Per job digit counts for the radix sort.*/
+
+    static constexpr uint32_t BULK_LEAVES_PER_JOB = 4096;   /*!< Fewest leaves worth giving a job during a bulk build.*/
+    static constexpr uint32_t REFIT_LEAVES_PER_JOB = 4096;  /*!< Fewest leaves worth giving a job when scanning or refitting.*/
+    static constexpr uint32_t PAIR_LEAVES_PER_JOB = 1024;   /*!< Fewest leaves in the tree per job when finding pairs.*/
 
     /*!
-     * \brief Finds all node that are requiring reinsertion into the tree.
-     * \param node The node to check for invalid AABB's
-     * \param invalidNodes Reference to invalidNode storage.
-     * 
-     * Recursively checks all nodes starting from the one specified. Will check to see if the object
-     * AABB still fits inside the Nodes AABB, if not then the node need to be reinserted.
+     * \brief Part of the pair search that can run as its own task.
+     *
+     * With no second node the task finds the pairs inside the first node's subtree, otherwise the pairs
+     * between the two subtrees. The job that ran it and where its pairs sit in that job's buffer are recorded.
+     */
+    struct PairTask {
+        uint32_t m_first;
+        uint32_t m_second;
+        uint32_t m_job;
+        uint32_t m_begin;
+        uint32_t m_end;
+    };
+
+    /*!
+     * \brief Pairs and checks found by one job.
+     */
+    struct PairBuffer {
+        std::vector<CollisionPair> m_pairs;
+        std::vector<uint32_t> m_stack;  /*!< Search stack for static queries.*/
+        int m_checksMade = 0;
+    };
+
+    uint32_t m_parallelPairDepth = 6;       /*!< Depth of the tree the pair search is split into tasks at.*/
+    std::vector<PairTask> m_pairTasks;      /*!< Tasks of this frames pair search.*/
+    std::vector<PairBuffer> m_jobPairs;     /*!< One pair buffer for each job.*/
+    std::vector<std::vector<uint32_t>> m_jobInvalidNodes;  /*!< Invalid leaves found by each job of the scan.*/
+
+    /*!
+     * \brief Finds the pairs between two dynamic AABB's.
+     * \param pairs The pair manager to report every overlapping pair to.
      */
-    static void FindInvalidNodes(BVHNode* node, std::vector<BVHNode*>& invalidNodes) {
-        //Is node a leaf
-        if(node->IsLeaf()) {
-            //Does object node still fit inside Node AABB.
-            if(!node->m_nodeAABB.Contains(*node->m_objectAABB)) {
-                //Add node to list.
-                invalidNodes.push_back(node);
+    void FindDynamicPairs(PairManager& pairs) {
+        //If root does not exist or it is a leaf there are no dynamic pairs.
+        if(m_root == BVHNode::NULL_NODE || m_nodes[m_root].IsLeaf()) {
+            return;
+        }
+
+        //Split the search into tasks at the parallel depth, the tasks are the same however many jobs run them.
+        const uint32_t numJobs = GetParallelJobCount(m_leafCount, PAIR_LEAVES_PER_JOB);
+        m_pairTasks.clear();
+        AddPairTasks(m_root, BVHNode::NULL_NODE, m_parallelPairDepth);
+
+        //Each job takes the next task until none are left, writing pairs into its own buffer.
+        if(m_jobPairs.size() < numJobs) {
+            m_jobPairs.resize(numJobs);
+        }
+        for(uint32_t i = 0; i < numJobs; i++) {
+            m_jobPairs[i].m_pairs.clear();
+            m_jobPairs[i].m_checksMade = 0;
+        }
+        std::atomic<uint32_t> nextTask{ 0 };
+        ParallelFor(numJobs, numJobs, [this, &nextTask](uint32_t job, uint32_t, uint32_t) {
+            PairBuffer& buffer = m_jobPairs[job];
+            for(uint32_t task = nextTask++; task < m_pairTasks.size(); task = nextTask++) {
+                PairTask& pairTask = m_pairTasks[task];
+                pairTask.m_job = job;
+                pairTask.m_begin = static_cast<uint32_t>(buffer.m_pairs.size());
+                if(pairTask.m_second == BVHNode::NULL_NODE) {
+                    SelfPairs(pairTask.m_first, buffer);
+                }
+                else {
+                    CrossPairs(pairTask.m_first, pairTask.m_second, buffer);
+                }
+                pairTask.m_end = static_cast<uint32_t>(buffer.m_pairs.size());
+            }
+        });
+
+        //Report the pairs in task order, so the order does not depend on which job ran which task.
+        for(const PairTask& task : m_pairTasks) {
+            const std::vector<CollisionPair>& jobPairs = m_jobPairs[task.m_job].m_pairs;
+            for(uint32_t i = task.m_begin; i < task.m_end; i++) {
+                pairs.AddPair(jobPairs[i].first, jobPairs[i].second);
+            }
+        }
+        for(uint32_t i = 0; i < numJobs; i++) {
+            m_checksMade += m_jobPairs[i].m_checksMade;
+        }
+    }
+
+    /*!
+     * \brief Finds the pairs between a dynamic and a static AABB.
+     * \param pairs The pair manager to report every overlapping pair to.
+     *
+     * Every dynamic leaf is queried against the static tree. The pool is split into one range per job,
+     * and the jobs pairs are reported in order so they come out in pool order.
+     */
+    void FindStaticPairs(PairManager& pairs) {
+        if(m_staticTree->m_root == BVHNode::NULL_NODE || m_leafCount == 0) {
+            return;
+        }
+
+        const uint32_t nodeCount = static_cast<uint32_t>(m_nodes.size());
+        const uint32_t numJobs = GetParallelJobCount(nodeCount, PAIR_LEAVES_PER_JOB);
+        if(m_jobPairs.size() < numJobs) {
+            m_jobPairs.resize(numJobs);
+        }
+
+        ParallelFor(nodeCount, numJobs, [this](uint32_t job, uint32_t begin, uint32_t end) {
+            PairBuffer& buffer = m_jobPairs[job];
+            buffer.m_pairs.clear();
+            buffer.m_checksMade = 0;
+            for(uint32_t i = begin; i < end; i++) {
+                if(m_nodes[i].m_objectAABB) {
+                    m_staticTree->QueryStaticPairs(m_nodes[i].m_objectAABB, buffer);
+                }
+            }
+        });
+
+        for(uint32_t i = 0; i < numJobs; i++) {
+            for(const CollisionPair& pair : m_jobPairs[i].m_pairs) {
+                pairs.AddPair(pair.first, pair.second);
             }
+            m_checksMade += m_jobPairs[i].m_checksMade;
+        }
+    }
+
+    /*!
+     * \brief Finds every AABB in this tree overlapping a dynamic AABB.
+     * \param aabb The dynamic AABB.
+     * \param buffer The buffer to add pairs and checks to, its stack is used for the search.
+     *
+     * Only reads the tree, so many jobs may query it at once.
+     */
+    void QueryStaticPairs(AABB* aabb, PairBuffer& buffer) const {
+        std::vector<uint32_t>& stack = buffer.m_stack;
+        stack.clear();
+        stack.push_back(m_root);
+
+        while(!stack.empty()) {
+            const BVHNode& node = m_nodes[stack.back()];
+            stack.pop_back();
+            if(node.IsLeaf()) {
+                buffer.m_checksMade++;
+                if(aabb->Collides(node.m_objectAABB)) {
+                    buffer.m_pairs.emplace_back(aabb, node.m_objectAABB);
+                }
+            }
+            else if(SceneQuery::BoxesOverlap(node.m_minBounds, node.m_maxBounds, aabb->m_minBounds, aabb->m_maxBounds)) {
+                stack.push_back(node.m_childNodes[0]);
+                stack.push_back(node.m_childNodes[1]);
+            }
+        }
+    }
+
+    /*!
+     * \brief Inserts every leaf added since the last update.
+     *
+     * A batch at least as large as the bulk build threshold, that also makes up half or more of the tree,
+     * rebuilds the whole tree at once. Smaller batches are inserted one leaf at a time.
+     */
+    void FlushPendingLeaves() {
+        if(m_pendingLeaves.empty()) {
+            return;
+        }
+
+        if(m_pendingLeaves.size() >= m_bulkBuildThreshold && m_pendingLeaves.size() * 2 >= m_leafCount) {
+            BulkBuild();
         }
-        //If node is branch.
         else {
-            //Check both child nodes for invalidNodes.
-            FindInvalidNodes(node->m_childNodes[0], invalidNodes);
-            FindInvalidNodes(node->m_childNodes[1], invalidNodes);
+            for(uint32_t leaf : m_pendingLeaves) {
+                InsertLeaf(leaf);
+            }
         }
+        m_pendingLeaves.clear();
     }
 
     /*!
-     * \brief Sets Checked Flag of all nodes in tree to false.
-     * \param node Node to start the operation from.
-     * 
-     * Recursively traverses the tree setting all nodes checked flag to false.
-     * More of a helper function.
+     * \brief Rebuilds the whole tree from its leaves as a linear BVH.
+     *
+     * Every leaf is given a 30 bit Morton code from the centre of its box, which places leaves that are close
+     * in space close together once sorted. The codes are radix sorted on the job system, then each branch
+     * finds its own range of leaves and split point from the sorted codes alone (Karras 2012), so all branches
+     * are built in parallel. Finally every leaf walks up the tree, and the second child to arrive at a branch
+     * refits it, so bounds are also built in parallel without locks.
+     * Leaves keep their pool index, so proxy ids stay valid through the rebuild.
      */
-    static void ClearCheckedFlags(BVHNode* node)
-    {
-        //Set node checked to false.
-        node->m_childrenChecked = false;
-        //If node has children.
-        if(!node->IsLeaf()) {
-            //Set child nodes to have flag set false.
-            ClearCheckedFlags(node->m_childNodes[0]);
-            ClearCheckedFlags(node->m_childNodes[1]);
+    void BulkBuild() {
+        //Gather every leaf and release every branch.
+        m_bulkLeaves.clear();
+        for(uint32_t i = 0; i < m_nodes.size(); i++) {
+            if(m_nodes[i].m_objectAABB) {
+                m_bulkLeaves.push_back(i);
+            }
+            else if(!m_nodes[i].IsLeaf()) {
+                FreeNode(i);
+            }
+        }
+
+        const uint32_t count = static_cast<uint32_t>(m_bulkLeaves.size());
+        if(count == 1) {
+            m_root = m_bulkLeaves[0];
+            m_nodes[m_root].m_parent = BVHNode::NULL_NODE;
+            UpdateAABB(m_root);
+            return;
+        }
+
+        //Take every branch from the pool up front, nothing may grow the pool once jobs are running.
+        m_bulkBranches.resize(count - 1);
+        for(uint32_t i = 0; i < count - 1; i++) {
+            m_bulkBranches[i] = AllocateNode();
+        }
+
+        const uint32_t numJobs = GetParallelJobCount(count, BULK_LEAVES_PER_JOB);
+
+        //Refit every leaf and find the bounds of their centres.
+        std::vector<glm::vec3> jobMin(numJobs, glm::vec3(FLT_MAX));
+        std::vector<glm::vec3> jobMax(numJobs, glm::vec3(-FLT_MAX));
+        ParallelFor(count, numJobs, [&](uint32_t job, uint32_t begin, uint32_t end) {
+            for(uint32_t i = begin; i < end; i++) {
+                UpdateAABB(m_bulkLeaves[i]);
+                const BVHNode& leaf = m_nodes[m_bulkLeaves[i]];
+                const glm::vec3 centre = (leaf.m_minBounds + leaf.m_maxBounds) * 0.5f;
+                jobMin[job] = glm::min(jobMin[job], centre);
+                jobMax[job] = glm::max(jobMax[job], centre);
+            }
+        });
+        glm::vec3 centreMin = jobMin[0];
+        glm::vec3 centreMax = jobMax[0];
+        for(uint32_t job = 1; job < numJobs; job++) {
+            centreMin = glm::min(centreMin, jobMin[job]);
+            centreMax = glm::max(centreMax, jobMax[job]);
         }
+        const glm::vec3 range = centreMax - centreMin;
+        const glm::vec3 scale(range.x > 0.0f ? 1.0f / range.x : 0.0f,
+                              range.y > 0.0f ? 1.0f / range.y : 0.0f,
+                              range.z > 0.0f ? 1.0f / range.z : 0.0f);
+
+        //Key each leaf by Morton code, the leaf index in the low half keeps every key unique.
+        m_mortonKeys.resize(count);
+        m_sortScratch.resize(count);
+        ParallelFor(count, numJobs, [&](uint32_t /*job*/, uint32_t begin, uint32_t end) {
+            for(uint32_t i = begin; i < end; i++) {
+                const BVHNode& leaf = m_nodes[m_bulkLeaves[i]];
+                const glm::vec3 centre = (leaf.m_minBounds + leaf.m_maxBounds) * 0.5f;
+                const uint64_t code = MortonCode((centre - centreMin) * scale);
+                m_mortonKeys[i] = (code << 32) | i;
+            }
+        });
+
+        RadixSortMortonKeys(numJobs);
+
+        //Build every branch from its place in the sorted order.
+        m_root = m_bulkBranches[0];
+        m_nodes[m_root].m_parent = BVHNode::NULL_NODE;
+        ParallelFor(count - 1, numJobs, [&](uint32_t /*job*/, uint32_t begin, uint32_t end) {
+            for(uint32_t i = begin; i < end; i++) {
+                BuildBranch(static_cast<int>(i), static_cast<int>(count));
+            }
+        });
+
+        //Refit from the leaves up, the second child to reach a branch refits it.
+        std::vector<std::atomic<uint32_t>> visits(m_nodes.size());
+        ParallelFor(count, numJobs, [&](uint32_t /*job*/, uint32_t begin, uint32_t end) {
+            for(uint32_t i = begin; i < end; i++) {
+                uint32_t node = m_nodes[m_bulkLeaves[i]].m_parent;
+                while(node != BVHNode::NULL_NODE && visits[node].fetch_add(1, std::memory_order_acq_rel) == 1) {
+                    UpdateAABB(node);
+                    node = m_nodes[node].m_parent;
+                }
+            }
+        });
     }
 
     /*!
-     * \brief Finds Colliding Pairs starting at the nodes specified.
-     * \param n0 Pointer to first node to start at.
-     * \param n1 Pointer to second node to start at.
-     * 
-     * Recursively checks the two nodes given against each other for colliding pairs.
+     * \brief Sorts the Morton keys by their code.
+     * \param numJobs The number of jobs to split each pass into.
+     *
+     * A least significant digit radix sort over the 30 bit code, 8 bits per pass. Each job counts the digits in
+     * its part of the keys, the counts are turned into offsets in job order, then each job scatters its keys.
+     * Every pass is stable, and the keys start in leaf order, so ties keep leaf order and the result is deterministic.
      */
-    void FindPairs(BVHNode* n0, BVHNode* n1)
-    {
-        //If first node is a leaf.
-        if(n0->IsLeaf()) {
-            //If second node is a leaf.
-            if(n1->IsLeaf()) {
-                //Check for a collision of the object AABB's
-                m_checksMade++;
-
-                if(n0->m_objectAABB->Collides(n1->m_objectAABB)) {
-                    //If they do collide add them to the collision pair list.
-                    m_collisionPairs.push_back(std::make_pair(n0->m_objectAABB, n1->m_objectAABB));
+    void RadixSortMortonKeys(uint32_t numJobs) {
+        const uint32_t count = static_cast<uint32_t>(m_mortonKeys.size());
+        m_radixCounts.resize(numJobs * 256);
+
+        for(uint32_t shift = 32; shift < 62; shift += 8) {
+            std::fill(m_radixCounts.begin(), m_radixCounts.end(), 0);
+            ParallelFor(count, numJobs, [&](uint32_t job, uint32_t begin, uint32_t end) {
+                uint32_t* counts = &m_radixCounts[job * 256];
+                for(uint32_t i = begin; i < end; i++) {
+                    counts[(m_mortonKeys[i] >> shift) & 0xFF]++;
+                }
+            });
+
+            //Turn the counts into where each job writes each digit.
+            uint32_t offset = 0;
+            for(uint32_t digit = 0; digit < 256; digit++) {
+                for(uint32_t job = 0; job < numJobs; job++) {
+                    const uint32_t digitCount = m_radixCounts[job * 256 + digit];
+                    m_radixCounts[job * 256 + digit] = offset;
+                    offset += digitCount;
                 }
             }
-            //If second node is not a leaf.
-            else {
-                //Check second nodes children against each other.
-                CheckChildren(n1);
-                //Check first node with second nodes children nodes only if the 2 nodes collide.
-                if(n0->m_nodeAABB.Collides(&n1->m_nodeAABB)) {
-                    FindPairs(n0, n1->m_childNodes[0]);
-                    FindPairs(n0, n1->m_childNodes[1]);
+
+            ParallelFor(count, numJobs, [&](uint32_t job, uint32_t begin, uint32_t end) {
+                uint32_t* offsets = &m_radixCounts[job * 256];
+                for(uint32_t i = begin; i < end; i++) {
+                    m_sortScratch[offsets[(m_mortonKeys[i] >> shift) & 0xFF]++] = m_mortonKeys[i];
                 }
-                
+            });
+            m_mortonKeys.swap(m_sortScratch);
+        }
+    }
+
+    /*!
+     * \brief Links one branch of a bulk build to its children.
+     * \param i The place of the branch in the sorted order.
+     * \param count The number of leaves.
+     *
+     * Branch i covers a range of sorted leaves with i at one end. The direction of the range is towards the
+     * neighbour sharing the longer code prefix, the far end is found with an exponential then binary search,
+     * and the split is the last leaf that shares more of the prefix than the whole range does.
+     */
+    void BuildBranch(int i, int count) {
+        const int direction = CommonPrefix(i, i + 1, count) > CommonPrefix(i, i - 1, count) ? 1 : -1;
+
+        //Find the far end of the range.
+        const int minPrefix = CommonPrefix(i, i - direction, count);
+        int maxLength = 2;
+        while(CommonPrefix(i, i + maxLength * direction, count) > minPrefix) {
+            maxLength *= 2;
+        }
+        int length = 0;
+        for(int step = maxLength / 2; step >= 1; step /= 2) {
+            if(CommonPrefix(i, i + (length + step) * direction, count) > minPrefix) {
+                length += step;
             }
         }
-        //If first node not a leaf.
+        const int j = i + length * direction;
+
+        //Find where the range splits.
+        const int nodePrefix = CommonPrefix(i, j, count);
+        int split = 0;
+        int step = length;
+        do {
+            step = (step + 1) / 2;
+            if(CommonPrefix(i, i + (split + step) * direction, count) > nodePrefix) {
+                split += step;
+            }
+        } while(step > 1);
+        const int gamma = i + split * direction + (std::min)(direction, 0);
+
+        //Ranges of one leaf are the leaf itself.
+        const uint32_t branch = m_bulkBranches[i];
+        const uint32_t left = (std::min)(i, j) == gamma ? m_bulkLeaves[static_cast<uint32_t>(m_mortonKeys[gamma])] : m_bulkBranches[gamma];
+        const uint32_t right = (std::max)(i, j) == gamma + 1 ? m_bulkLeaves[static_cast<uint32_t>(m_mortonKeys[gamma + 1])] : m_bulkBranches[gamma + 1];
+
+        m_nodes[branch].m_childNodes[0] = left;
+        m_nodes[branch].m_childNodes[1] = right;
+        m_nodes[left].m_parent = branch;
+        m_nodes[right].m_parent = branch;
+    }
+
+    /*!
+     * \brief Gets the length of the common prefix of two sorted Morton keys.
+     * \return Returns -1 if j is outside the keys.
+     */
+    int CommonPrefix(int i, int j, int count) const {
+        if(j < 0 || j >= count) {
+            return -1;
+        }
+        return CountLeadingZeros(m_mortonKeys[i] ^ m_mortonKeys[j]);
+    }
+
+    /*!
+     * \brief Counts the leading zero bits of a non zero value.
+     */
+    static int CountLeadingZeros(uint64_t value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return 63 - static_cast<int>(index);
+#else
+        return __builtin_clzll(value);
+#endif
+    }
+
+    /*!
+     * \brief Gets the 30 bit Morton code of a point inside the unit cube.
+     */
+    static uint64_t MortonCode(const glm::vec3& point) {
+        const glm::vec3 cell = glm::clamp(point * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f));
+        return (ExpandBits(static_cast<uint32_t>(cell.x)) << 2) | (ExpandBits(static_cast<uint32_t>(cell.y)) << 1) | ExpandBits(static_cast<uint32_t>(cell.z));
+    }
+
+    /*!
+     * \brief Spreads the low 10 bits of a value out so there are two zero bits between each.
+     */
+    static uint64_t ExpandBits(uint32_t value) {
+        value = (value * 0x00010001u) & 0xFF0000FFu;
+        value = (value * 0x00000101u) & 0x0F00F00Fu;
+        value = (value * 0x00000011u) & 0xC30C30C3u;
+        value = (value * 0x00000005u) & 0x49249249u;
+        return value;
+    }
+
+    /*!
+     * \brief Takes a node from the pool.
+     * \return Returns the index of the node.
+     *
+     * Reuses a node from the free list if there is one, otherwise grows the pool.
+     * Growing the pool may move it, so node references must not be held across this call.
+     */
+    uint32_t AllocateNode() {
+        //If there are no free nodes grow the pool.
+        if(m_freeList == BVHNode::NULL_NODE) {
+            m_nodes.emplace_back();
+            return static_cast<uint32_t>(m_nodes.size() - 1);
+        }
+        //Otherwise pop the first node off the free list.
+        const uint32_t node = m_freeList;
+        m_freeList = m_nodes[node].m_parent;
+        m_nodes[node] = BVHNode();
+        return node;
+    }
+
+    /*!
+     * \brief Returns a node to the pool.
+     * \param node The index of the node to release.
+     */
+    void FreeNode(uint32_t node) {
+        BVHNode& n = m_nodes[node];
+        n.m_objectAABB = nullptr;
+        n.m_childNodes[0] = BVHNode::NULL_NODE;
+        n.m_childNodes[1] = BVHNode::NULL_NODE;
+        //Free nodes link through their parent index.
+        n.m_parent = m_freeList;
+        m_freeList = node;
+    }
+
+    /*!
+     * \brief Turns the node into a leaf node.
+     * \param node The index of the node.
+     * \param data The object AABB to be contained inside this node.
+     *
+     * Stores the object AABB data inside this node, then stores the node index as the AABB proxy.
+     */
+    void MakeNodeIntoLeaf(uint32_t node, AABB* data) {
+        BVHNode& n = m_nodes[node];
+        n.m_objectAABB = data;
+        data->m_proxyID = node;
+
+        n.m_childNodes[0] = BVHNode::NULL_NODE;
+        n.m_childNodes[1] = BVHNode::NULL_NODE;
+    }
+
+    /*!
+     * \brief Updates the nodes bounds
+     * \param node The index of the node.
+     *
+     * If the node is a leaf node, adds the margin as padding around the object, and stretches it along the
+     * objects displacement so a moving object stays inside its leaf for a few steps.
+     * Else it will merge the two child nodes bounds returning a perfect fitting box of the child nodes,
+     * and recalculate the height of the node from its children.
+     */
+    void UpdateAABB(uint32_t node) {
+        BVHNode& n = m_nodes[node];
+        if(n.IsLeaf()) {
+            const glm::vec3 marginVector(m_margin);
+            const glm::vec3 displacement = n.m_objectAABB->m_displacement * m_predictionScale;
+            n.m_minBounds = n.m_objectAABB->m_minBounds - marginVector + glm::min(displacement, glm::vec3(0.0f));
+            n.m_maxBounds = n.m_objectAABB->m_maxBounds + marginVector + glm::max(displacement, glm::vec3(0.0f));
+            n.m_height = 0;
+        }
+        else {
+            const BVHNode& c0 = m_nodes[n.m_childNodes[0]];
+            const BVHNode& c1 = m_nodes[n.m_childNodes[1]];
+            n.m_minBounds = glm::min(c0.m_minBounds, c1.m_minBounds);
+            n.m_maxBounds = glm::max(c0.m_maxBounds, c1.m_maxBounds);
+            n.m_height = 1 + (std::max)(c0.m_height, c1.m_height);
+        }
+    }
+
+    /*!
+     * \brief Inserts a leaf into the Bounding Tree.
+     * \param leaf The index of the leaf you wish to insert.
+     *
+     * Finds the sibling that gives the lowest surface area heuristic cost for the whole tree, then pairs
+     * the leaf with it under a new parent. Every branch on the way back up is refit, and rotated if
+     * swapping grandchildren would shrink it, so the tree stays balanced as leaves are reinserted.
+     */
+    void InsertLeaf(uint32_t leaf) {
+        //If tree is empty the leaf becomes the root.
+        if(m_root == BVHNode::NULL_NODE) {
+            m_root = leaf;
+            m_nodes[leaf].m_parent = BVHNode::NULL_NODE;
+            return;
+        }
+
+        //Find the cheapest sibling for the new leaf.
+        const uint32_t sibling = FindBestSibling(leaf);
+
+        //Make a new parent and swap its place with the sibling.
+        //Allocation may grow the pool so take no references before this point.
+        const uint32_t newParent = AllocateNode();
+        const uint32_t oldParent = m_nodes[sibling].m_parent;
+
+        m_nodes[newParent].m_parent = oldParent;
+        m_nodes[newParent].m_childNodes[0] = leaf;
+        m_nodes[newParent].m_childNodes[1] = sibling;
+        m_nodes[leaf].m_parent = newParent;
+        m_nodes[sibling].m_parent = newParent;
+
+        if(oldParent == BVHNode::NULL_NODE) {
+            m_root = newParent;
+        }
         else {
-            //If second node is a leaf.
-            if(n1->IsLeaf())
-            {
-                //Check first nodes children against each other.
-                CheckChildren(n0);
-                //Check first nodes children with second node.
-                if(n1->m_nodeAABB.Collides(&n0->m_nodeAABB)) {
-                    FindPairs(n0->m_childNodes[0], n1);
-                    FindPairs(n0->m_childNodes[1], n1);
+            ReplaceChild(oldParent, sibling, newParent);
+        }
+
+        //After insertion exit the tree while updating all AABB's that were modified to fit properly.
+        for(uint32_t node = newParent; node != BVHNode::NULL_NODE; node = m_nodes[node].m_parent) {
+            UpdateAABB(node);
+            RotateNode(node);
+        }
+    }
+
+    /*!
+     * \brief Finds the best sibling for a leaf using the surface area heuristic.
+     * \param leaf The index of the leaf being inserted.
+     * \return Returns the index of the node the leaf should be paired with.
+     *
+     * Pairing the leaf with a node costs the surface area of their merged box, plus the growth of every
+     * ancestor of that node (the inherited cost). This is a branch and bound search, nodes are visited
+     * cheapest first and a subtree is skipped when even a perfect fit below it could not beat the best
+     * cost found so far, since going deeper can only add to the inherited cost.
+     */
+    uint32_t FindBestSibling(uint32_t leaf) {
+        const BVHNode& n = m_nodes[leaf];
+        const float leafArea = n.GetSurfaceArea();
+
+        uint32_t bestSibling = m_root;
+        float bestCost = BVHNode::MergedSurfaceArea(m_nodes[m_root], n);
+
+        //Min heap of candidates ordered by inherited cost.
+        m_searchHeap.clear();
+        m_searchHeap.emplace_back(0.0f, m_root);
+
+        while(!m_searchHeap.empty()) {
+            std::pop_heap(m_searchHeap.begin(), m_searchHeap.end(), std::greater<SearchCandidate>());
+            const float inheritedCost = m_searchHeap.back().first;
+            const uint32_t index = m_searchHeap.back().second;
+            m_searchHeap.pop_back();
+
+            const BVHNode& candidate = m_nodes[index];
+            //Cost of making this node the sibling.
+            const float directCost = BVHNode::MergedSurfaceArea(candidate, n);
+            const float cost = directCost + inheritedCost;
+            if(cost < bestCost) {
+                bestCost = cost;
+                bestSibling = index;
+            }
+
+            //Anything below this node also has to grow this node to hold the leaf.
+            if(!candidate.IsLeaf()) {
+                const float childInheritedCost = inheritedCost + directCost - candidate.GetSurfaceArea();
+                //The cheapest possible result below is the leaf on its own plus the inherited growth.
+                if(leafArea + childInheritedCost < bestCost) {
+                    m_searchHeap.emplace_back(childInheritedCost, candidate.m_childNodes[0]);
+                    std::push_heap(m_searchHeap.begin(), m_searchHeap.end(), std::greater<SearchCandidate>());
+                    m_searchHeap.emplace_back(childInheritedCost, candidate.m_childNodes[1]);
+                    std::push_heap(m_searchHeap.begin(), m_searchHeap.end(), std::greater<SearchCandidate>());
                 }
-                
             }
-            //If both first and second nodes are branches
-            else {
-                //Check both first and second nodes children against themselves.
-                CheckChildren(n0);
-                CheckChildren(n1);
-                //Check first and second nodes children against each other.
-                if(n0->m_nodeAABB.Collides(&n1->m_nodeAABB)) {
-                    FindPairs(n0->m_childNodes[0], n1->m_childNodes[0]);
-                    FindPairs(n0->m_childNodes[0], n1->m_childNodes[1]);
-                    FindPairs(n0->m_childNodes[1], n1->m_childNodes[0]);
-                    FindPairs(n0->m_childNodes[1], n1->m_childNodes[1]);
+        }
+
+        return bestSibling;
+    }
+
+    /*!
+     * \brief Performs a local tree rotation if it reduces the surface area of the tree.
+     * \param node The index of the branch to try rotating.
+     *
+     * For a node A with children B and C, each child may be swapped with one of the other child's children.
+     * The swap only changes the box of the child that receives the grandchild, so the rotation that
+     * shrinks that box the most is applied. Nothing happens if no swap helps.
+     */
+    void RotateNode(uint32_t node) {
+        const BVHNode& a = m_nodes[node];
+        //Rotations need grandchildren.
+        if(a.m_height < 2) {
+            return;
+        }
+
+        const uint32_t b = a.m_childNodes[0];
+        const uint32_t c = a.m_childNodes[1];
+
+        //Best swap found so far, swapping "child" with the grandchild "grandChild".
+        uint32_t bestChild = BVHNode::NULL_NODE;
+        uint32_t bestGrandChild = BVHNode::NULL_NODE;
+        float bestDiff = 0.0f;
+
+        //Try swapping b with either of c's children, then c with either of b's children.
+        const uint32_t children[2] = { b, c };
+        for(int i = 0; i < 2; i++) {
+            const uint32_t child = children[i];
+            const uint32_t other = children[1 - i];
+            const BVHNode& o = m_nodes[other];
+            if(o.IsLeaf()) {
+                continue;
+            }
+            const float baseArea = o.GetSurfaceArea();
+            for(int j = 0; j < 2; j++) {
+                //After the swap "other" holds "child" and the grandchild that stays.
+                const uint32_t grandChild = o.m_childNodes[j];
+                const uint32_t kept = o.m_childNodes[1 - j];
+                const float diff = BVHNode::MergedSurfaceArea(m_nodes[child], m_nodes[kept]) - baseArea;
+                if(diff < bestDiff) {
+                    bestDiff = diff;
+                    bestChild = child;
+                    bestGrandChild = grandChild;
                 }
-                
+            }
+        }
 
+        if(bestChild == BVHNode::NULL_NODE) {
+            return;
+        }
+
+        //Swap the child and grandchild.
+        const uint32_t other = m_nodes[bestGrandChild].m_parent;
+        ReplaceChild(node, bestChild, bestGrandChild);
+        ReplaceChild(other, bestGrandChild, bestChild);
+        m_nodes[bestGrandChild].m_parent = node;
+        m_nodes[bestChild].m_parent = other;
+
+        //Refit the node that changed and then this node.
+        UpdateAABB(other);
+        UpdateAABB(node);
+    }
+
+    /*!
+     * \brief Unlinks a leaf from the tree without releasing it.
+     * \param leaf The index of the leaf to unlink.
+     *
+     * The leaf's sibling takes the place of their shared parent, the parent is returned to the free list
+     * and all branches above are refit.
+     */
+    void RemoveLeaf(uint32_t leaf) {
+        //If this is the root the tree is now empty.
+        if(leaf == m_root) {
+            m_root = BVHNode::NULL_NODE;
+            return;
+        }
+
+        //First get the parent node, of node being removed.
+        const uint32_t parent = m_nodes[leaf].m_parent;
+        const uint32_t grandParent = m_nodes[parent].m_parent;
+        //Get the sibling of the node being removed.
+        const uint32_t sibling = GetSibling(leaf);
+
+        //If the parent has a parent, replace the parent with the sibling.
+        if(grandParent != BVHNode::NULL_NODE) {
+            ReplaceChild(grandParent, parent, sibling);
+            m_nodes[sibling].m_parent = grandParent;
+
+            //Refit everything above the removed parent.
+            for(uint32_t node = grandParent; node != BVHNode::NULL_NODE; node = m_nodes[node].m_parent) {
+                UpdateAABB(node);
             }
         }
+        //If no grandparent then parent must be root node.
+        else {
+            m_root = sibling;
+            m_nodes[sibling].m_parent = BVHNode::NULL_NODE;
+        }
+
+        //The obsolete parent goes back on the free list.
+        FreeNode(parent);
+        m_nodes[leaf].m_parent = BVHNode::NULL_NODE;
+    }
 
+    /*!
+     * \brief Gets the sibling node of a node.
+     * \param node The index of the node.
+     * \return Returns the index of the sibling node.
+     */
+    uint32_t GetSibling(uint32_t node) const {
+        const BVHNode& parent = m_nodes[m_nodes[node].m_parent];
+        return parent.m_childNodes[0] == node ? parent.m_childNodes[1] : parent.m_childNodes[0];
     }
 
     /*!
-     * \brief Checks both child nodes of node specified against each other.
-     * \param node A pointer to the node whose children you wish to check.
-     * 
-     * A utility function that checks if a node has already been checked, and will
-     * attempt to find collision pairs from both child nodes of the node specified.
+     * \brief Replaces one child of a branch with another node.
+     * \param parent The index of the branch.
+     * \param oldChild The index of the child being replaced.
+     * \param newChild The index of the replacement.
      */
-    void CheckChildren(BVHNode* node) {
-        //Has node already been checked
-        if(!node->m_childrenChecked) {
-            //Find Pairs from both nodes.
-            FindPairs(node->m_childNodes[0], node->m_childNodes[1]);
-            //Mark the node as checked.
-            node->m_childrenChecked = true;
+    void ReplaceChild(uint32_t parent, uint32_t oldChild, uint32_t newChild) {
+        BVHNode& p = m_nodes[parent];
+        if(p.m_childNodes[0] == oldChild) {
+            p.m_childNodes[0] = newChild;
+        }
+        else {
+            p.m_childNodes[1] = newChild;
+        }
+    }
+
+    /*!
+     * \brief Finds all leaves that are requiring reinsertion into the tree.
+     * \param invalidNodes Reference to invalidNode storage.
+     *
+     * Scans the node pool linearly, checking to see if each leaf's object AABB still fits inside the
+     * Nodes bounds, if not then the node needs to be reinserted. Leaves that are far larger than their
+     * object's current displacement needs are reinserted too, so they shrink once the object slows down.
+     * The pool is split into one range per job, and the ranges are joined back in order so the
+     * list is always sorted by node index.
+     */
+    void FindInvalidNodes(std::vector<uint32_t>& invalidNodes) {
+        const uint32_t nodeCount = static_cast<uint32_t>(m_nodes.size());
+        const uint32_t numJobs = GetParallelJobCount(nodeCount, REFIT_LEAVES_PER_JOB);
+        if(m_jobInvalidNodes.size() < numJobs) {
+            m_jobInvalidNodes.resize(numJobs);
+        }
+
+        ParallelFor(nodeCount, numJobs, [this](uint32_t job, uint32_t begin, uint32_t end) {
+            std::vector<uint32_t>& found = m_jobInvalidNodes[job];
+            found.clear();
+            for(uint32_t i = begin; i < end; i++) {
+                const BVHNode& node = m_nodes[i];
+                //Only leaves hold an object, branches and free nodes are skipped, as are sleeping objects.
+                if(node.m_objectAABB && !node.m_objectAABB->IsSleeping() && (!node.Contains(*node.m_objectAABB) || IsLoose(node))) {
+                    found.push_back(i);
+                }
+            }
+        });
+
+        for(uint32_t job = 0; job < numJobs; job++) {
+            invalidNodes.insert(invalidNodes.end(), m_jobInvalidNodes[job].begin(), m_jobInvalidNodes[job].end());
+        }
+    }
+
+    /*!
+     * \brief Checks whether a leaf is much larger than the bounds its object would be given now.
+     * \param leaf The leaf node.
+     * \return Returns true if the leaf is more than the shrink ratio times its predicted size on any axis.
+     */
+    bool IsLoose(const BVHNode& leaf) const {
+        const AABB& aabb = *leaf.m_objectAABB;
+        const glm::vec3 predicted = aabb.m_maxBounds - aabb.m_minBounds + glm::vec3(2.0f * m_margin) + glm::abs(aabb.m_displacement * m_predictionScale);
+        return glm::any(glm::greaterThan(leaf.m_maxBounds - leaf.m_minBounds, predicted * m_shrinkRatio));
+    }
+
+    /*!
+     * \brief Splits the pair search into tasks down to a depth.
+     * \param first The first node.
+     * \param second The second node, or NULL_NODE to search inside the first node's subtree.
+     * \param depth How many more levels to split before making a task.
+     *
+     * Pairs of subtrees whose bounds do not touch are dropped here rather than becoming empty tasks.
+     */
+    void AddPairTasks(uint32_t first, uint32_t second, uint32_t depth) {
+        const BVHNode& n0 = m_nodes[first];
+        if(second == BVHNode::NULL_NODE) {
+            if(n0.IsLeaf()) {
+                return;
+            }
+            if(depth == 0) {
+                m_pairTasks.push_back({ first, second, 0, 0, 0 });
+                return;
+            }
+            AddPairTasks(n0.m_childNodes[0], BVHNode::NULL_NODE, depth - 1);
+            AddPairTasks(n0.m_childNodes[1], BVHNode::NULL_NODE, depth - 1);
+            AddPairTasks(n0.m_childNodes[0], n0.m_childNodes[1], depth - 1);
+            return;
+        }
+
+        const BVHNode& n1 = m_nodes[second];
+        if(depth == 0 || (n0.IsLeaf() && n1.IsLeaf())) {
+            m_pairTasks.push_back({ first, second, 0, 0, 0 });
+            return;
+        }
+        if(!n0.Collides(n1)) {
+            return;
+        }
+
+        //Split the larger branch.
+        if(n0.IsLeaf() || (!n1.IsLeaf() && n1.GetSurfaceArea() > n0.GetSurfaceArea())) {
+            AddPairTasks(first, n1.m_childNodes[0], depth - 1);
+            AddPairTasks(first, n1.m_childNodes[1], depth - 1);
+        }
+        else {
+            AddPairTasks(n0.m_childNodes[0], second, depth - 1);
+            AddPairTasks(n0.m_childNodes[1], second, depth - 1);
+        }
+    }
+
+    /*!
+     * \brief Finds every colliding pair inside a subtree.
+     * \param node Index of the root of the subtree.
+     * \param buffer The buffer to add pairs and checks to.
+     *
+     * The pairs inside each child are found, then the pairs between the two children.
+     */
+    void SelfPairs(uint32_t node, PairBuffer& buffer) const {
+        const BVHNode& n = m_nodes[node];
+        if(n.IsLeaf()) {
+            return;
+        }
+        SelfPairs(n.m_childNodes[0], buffer);
+        SelfPairs(n.m_childNodes[1], buffer);
+        CrossPairs(n.m_childNodes[0], n.m_childNodes[1], buffer);
+    }
+
+    /*!
+     * \brief Finds every colliding pair with one AABB in each of two subtrees.
+     * \param i0 Index of the first subtree.
+     * \param i1 Index of the second subtree.
+     * \param buffer The buffer to add pairs and checks to.
+     */
+    void CrossPairs(uint32_t i0, uint32_t i1, PairBuffer& buffer) const {
+        const BVHNode& n0 = m_nodes[i0];
+        const BVHNode& n1 = m_nodes[i1];
+
+        //If both nodes are leaves check the object AABB's.
+        if(n0.IsLeaf() && n1.IsLeaf()) {
+            buffer.m_checksMade++;
+            if(n0.m_objectAABB->Collides(n1.m_objectAABB)) {
+                buffer.m_pairs.emplace_back(n0.m_objectAABB, n1.m_objectAABB);
+            }
+            return;
+        }
+
+        //Only descend if the two nodes collide.
+        if(!n0.Collides(n1)) {
+            return;
+        }
+
+        if(n0.IsLeaf()) {
+            CrossPairs(i0, n1.m_childNodes[0], buffer);
+            CrossPairs(i0, n1.m_childNodes[1], buffer);
+        }
+        else if(n1.IsLeaf()) {
+            CrossPairs(n0.m_childNodes[0], i1, buffer);
+            CrossPairs(n0.m_childNodes[1], i1, buffer);
+        }
+        else {
+            CrossPairs(n0.m_childNodes[0], n1.m_childNodes[0], buffer);
+            CrossPairs(n0.m_childNodes[0], n1.m_childNodes[1], buffer);
+            CrossPairs(n0.m_childNodes[1], n1.m_childNodes[0], buffer);
+            CrossPairs(n0.m_childNodes[1], n1.m_childNodes[1], buffer);
         }
     }
 
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <cfloat>
+#include <cstring>
+#include <algorithm>
+#include "AABB.h"
+#include "AlignedAllocation.h"
+
+/*!
+ * \class BoundsStore "BoundsStore.h"
+ * \brief Keeps the bounds of many AABB's as separate arrays of each axis, so they can be tested several at a time.
+ *
+ * Each of the six arrays is aligned to 32 bytes and padded to a multiple of 8 entries, so the SIMD kernels can
+ * always load whole registers. Padding entries hold empty bounds that can never overlap anything.
+ */
+class BoundsStore
+{
+public:
+    static constexpr uint32_t WIDTH = 8;    /*!< The array length is always a multiple of this.*/
+
+    /*!
+     * \brief Default Constructor
+     */
+    BoundsStore() = default;
+
+    /*!
+     * \brief Default Destructor
+     */
+    ~BoundsStore() {
+        _aligned_free(m_data);
+    }
+
+    BoundsStore(const BoundsStore&) = delete;
+    BoundsStore& operator=(const BoundsStore&) = delete;
+
+    /*!
+     * \brief Sets the number of AABB's held, keeping the bounds already stored.
+     * \param count The new number of AABB's.
+     */
+    void Resize(uint32_t count) {
+        const uint32_t capacity = (count + WIDTH - 1) & ~(WIDTH - 1);
+        if(capacity > m_capacity) {
+            Grow((std::max)(capacity, m_capacity * 2));
+        }
+
+        //Anything past the end is emptied so it never overlaps.
+        for(uint32_t i = count; i < m_size; i++) {
+            SetEmpty(i);
+        }
+        m_size = count;
+    }
+
+    /*!
+     * \brief Copies the bounds of an AABB into the store.
+     * \param index The slot to write to.
+     * \param aabb The AABB to copy.
+     */
+    inline void Set(uint32_t index, const AABB& aabb) {
+        m_minX[index] = aabb.m_minBounds.x;
+        m_minY[index] = aabb.m_minBounds.y;
+        m_minZ[index] = aabb.m_minBounds.z;
+        m_maxX[index] = aabb.m_maxBounds.x;
+        m_maxY[index] = aabb.m_maxBounds.y;
+        m_maxZ[index] = aabb.m_maxBounds.z;
+    }
+
+    /*!
+     * \brief Removes every AABB, keeping the memory.
+     */
+    void Clear() {
+        Resize(0);
+    }
+
+    inline uint32_t Size() const { return m_size; }
+    inline uint32_t Capacity() const { return m_capacity; }
+
+    inline const float* MinX() const { return m_minX; }
+    inline const float* MinY() const { return m_minY; }
+    inline const float* MinZ() const { return m_minZ; }
+    inline const float* MaxX() const { return m_maxX; }
+    inline const float* MaxY() const { return m_maxY; }
+    inline const float* MaxZ() const { return m_maxZ; }
+
+private:
+    float* m_data = nullptr;    /*!< One block holding all six arrays.*/
+    float* m_minX = nullptr;
+    float* m_minY = nullptr;
+    float* m_minZ = nullptr;
+    float* m_maxX = nullptr;
+    float* m_maxY = nullptr;
+    float* m_maxZ = nullptr;
+    uint32_t m_size = 0;        /*!< Number of AABB's held.*/
+    uint32_t m_capacity = 0;    /*!< Length of each array, always a multiple of WIDTH.*/
+
+    inline void SetEmpty(uint32_t index) {
+        m_minX[index] = m_minY[index] = m_minZ[index] = FLT_MAX;
+        m_maxX[index] = m_maxY[index] = m_maxZ[index] = -FLT_MAX;
+    }
+
+    /*!
+     * \brief Reallocates the arrays with a larger capacity.
+     * \param capacity The new length of each array, must be a multiple of WIDTH.
+     */
+    void Grow(uint32_t capacity) {
+        float* data = static_cast<float*>(_aligned_malloc(sizeof(float) * capacity * 6, BYTE32));
+        float* arrays[6];
+        for(uint32_t a = 0; a < 6; a++) {
+            arrays[a] = data + a * capacity;
+        }
+
+        const float* oldArrays[6] = { m_minX, m_minY, m_minZ, m_maxX, m_maxY, m_maxZ };
+        for(uint32_t a = 0; a < 6; a++) {
+            if(m_capacity > 0) {
+                std::memcpy(arrays[a], oldArrays[a], sizeof(float) * m_capacity);
+            }
+        }
+        _aligned_free(m_data);
+
+        m_data = data;
+        m_minX = arrays[0];
+        m_minY = arrays[1];
+        m_minZ = arrays[2];
+        m_maxX = arrays[3];
+        m_maxY = arrays[4];
+        m_maxZ = arrays[5];
+
+        for(uint32_t i = m_capacity; i < capacity; i++) {
+            SetEmpty(i);
+        }
+        m_capacity = capacity;
+    }
+};
@@ -1,10 +1,12 @@
 #pragma once
 #include "AABB.h"
 #include "DebugRenderer.h"
-#include <list>
-
-typedef std::pair<AABB*, AABB*> CollisionPair;
-typedef std::list<CollisionPair> CollisionPairList;
+#include "PairManager.h"
+#include "SceneQuery.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
 
 class BroadPhase
 {
@@ -14,15 +16,145 @@ public:
 
     virtual void Add(AABB* aabb) = 0;
     virtual void Remove(AABB* aabb) = 0;
+    virtual void Relocate(AABB* aabb) = 0;
     virtual void Clear() = 0;
     virtual void Update() = 0;
 
     virtual bool* GetShowDebug() = 0;
     virtual int GetChecksMade() { return 0; };
+    virtual int GetReinsertsMade() { return 0; };
+    virtual float GetTreeCost() { return 0.0f; };
+    virtual int GetTreeDepth() { return 0; };
+
+    virtual void CalculatePairs(PairManager& pairs) = 0;
+
+    /*!
+     * \brief Finds the nearest AABB hit by a ray.
+     * \param ray The ray to cast.
+     * \param hit Receives the nearest hit.
+     * \return Returns true if anything was hit.
+     *
+     * The base version tests every AABB, broad phases with a tree override the queries to search it instead.
+     */
+    virtual bool RaycastClosest(const Ray& ray, RaycastHit& hit) {
+        bool found = false;
+        float nearest = ray.m_maxDistance;
+        GatherAABBs(m_queryAABBs);
+        for(AABB* aabb : m_queryAABBs) {
+            float distance;
+            if(SceneQuery::RayIntersectsBox(ray, aabb->GetMinBounds(), aabb->GetMaxBounds(), nearest, distance)) {
+                hit = SceneQuery::MakeHit(ray, aabb, distance);
+                nearest = distance;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    /*!
+     * \brief Finds every AABB hit by a ray.
+     * \param ray The ray to cast.
+     * \param hits The buffer to write the hits to, sorted nearest first.
+     * \param maxHits The size of the buffer, the search stops once it is full.
+     * \return Returns the number of hits written.
+     */
+    virtual uint32_t RaycastAll(const Ray& ray, RaycastHit* hits, uint32_t maxHits) {
+        uint32_t count = 0;
+        GatherAABBs(m_queryAABBs);
+        for(AABB* aabb : m_queryAABBs) {
+            if(count == maxHits) {
+                break;
+            }
+            float distance;
+            if(SceneQuery::RayIntersectsBox(ray, aabb->GetMinBounds(), aabb->GetMaxBounds(), ray.m_maxDistance, distance)) {
+                hits[count++] = SceneQuery::MakeHit(ray, aabb, distance);
+            }
+        }
+        SortHits(hits, count);
+        return count;
+    }
+
+    /*!
+     * \brief Finds every AABB overlapping a box.
+     * \param bounds The box to test.
+     * \param results The buffer to write the AABB's to.
+     * \param maxResults The size of the buffer, the search stops once it is full.
+     * \return Returns the number of AABB's written.
+     */
+    virtual uint32_t QueryOverlap(const AABB& bounds, AABB** results, uint32_t maxResults) {
+        uint32_t count = 0;
+        GatherAABBs(m_queryAABBs);
+        for(AABB* aabb : m_queryAABBs) {
+            if(count == maxResults) {
+                break;
+            }
+            if(SceneQuery::BoxesOverlap(aabb->GetMinBounds(), aabb->GetMaxBounds(), bounds.GetMinBounds(), bounds.GetMaxBounds())) {
+                results[count++] = aabb;
+            }
+        }
+        return count;
+    }
 
-    virtual CollisionPairList CalculatePairs() = 0;
+    /*!
+     * \brief Finds every AABB inside or crossing a frustum.
+     * \param frustum The frustum to test.
+     * \param results The buffer to write the AABB's to.
+     * \param maxResults The size of the buffer, the search stops once it is full.
+     * \return Returns the number of AABB's written.
+     */
+    virtual uint32_t QueryFrustum(const Frustum& frustum, AABB** results, uint32_t maxResults) {
+        uint32_t count = 0;
+        GatherAABBs(m_queryAABBs);
+        for(AABB* aabb : m_queryAABBs) {
+            if(count == maxResults) {
+                break;
+            }
+            if(frustum.TestBox(aabb->GetMinBounds(), aabb->GetMaxBounds()) != Frustum::OUTSIDE) {
+                results[count++] = aabb;
+            }
+        }
+        return count;
+    }
 
 protected:
-    DebugCuboid m_debugCuboid;
+    /*!
+     * \brief Gives an AABB joining the broad phase a unique ID, which its pairs are keyed on.
+     *
+     * The IDs are shared by every broad phase, so an AABB moved between them never takes an ID already in use.
+     */
+    static void AssignUniqueID(AABB* aabb) {
+        static std::atomic<uint32_t> nextID(0);
+        aabb->m_uniqueID = nextID++;
+    }
+
+    /*!
+     * \brief Fills a list with every AABB in the broad phase.
+     * \param aabbs The list to fill, it is cleared first.
+     */
+    virtual void GatherAABBs(std::vector<AABB*>& aabbs) = 0;
+
+    /*!
+     * \brief Sorts hits nearest first.
+     */
+    static void SortHits(RaycastHit* hits, uint32_t count) {
+        std::sort(hits, hits + count, [](const RaycastHit& a, const RaycastHit& b) { return a.m_distance < b.m_distance; });
+    }
+
+    /*!
+     * \brief Gets the cuboid used to draw the debug boxes, creating it the first time.
+     *
+     * The cuboid owns GL buffers, so it is only made once something is drawn. This lets a broad phase run without a GL context.
+     */
+    DebugCuboid& GetDebugCuboid() {
+        if(!m_debugCuboid) {
+            m_debugCuboid = std::make_unique<DebugCuboid>();
+        }
+        return *m_debugCuboid;
+    }
+
+    std::unique_ptr<DebugCuboid> m_debugCuboid;
     DebugRenderer* m_debugRenderer;
+
+private:
+    std::vector<AABB*> m_queryAABBs;    /*!< Every AABB, gathered for the base queries.*/
 };
@@ -0,0 +1,41 @@
+#pragma once
+#include "ECS_System.h"
+#include "AABBComponent.h"
+#include "RigidBodyComponent.h"
+
+/*!
+ * \brief Gives the broad phase a hint of how far each rigid body will move over the next step.
+ *
+ * Must run after the PhysicsMovementSystem so the momentum is up to date. Objects without a rigid body
+ * keep a zero displacement, so they only get the broad phases isotropic margin.
+ * Continuous bodies also pass on the pose they started the step at, so their AABB covers the whole sweep.
+ * Each AABB is also told whether its body is asleep, so bodies woken by a force since the last step are
+ * recalculated again.
+ */
+class BroadPhaseHintSystem : public BaseECSSystem
+{
+public:
+    BroadPhaseHintSystem() : BaseECSSystem()
+    {
+        AddComponentType(AABBComponent::ID);
+        AddComponentType(RigidBodyComponent::ID);
+    }
+
+    virtual void UpdateComponents(float deltaTime, std::vector<std::vector<BaseECSComponent*>>& componentArrays) override
+    {
+        for (uint32_t i = 0; i < componentArrays[0].size(); i++)
+        {
+            AABB& aabb = ((AABBComponent*)componentArrays[0][i])->m_aabb;
+            const POD_RigidBody& body = ((RigidBodyComponent*)componentArrays[1][i])->m_rigidBody;
+
+            aabb.SetSleeping(body.IsSleeping());
+            aabb.SetDisplacement(body.GetLinearVelocity() * deltaTime);
+            if(body.IsContinuous() && !body.IsSleeping()) {
+                aabb.SetSweep(body.GetSweepPosition(), body.GetSweepRotation());
+            }
+            else {
+                aabb.ClearSweep();
+            }
+        }
+    }
+};
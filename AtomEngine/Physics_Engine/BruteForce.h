@@ -1,49 +1,121 @@
 #pragma once
 
 #include "BroadPhase.h"
-#include <set>
+#include "BoundsStore.h"
+#include "OverlapKernels.h"
+#include <vector>
 
+/*!
+ * \class BruteForce "BruteForce.h"
+ * \brief Tests every AABB against every other AABB.
+ *
+ * In batched mode the bounds are copied into a BoundsStore each time the pairs are found, and each AABB is tested against
+ * all the AABB's after it with the widest SIMD kernel the CPU supports.
+ */
 class BruteForce : public BroadPhase
 {
 public:
-    BruteForce(){};
+    BruteForce(DebugRenderer* debugRenderer, bool batched = true) :
+        BroadPhase(debugRenderer),
+        m_batched(batched),
+        m_overlap(OverlapKernels::GetOverlapFunction()) {};
     virtual ~BruteForce(){};
 
 
     void Add(AABB* aabb) override {
-        m_aabbList.insert(aabb);
+        AssignUniqueID(aabb);
+        aabb->m_proxyID = static_cast<uint32_t>(m_aabbList.size());
+        m_aabbList.push_back(aabb);
     }
 
     void Remove(AABB* aabb) override {
-        m_aabbList.erase(aabb);
+        //Move the last AABB into the gap.
+        const uint32_t index = aabb->m_proxyID;
+        m_aabbList[index] = m_aabbList.back();
+        m_aabbList[index]->m_proxyID = index;
+        m_aabbList.pop_back();
+        aabb->m_proxyID = AABB::NULL_PROXY;
+    }
+
+    void Relocate(AABB* aabb) override {
+        m_aabbList[aabb->m_proxyID] = aabb;
     }
 
     void Clear() override {
+        for(AABB* aabb : m_aabbList) {
+            aabb->m_proxyID = AABB::NULL_PROXY;
+        }
         m_aabbList.clear();
     }
 
-    void Update() override {
-        //Not used in this broadphase
+    //The bounds are copied when the pairs are found, so AABB's added or removed after Update are never missed.
+    void Update() override {}
+
+    bool* GetShowDebug() override {
+        return &m_showDebug;
+    }
+
+    int GetChecksMade() override {
+        return m_checksMade;
     }
 
-    CollisionPairList CalculatePairs() override
+    void CalculatePairs(PairManager& pairs) override
     {
-        m_collisionPairs.clear();
-        for (auto i = m_aabbList.begin(); i != m_aabbList.end(); ++i) {
-            auto jBegin = i;
-            for(auto j = ++jBegin; j != m_aabbList.end(); ++j) {
-                AABB* a = *i;
-                AABB* b = *j;
-
-                if(a->Collides(b)) {
-                    m_collisionPairs.emplace_back(a, b);
+        const uint32_t count = static_cast<uint32_t>(m_aabbList.size());
+        m_checksMade = count > 1 ? static_cast<int>(count * (count - 1) / 2) : 0;
+
+        if(m_batched) {
+            m_bounds.Resize(count);
+            for(uint32_t i = 0; i < count; i++) {
+                m_bounds.Set(i, *m_aabbList[i]);
+            }
+
+            m_hits.resize(count);
+            for(uint32_t i = 0; i + 1 < count; i++) {
+                const uint32_t hitCount = m_overlap(m_bounds, i, i + 1, count, m_hits.data());
+                for(uint32_t h = 0; h < hitCount; h++) {
+                    pairs.AddPair(m_aabbList[i], m_aabbList[m_hits[h]]);
+                }
+            }
+            return;
+        }
+
+        for(uint32_t i = 0; i < count; i++) {
+            for(uint32_t j = i + 1; j < count; j++) {
+                if(m_aabbList[i]->Collides(m_aabbList[j])) {
+                    pairs.AddPair(m_aabbList[i], m_aabbList[j]);
                 }
             }
         }
-        return m_collisionPairs;
+    }
+
+    /*!
+     * \brief Sets whether the pairs are found with the SIMD kernels or one pair at a time.
+     */
+    void SetBatched(bool batched) {
+        m_batched = batched;
+    }
+
+    /*!
+     * \brief Sets the instruction set of the kernel used in batched mode.
+     * \param set The instruction set, if the CPU does not support it the widest one it does support is used.
+     */
+    void SetInstructionSet(OverlapKernels::InstructionSet set) {
+        m_overlap = OverlapKernels::GetOverlapFunction(set);
+    }
+
+protected:
+    void GatherAABBs(std::vector<AABB*>& aabbs) override {
+        aabbs = m_aabbList;
     }
 
 private:
-    std::set<AABB*> m_aabbList;
-    CollisionPairList m_collisionPairs;
+    std::vector<AABB*> m_aabbList;
+    bool m_showDebug = false;
+    int m_checksMade = 0;   /*!< A counter for how many actual checks were performed during this broadphase.*/
+
+    bool m_batched;                             /*!< Whether the SIMD kernels are used.*/
+    OverlapKernels::OverlapFunction m_overlap;  /*!< The kernel used in batched mode.*/
+    BoundsStore m_bounds;                       /*!< Bounds of every AABB, in the same order as the list.*/
+    std::vector<uint32_t> m_hits;               /*!< Indices of the AABB's found by the kernel.*/
 };
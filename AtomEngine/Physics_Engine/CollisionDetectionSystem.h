@@ -1,29 +1,37 @@
 #pragma once
 #include "ECS_System.h"
+#include "ECS_Listener.h"
 #include "AABBComponent.h"
 #include "TransformComponent.h"
 #include "MeshComponent.h"
 #include "BroadPhase.h"
 #include "LogManager.h"
-#include <set>
+#include "ProfilerManager.h"
 #include "NarrowPhase.h"
+#include "ContinuousCollision.h"
 
-class CollisionDetectionSystem : public BaseECSSystem
+class CollisionDetectionSystem : public BaseECSSystem, public ECSListener
 {
 public:
     CollisionDetectionSystem() {
         AddComponentType(TransformComponent::ID);
         AddComponentType(AABBComponent::ID);
         AddComponentType(MeshComponent::ID);
+
+        AddListenedType(AABBComponent::ID);
     }
 
     ~CollisionDetectionSystem() override {
         delete m_broadPhase;
     }
 
-    template<class T>
-    void SetBroadPhase(DebugRenderer* debugRenderer) {
-        m_broadPhase = new T(debugRenderer);
+    /*!
+     * \brief Sets the broad phase, this must be called before the system is added as a listener to the ECS.
+     */
+    template<class T, class... Args>
+    void SetBroadPhase(DebugRenderer* debugRenderer, Args&&... args) {
+        delete m_broadPhase;
+        m_broadPhase = new T(debugRenderer, std::forward<Args>(args)...);
     }
 
     template<class T>
@@ -33,9 +41,8 @@ public:
 
     virtual void UpdateComponents(float deltaTime, std::vector<std::vector<BaseECSComponent*>>& componentArrays) override
     {
-
-        //collate all the aabb's into a set
-        std::set<AABB*> newList;
+        //Membership of the broad phase is handled by the component events, so only the bounds need updating here.
+        //Sleeping bodies have not moved, so their bounds are still right.
         for (uint32_t i = 0; i < componentArrays[0].size(); i++)
         {
             POD_Transform* transform = &((TransformComponent*)componentArrays[0][i])->m_transform;
@@ -43,58 +50,116 @@ public:
             POD_Mesh* mesh = &((MeshComponent*)componentArrays[2][i])->m_mesh;
 
             aabb->IsColliding() = AABB::NO_COLLISION;
-            aabb->RecalculateAABB(transform, mesh);
-            newList.insert(aabb);
-            
+            if(!aabb->IsSleeping()) {
+                aabb->RecalculateAABB(transform, mesh);
+            }
         }
 
-        //find which aabb's are no longer in existence
-        //and any new ones that need to be added
-        HandleNewAndOld(newList);
-
         //m_broadPhase->SetShowDebug(true);
         Profiler::Instance()->Start("Update BroadPhase");
         m_broadPhase->Update();
         Profiler::Instance()->End("Update BroadPhase");
 
         Profiler::Instance()->Start("BroadPhase Collision Detection");
-        auto collisions = m_broadPhase->CalculatePairs();
+        m_pairManager.BeginFrame();
+        m_broadPhase->CalculatePairs(m_pairManager);
+        m_pairManager.EndFrame();
         Profiler::Instance()->End("BroadPhase Collision Detection");
 
-        Logger::Instance()->LogInfo("BruteForce Checks: " + std::to_string(m_aabbList.size() * m_aabbList.size()));
+        Logger::Instance()->LogInfo("BruteForce Checks: " + std::to_string(componentArrays[0].size() * componentArrays[0].size()));
         Logger::Instance()->LogInfo("Actual Checks Made: " + std::to_string(m_broadPhase->GetChecksMade()));
-        Logger::Instance()->LogInfo("Potential Collisions Found: " + std::to_string(collisions.size()));
+        Logger::Instance()->LogInfo("Potential Collisions Found: " + std::to_string(m_pairManager.GetPairCount()));
+
+        Profiler::Instance()->Start("Continuous Collision Detection");
+        m_continuousCollision.Solve(m_pairManager);
+        Profiler::Instance()->End("Continuous Collision Detection");
 
         Profiler::Instance()->Start("NarrowPhase Collision Detection");
-        collisions = m_narrowPhase->GetCollisions(collisions);
+        m_narrowPhase->GetCollisions(m_pairManager);
         Profiler::Instance()->End("NarrowPhase Collision Detection");
+
+        if(m_logStats) {
+            LogStats();
+        }
     }
 
-    bool* GetShowBroadphaseDebug() {
-        return m_broadPhase->GetShowDebug();
+    void OnComponentAdded(EntityHandle /*entity*/, uint32_t /*componentID*/, BaseECSComponent* component) override {
+        if(m_broadPhase) {
+            m_broadPhase->Add(&((AABBComponent*)component)->m_aabb);
+        }
     }
 
-private:
-    BroadPhase* m_broadPhase{};
-    NarrowPhase* m_narrowPhase{};
+    void OnComponentRemoved(EntityHandle /*entity*/, uint32_t /*componentID*/, BaseECSComponent* component) override {
+        AABB* aabb = &((AABBComponent*)component)->m_aabb;
+        //Its pairs are dropped before they are next read, so nothing follows them to the AABB once its memory is reused.
+        m_pairManager.RemoveAABB(aabb);
+        if(m_broadPhase) {
+            m_broadPhase->Remove(aabb);
+        }
+    }
 
-    std::set<AABB*> m_aabbList;
+    void OnComponentMoved(uint32_t /*componentID*/, BaseECSComponent* component) override {
+        AABB* aabb = &((AABBComponent*)component)->m_aabb;
+        m_pairManager.RelocateAABB(aabb);
+        if(m_broadPhase) {
+            m_broadPhase->Relocate(aabb);
+        }
+    }
 
-    void HandleNewAndOld(std::set<AABB*>& newList) {
-        std::set<AABB*> removeList;
-        auto removeIT = std::set_difference(m_aabbList.begin(), m_aabbList.end(), newList.begin(), newList.end(), std::inserter(removeList, removeList.end()));
+    bool* GetShowBroadphaseDebug() {
+        return m_broadPhase->GetShowDebug();
+    }
 
-        std::set<AABB*> addList;
-        auto addIT = std::set_difference(newList.begin(), newList.end(), m_aabbList.begin(), m_aabbList.end(), std::inserter(addList, addList.end()));
+    /*!
+     * \brief Gets whether the broad, continuous and narrow phase stats are logged every frame.
+     *
+     * Off by default, logging every frame is slow enough to skew the timings being measured.
+     */
+    bool* GetLogStats() {
+        return &m_logStats;
+    }
 
-        for (AABB* aabb : removeList) {
-            m_broadPhase->Remove(aabb);
-            m_aabbList.erase(aabb);
-        }
+    /*!
+     * \brief Gets the pairs that began, stayed and ended this frame.
+     */
+    PairManager& GetPairManager() {
+        return m_pairManager;
+    }
 
-        for (AABB* aabb : addList) {
-            m_broadPhase->Add(aabb);
-            m_aabbList.insert(aabb);
-        }
+    /*!
+     * \brief Gets the contact manifolds found by the narrow phase this frame.
+     */
+    ContactBuffer& GetContacts() {
+        return m_narrowPhase->GetContacts();
+    }
+
+private:
+    BroadPhase* m_broadPhase{};
+    NarrowPhase* m_narrowPhase{};
+    PairManager m_pairManager;      /*!< The overlapping pairs, kept from frame to frame.*/
+    ContinuousCollision m_continuousCollision;  /*!< Moves continuous bodies back to their first impact.*/
+    bool m_logStats = false;                    /*!< Whether the stats of each phase are logged every frame.*/
+
+    /*!
+     * \brief Logs the stats of the broad, continuous and narrow phases for this frame.
+     */
+    void LogStats() {
+        Logger::Instance()->LogInfo("BroadPhase Reinserts: " + std::to_string(m_broadPhase->GetReinsertsMade()));
+        Logger::Instance()->LogInfo("BroadPhase Tree Cost: " + std::to_string(m_broadPhase->GetTreeCost()));
+        Logger::Instance()->LogInfo("BroadPhase Tree Depth: " + std::to_string(m_broadPhase->GetTreeDepth()));
+
+        Logger::Instance()->LogInfo("Continuous Swept Pairs: " + std::to_string(m_continuousCollision.GetSweptPairs()));
+        Logger::Instance()->LogInfo("Continuous Impacts: " + std::to_string(m_continuousCollision.GetImpacts()));
+        Logger::Instance()->LogInfo("Continuous Iterations: " + std::to_string(m_continuousCollision.GetTotalIterations()));
+
+        const NarrowPhaseStats& stats = m_narrowPhase->GetStats();
+        Logger::Instance()->LogInfo("NarrowPhase Pairs Tested: " + std::to_string(stats.m_pairsTested));
+        Logger::Instance()->LogInfo("NarrowPhase Collisions Found: " + std::to_string(stats.m_collisionsFound));
+        Logger::Instance()->LogInfo("NarrowPhase Mean Iterations: " + std::to_string(stats.GetMeanIterations()));
+        Logger::Instance()->LogInfo("NarrowPhase Max Iterations: " + std::to_string(stats.m_maxIterations));
+        Logger::Instance()->LogInfo("NarrowPhase Early Outs: " + std::to_string(stats.m_earlyOuts));
+        Logger::Instance()->LogInfo("NarrowPhase Warm Start Hits: " + std::to_string(stats.m_warmStartHits));
+        Logger::Instance()->LogInfo("NarrowPhase Contact Points: " + std::to_string(stats.m_contactPoints));
+        Logger::Instance()->LogInfo("NarrowPhase Analytic Pairs: " + std::to_string(stats.m_analyticPairs));
     }
 };
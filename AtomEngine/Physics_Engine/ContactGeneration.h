@@ -0,0 +1,408 @@
+#pragma once
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include "ContactManifold.h"
+
+/*!
+ * Builds contact points from a contact normal and depth.
+ *
+ * Each collider gives up the face, edge or vertex it presents along the normal. When one of them is a face it
+ * becomes the reference face, and the other feature is clipped against the planes through the reference face's
+ * edges. Points of the clipped feature that are behind the reference face become contacts, reduced to the four
+ * that cover the largest area. Everything is kept in fixed size arrays on the stack.
+ */
+namespace ContactGeneration {
+
+    const uint32_t MAX_FEATURE_POINTS = 32;     /*!< The most points taken from each collider's feature.*/
+    const uint32_t MAX_CLIP_POINTS = 64;        /*!< The most points a clipped polygon can have.*/
+    const float FEATURE_TOLERANCE = 0.01f;      /*!< How far behind its furthest vertex a vertex can be and still belong to a feature, relative to the collider's size.*/
+
+    /*!
+     * \brief Gets a unit vector perpendicular to another.
+     */
+    inline glm::vec3 Perpendicular(const glm::vec3& normal) {
+        const glm::vec3 axis = std::abs(normal.x) < 0.57f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::normalize(glm::cross(normal, axis));
+    }
+
+    /*!
+     * \brief Sorts the points of a flat feature anticlockwise around a normal.
+     * \param points The points, sorted in place.
+     * \param count The number of points.
+     * \param normal The normal to sort around.
+     */
+    inline void SortAround(glm::vec3* points, uint32_t count, const glm::vec3& normal) {
+        glm::vec3 centre(0.0f);
+        for(uint32_t i = 0; i < count; i++) {
+            centre += points[i];
+        }
+        centre /= static_cast<float>(count);
+
+        const glm::vec3 u = Perpendicular(normal);
+        const glm::vec3 v = glm::cross(normal, u);
+        float angles[MAX_FEATURE_POINTS];
+        for(uint32_t i = 0; i < count; i++) {
+            const glm::vec3 offset = points[i] - centre;
+            angles[i] = std::atan2(glm::dot(offset, v), glm::dot(offset, u));
+        }
+        //Features are small, so an insertion sort is enough.
+        for(uint32_t i = 1; i < count; i++) {
+            const float angle = angles[i];
+            const glm::vec3 point = points[i];
+            uint32_t j = i;
+            for(; j > 0 && angles[j - 1] > angle; j--) {
+                angles[j] = angles[j - 1];
+                points[j] = points[j - 1];
+            }
+            angles[j] = angle;
+            points[j] = point;
+        }
+    }
+
+    /*!
+     * \brief Reduces a feature with no area to the two points furthest apart.
+     * \return Returns the new number of points.
+     */
+    inline uint32_t ReduceToSegment(glm::vec3* points, uint32_t count) {
+        uint32_t first = 0;
+        uint32_t second = 0;
+        float furthest = -1.0f;
+        for(uint32_t i = 0; i < count; i++) {
+            for(uint32_t j = i + 1; j < count; j++) {
+                const glm::vec3 offset = points[j] - points[i];
+                const float distance = glm::dot(offset, offset);
+                if(distance > furthest) {
+                    furthest = distance;
+                    first = i;
+                    second = j;
+                }
+            }
+        }
+        const glm::vec3 a = points[first];
+        const glm::vec3 b = points[second];
+        points[0] = a;
+        points[1] = b;
+        return 2;
+    }
+
+    /*!
+     * \brief Gets the normal of a polygon scaled by twice its area.
+     * \param points The points of the polygon, in order around it.
+     * \param count The number of points.
+     */
+    inline glm::vec3 GetAreaNormal(const glm::vec3* points, uint32_t count) {
+        glm::vec3 area(0.0f);
+        for(uint32_t i = 0; i < count; i++) {
+            area += glm::cross(points[i], points[(i + 1) % count]);
+        }
+        return area;
+    }
+
+    /*!
+     * \brief Tests if a feature has area facing along a normal.
+     * \param points The points of the feature, sorted around the normal.
+     * \param count The number of points.
+     * \param normal The normal the feature should face.
+     * \param size The size of the collider, so the test does not depend on scale.
+     */
+    inline bool IsFace(const glm::vec3* points, uint32_t count, const glm::vec3& normal, float size) {
+        return count >= 3 && glm::dot(GetAreaNormal(points, count), normal) > FEATURE_TOLERANCE * size * size;
+    }
+
+    /*!
+     * \brief Clips a polygon to the inside of a plane.
+     * \param input The polygon to clip.
+     * \param inputCount The number of points in the polygon.
+     * \param planeNormal The plane normal, points on the side it faces are kept.
+     * \param planeDistance The plane distance along its normal.
+     * \param output Receives the clipped polygon.
+     * \return Returns the number of points in the clipped polygon.
+     */
+    inline uint32_t ClipPolygon(const glm::vec3* input, uint32_t inputCount, const glm::vec3& planeNormal, float planeDistance, glm::vec3* output) {
+        uint32_t outputCount = 0;
+        for(uint32_t i = 0; i < inputCount && outputCount + 2 <= MAX_CLIP_POINTS; i++) {
+            const glm::vec3& start = input[i];
+            const glm::vec3& end = input[(i + 1) % inputCount];
+            const float startDistance = glm::dot(planeNormal, start) - planeDistance;
+            const float endDistance = glm::dot(planeNormal, end) - planeDistance;
+
+            if(startDistance >= 0.0f) {
+                output[outputCount++] = start;
+            }
+            if((startDistance >= 0.0f) != (endDistance >= 0.0f)) {
+                output[outputCount++] = start + (end - start) * (startDistance / (startDistance - endDistance));
+            }
+        }
+        return outputCount;
+    }
+
+    /*!
+     * \brief Clips a line segment to the inside of a plane.
+     * \return Returns false if none of the segment is inside.
+     */
+    inline bool ClipSegment(glm::vec3& start, glm::vec3& end, const glm::vec3& planeNormal, float planeDistance) {
+        const float startDistance = glm::dot(planeNormal, start) - planeDistance;
+        const float endDistance = glm::dot(planeNormal, end) - planeDistance;
+        if(startDistance < 0.0f && endDistance < 0.0f) {
+            return false;
+        }
+        if(startDistance < 0.0f) {
+            start += (end - start) * (startDistance / (startDistance - endDistance));
+        }
+        else if(endDistance < 0.0f) {
+            end += (start - end) * (endDistance / (endDistance - startDistance));
+        }
+        return true;
+    }
+
+    /*!
+     * \brief Finds the closest points between two line segments.
+     */
+    inline void ClosestPointsOnSegments(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& q0, const glm::vec3& q1, glm::vec3& onP, glm::vec3& onQ) {
+        const glm::vec3 d1 = p1 - p0;
+        const glm::vec3 d2 = q1 - q0;
+        const glm::vec3 r = p0 - q0;
+        const float a = glm::dot(d1, d1);
+        const float e = glm::dot(d2, d2);
+        const float f = glm::dot(d2, r);
+
+        float s = 0.0f;
+        float t = 0.0f;
+        if(a <= FLT_EPSILON && e <= FLT_EPSILON) {
+            onP = p0;
+            onQ = q0;
+            return;
+        }
+        if(a <= FLT_EPSILON) {
+            t = glm::clamp(f / e, 0.0f, 1.0f);
+        }
+        else {
+            const float c = glm::dot(d1, r);
+            if(e <= FLT_EPSILON) {
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            }
+            else {
+                const float b = glm::dot(d1, d2);
+                const float denominator = a * e - b * b;
+                s = denominator > FLT_EPSILON ? glm::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+                t = (b * s + f) / e;
+                if(t < 0.0f) {
+                    t = 0.0f;
+                    s = glm::clamp(-c / a, 0.0f, 1.0f);
+                }
+                else if(t > 1.0f) {
+                    t = 1.0f;
+                    s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+                }
+            }
+        }
+        onP = p0 + d1 * s;
+        onQ = q0 + d2 * t;
+    }
+
+    /*!
+     * \brief Keeps the four points of a manifold that cover the most area, always including the deepest.
+     */
+    inline void ReducePoints(const ContactPoint* points, uint32_t count, const glm::vec3& normal, ContactManifold& manifold) {
+        if(count <= ContactManifold::MAX_POINTS) {
+            for(uint32_t i = 0; i < count; i++) {
+                manifold.m_points[i] = points[i];
+            }
+            manifold.m_pointCount = count;
+            return;
+        }
+
+        //The deepest point, then the point furthest from it.
+        uint32_t chosen[4] = { 0, 0, 0, 0 };
+        for(uint32_t i = 1; i < count; i++) {
+            if(points[i].m_depth > points[chosen[0]].m_depth) {
+                chosen[0] = i;
+            }
+        }
+        const glm::vec3 a = points[chosen[0]].m_position;
+        float best = -1.0f;
+        for(uint32_t i = 0; i < count; i++) {
+            const glm::vec3 offset = points[i].m_position - a;
+            if(glm::dot(offset, offset) > best) {
+                best = glm::dot(offset, offset);
+                chosen[1] = i;
+            }
+        }
+
+        //Then the point making the largest triangle, and the point furthest out on the other side of the first edge.
+        const glm::vec3 edge = points[chosen[1]].m_position - a;
+        float area = 0.0f;
+        best = -1.0f;
+        for(uint32_t i = 0; i < count; i++) {
+            const float signedArea = glm::dot(glm::cross(edge, points[i].m_position - a), normal);
+            if(std::abs(signedArea) > best) {
+                best = std::abs(signedArea);
+                area = signedArea;
+                chosen[2] = i;
+            }
+        }
+        uint32_t chosenCount = 3;
+        best = 0.0f;
+        for(uint32_t i = 0; i < count; i++) {
+            const float signedArea = glm::dot(glm::cross(edge, points[i].m_position - a), normal) * (area < 0.0f ? 1.0f : -1.0f);
+            if(signedArea > best) {
+                best = signedArea;
+                chosen[3] = i;
+                chosenCount = 4;
+            }
+        }
+
+        for(uint32_t i = 0; i < chosenCount; i++) {
+            manifold.m_points[i] = points[chosen[i]];
+        }
+        manifold.m_pointCount = chosenCount;
+    }
+
+    /*!
+     * \brief Builds the contact points between two features.
+     * \param featureA The points the first collider presents along the normal.
+     * \param countA The number of points in the first feature.
+     * \param featureB The points the second collider presents against the normal.
+     * \param countB The number of points in the second feature.
+     * \param sizeA The size of the first collider.
+     * \param sizeB The size of the second collider.
+     * \param manifold The manifold to fill, with its normal and depth already set.
+     * \return Returns true if at least one contact point was made.
+     */
+    inline bool GenerateFromFeatures(glm::vec3* featureA, uint32_t countA, glm::vec3* featureB, uint32_t countB, float sizeA, float sizeB, ContactManifold& manifold) {
+        const glm::vec3 normal = manifold.m_normal;
+        const float depth = manifold.m_depth;
+        manifold.m_pointCount = 0;
+
+        //A single vertex touches the other collider at that vertex.
+        if(countA == 1 || countB == 1) {
+            manifold.m_points[0].m_position = countA == 1 ? featureA[0] + normal * (depth * 0.5f) : featureB[0] - normal * (depth * 0.5f);
+            manifold.m_points[0].m_depth = depth;
+            manifold.m_pointCount = 1;
+            return true;
+        }
+
+        SortAround(featureA, countA, normal);
+        SortAround(featureB, countB, -normal);
+        const bool faceA = IsFace(featureA, countA, normal, sizeA);
+        const bool faceB = IsFace(featureB, countB, -normal, sizeB);
+        if(!faceA) {
+            countA = ReduceToSegment(featureA, countA);
+        }
+        if(!faceB) {
+            countB = ReduceToSegment(featureB, countB);
+        }
+
+        //Two edges touch at the closest points between them.
+        if(!faceA && !faceB) {
+            glm::vec3 onA;
+            glm::vec3 onB;
+            ClosestPointsOnSegments(featureA[0], featureA[1], featureB[0], featureB[1], onA, onB);
+            manifold.m_points[0].m_position = (onA + onB) * 0.5f;
+            manifold.m_points[0].m_depth = depth;
+            manifold.m_pointCount = 1;
+            return true;
+        }
+
+        //The reference face is the face most closely facing along the normal, the other feature is clipped to it.
+        bool referenceIsA = faceA;
+        if(faceA && faceB) {
+            const glm::vec3 areaA = glm::normalize(GetAreaNormal(featureA, countA));
+            const glm::vec3 areaB = glm::normalize(GetAreaNormal(featureB, countB));
+            referenceIsA = glm::dot(areaA, normal) >= -glm::dot(areaB, normal);
+        }
+        const glm::vec3* reference = referenceIsA ? featureA : featureB;
+        const uint32_t referenceCount = referenceIsA ? countA : countB;
+        const glm::vec3* incident = referenceIsA ? featureB : featureA;
+        const uint32_t incidentCount = referenceIsA ? countB : countA;
+        const glm::vec3 referenceNormal = referenceIsA ? normal : -normal;
+
+        glm::vec3 clipped[MAX_CLIP_POINTS];
+        glm::vec3 scratch[MAX_CLIP_POINTS];
+        uint32_t clippedCount = incidentCount;
+        for(uint32_t i = 0; i < incidentCount; i++) {
+            clipped[i] = incident[i];
+        }
+
+        //The side planes face into the reference face, which is sorted anticlockwise around its normal.
+        for(uint32_t i = 0; i < referenceCount && clippedCount > 0; i++) {
+            const glm::vec3& start = reference[i];
+            const glm::vec3& end = reference[(i + 1) % referenceCount];
+            const glm::vec3 length = end - start;
+            if(glm::dot(length, length) <= FLT_EPSILON) {
+                continue;
+            }
+            const glm::vec3 planeNormal = glm::normalize(glm::cross(referenceNormal, length));
+            const float planeDistance = glm::dot(planeNormal, start);
+            if(clippedCount == 2 && incidentCount == 2) {
+                if(!ClipSegment(clipped[0], clipped[1], planeNormal, planeDistance)) {
+                    clippedCount = 0;
+                }
+            }
+            else {
+                clippedCount = ClipPolygon(clipped, clippedCount, planeNormal, planeDistance, scratch);
+                std::copy(scratch, scratch + clippedCount, clipped);
+            }
+        }
+
+        //Keep the clipped points behind the reference face, placed midway between the two surfaces.
+        ContactPoint points[MAX_CLIP_POINTS];
+        uint32_t pointCount = 0;
+        const float referenceDistance = glm::dot(referenceNormal, reference[0]);
+        const float slop = FEATURE_TOLERANCE * (std::min)(sizeA, sizeB);
+        for(uint32_t i = 0; i < clippedCount; i++) {
+            const float separation = glm::dot(referenceNormal, clipped[i]) - referenceDistance;
+            if(separation <= slop) {
+                points[pointCount].m_position = clipped[i] - referenceNormal * (separation * 0.5f);
+                points[pointCount].m_depth = -separation;
+                pointCount++;
+            }
+        }
+
+        //Clipping can lose every point when the features barely overlap, fall back to the deepest vertex.
+        if(pointCount == 0) {
+            uint32_t deepest = 0;
+            for(uint32_t i = 1; i < countA; i++) {
+                if(glm::dot(featureA[i], normal) > glm::dot(featureA[deepest], normal)) {
+                    deepest = i;
+                }
+            }
+            manifold.m_points[0].m_position = featureA[deepest] + normal * (depth * 0.5f);
+            manifold.m_points[0].m_depth = depth;
+            manifold.m_pointCount = 1;
+            return true;
+        }
+
+        ReducePoints(points, pointCount, normal, manifold);
+        return true;
+    }
+
+    /*!
+     * \brief Builds the contact points between two touching colliders.
+     * \param box0 The first collider.
+     * \param box1 The second collider.
+     * \param normal The unit contact normal, pointing from the first collider to the second.
+     * \param depth How far the colliders overlap along the normal.
+     * \param manifold Receives the pair, normal, depth and points.
+     * \return Returns true if at least one contact point was made.
+     */
+    inline bool Generate(AABB& box0, AABB& box1, const glm::vec3& normal, float depth, ContactManifold& manifold) {
+        manifold.m_first = &box0;
+        manifold.m_second = &box1;
+        manifold.m_normal = normal;
+        manifold.m_depth = depth;
+
+        const float sizeA = glm::length(box0.GetExtents());
+        const float sizeB = glm::length(box1.GetExtents());
+
+        glm::vec3 featureA[MAX_FEATURE_POINTS];
+        glm::vec3 featureB[MAX_FEATURE_POINTS];
+        const uint32_t countA = box0.GetMesh()->GetSupportFeature(*box0.GetTransform(), normal, FEATURE_TOLERANCE * sizeA, featureA, MAX_FEATURE_POINTS);
+        const uint32_t countB = box1.GetMesh()->GetSupportFeature(*box1.GetTransform(), -normal, FEATURE_TOLERANCE * sizeB, featureB, MAX_FEATURE_POINTS);
+        if(countA == 0 || countB == 0) {
+            return false;
+        }
+        return GenerateFromFeatures(featureA, countA, featureB, countB, sizeA, sizeB, manifold);
+    }
+}
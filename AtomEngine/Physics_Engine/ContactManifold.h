@@ -0,0 +1,92 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <GLM/glm.hpp>
+#include "AABB.h"
+
+/*!
+ * \struct ContactPoint "ContactManifold.h"
+ * \brief One point where two colliders touch.
+ */
+struct ContactPoint
+{
+    glm::vec3 m_position{ 0.0f };   /*!< Midway between the two surfaces, in world space.*/
+    float m_depth = 0.0f;           /*!< How far the surfaces overlap along the manifold normal at this point.*/
+    uint32_t m_id = 0;              /*!< Identifies the point from frame to frame within its pair, set by the contact solver.*/
+};
+
+/*!
+ * \struct ContactManifold "ContactManifold.h"
+ * \brief The contact between a pair of colliders, a normal and up to four points.
+ *
+ * The points are held inline so a buffer of manifolds is one contiguous block a solver can walk.
+ */
+struct ContactManifold
+{
+    static constexpr uint32_t MAX_POINTS = 4;   /*!< The most points kept for one pair.*/
+
+    AABB* m_first = nullptr;                /*!< The first collider of the pair.*/
+    AABB* m_second = nullptr;               /*!< The second collider of the pair.*/
+    glm::vec3 m_normal{ 0.0f };             /*!< Unit normal pointing from the first collider to the second.*/
+    float m_depth = 0.0f;                   /*!< The penetration depth along the normal.*/
+    uint32_t m_pointCount = 0;              /*!< How many of the points are in use.*/
+    ContactPoint m_points[MAX_POINTS];      /*!< The contact points.*/
+};
+
+/*!
+ * \struct ContactCache "ContactManifold.h"
+ * \brief The impulses the solver applied at a pair's contact points, kept in its pair entry for the next frame.
+ *
+ * Positions are held in the frame of the first collider's transform, so a point that stays put on the collider
+ * is found again however the pair moves, and keeps its ID and impulses.
+ */
+struct ContactCache
+{
+    uint32_t m_pointCount = 0;                                  /*!< How many of the points are in use.*/
+    uint32_t m_nextID = 1;                                      /*!< The ID given to the next new point.*/
+    glm::vec3 m_normal{ 0.0f };                                 /*!< The manifold normal the impulses were applied along.*/
+    uint32_t m_ids[ContactManifold::MAX_POINTS];                /*!< The ID of each point.*/
+    glm::vec3 m_localPositions[ContactManifold::MAX_POINTS];    /*!< Each point in the first collider's frame.*/
+    float m_normalImpulses[ContactManifold::MAX_POINTS];        /*!< The impulse each point pushed the pair apart with.*/
+    glm::vec3 m_frictionImpulses[ContactManifold::MAX_POINTS];  /*!< The friction impulse at each point, in world space.*/
+};
+
+/*!
+ * \class ContactBuffer "ContactManifold.h"
+ * \brief Every manifold found by the narrow phase in one frame.
+ *
+ * Cleared at the start of each frame, the storage is kept so nothing is allocated once it is large enough.
+ */
+class ContactBuffer
+{
+public:
+    void Clear() {
+        m_manifolds.clear();
+    }
+
+    void Add(const ContactManifold& manifold) {
+        m_manifolds.push_back(manifold);
+    }
+
+    /*!
+     * \brief Adds every manifold from another buffer to the end of this one, keeping their order.
+     */
+    void Append(const ContactBuffer& other) {
+        m_manifolds.insert(m_manifolds.end(), other.m_manifolds.begin(), other.m_manifolds.end());
+    }
+
+    std::vector<ContactManifold>& GetManifolds() {
+        return m_manifolds;
+    }
+
+    const std::vector<ContactManifold>& GetManifolds() const {
+        return m_manifolds;
+    }
+
+    size_t GetManifoldCount() const {
+        return m_manifolds.size();
+    }
+
+private:
+    std::vector<ContactManifold> m_manifolds;   /*!< The manifolds, one per touching pair.*/
+};
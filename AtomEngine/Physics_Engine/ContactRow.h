@@ -0,0 +1,243 @@
+#pragma once
+#include <cstdint>
+#include <immintrin.h>
+#include <GLM/glm.hpp>
+#include "ContactManifold.h"
+
+/*!
+ * \struct ContactRow "ContactRow.h"
+ * \brief Four contact manifolds laid out lane by lane, so the contact solver can solve them together with SSE.
+ *
+ * Every value is held as an array with one entry per lane, and vectors as one such array per axis. The manifolds
+ * in a row must not share a moving body, as each lane's velocities are read at the start of a solve and written
+ * back at the end. Lanes without a manifold, and points past the end of a lane's manifold, are left zeroed: with
+ * no mass their impulses stay at zero and they never move anything.
+ * Each direction an impulse is applied along keeps how it turns both bodies, worked out when the row is built,
+ * so solving only reads the velocities of the bodies and never their inertia.
+ */
+struct alignas(16) ContactRow
+{
+    static constexpr uint32_t WIDTH = 4;    /*!< The number of manifolds in a row.*/
+
+    /*!
+     * \brief One direction an impulse is applied along at a contact point.
+     */
+    struct Axis
+    {
+        float m_armA[3][WIDTH];         /*!< The offset from the first body's centre to the point, crossed with the direction.*/
+        float m_armB[3][WIDTH];         /*!< The offset from the second body's centre to the point, crossed with the direction.*/
+        float m_responseA[3][WIDTH];    /*!< The first body's change in angular velocity per unit of impulse.*/
+        float m_responseB[3][WIDTH];    /*!< The second body's change in angular velocity per unit of impulse.*/
+        float m_mass[WIDTH];            /*!< The mass the bodies resist an impulse along the direction with.*/
+        float m_impulse[WIDTH];         /*!< The total impulse applied along the direction.*/
+    };
+
+    /*!
+     * \brief One contact point of each manifold in the row.
+     */
+    struct Point
+    {
+        Axis m_normal;
+        Axis m_tangent0;
+        Axis m_tangent1;
+        float m_bias[WIDTH];            /*!< The normal velocity the point is solved towards.*/
+    };
+
+    uint32_t m_bodiesA[WIDTH];
+    uint32_t m_bodiesB[WIDTH];
+    float m_inverseMassesA[WIDTH];      /*!< Zero for lanes whose first body does not move, which are never written back.*/
+    float m_inverseMassesB[WIDTH];      /*!< Zero for lanes whose second body does not move, which are never written back.*/
+    float m_normals[3][WIDTH];
+    float m_tangents0[3][WIDTH];
+    float m_tangents1[3][WIDTH];
+    float m_frictions[WIDTH];
+    Point m_points[ContactManifold::MAX_POINTS];
+    uint32_t m_pointCount;              /*!< The most points in any lane's manifold.*/
+
+    /*!
+     * \brief Sets one lane of a vector.
+     */
+    static inline void SetLane(float (&lanes)[3][WIDTH], uint32_t lane, const glm::vec3& value)
+    {
+        lanes[0][lane] = value.x;
+        lanes[1][lane] = value.y;
+        lanes[2][lane] = value.z;
+    }
+
+    /*!
+     * \brief Gets one lane of a vector.
+     */
+    static inline glm::vec3 GetLane(const float (&lanes)[3][WIDTH], uint32_t lane)
+    {
+        return glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+    }
+
+    /*!
+     * \brief Applies the impulses already held by every point again.
+     * \param linearVelocities The linear velocity of every body.
+     * \param angularVelocities The angular velocity of every body.
+     */
+    void WarmStart(glm::vec3* linearVelocities, glm::vec3* angularVelocities) const
+    {
+        Bodies bodies = GatherBodies(linearVelocities, angularVelocities);
+        const Vector normal = Load(m_normals);
+        const Vector tangent0 = Load(m_tangents0);
+        const Vector tangent1 = Load(m_tangents1);
+
+        for(uint32_t i = 0; i < m_pointCount; i++) {
+            const Point& point = m_points[i];
+            ApplyImpulse(bodies, point.m_normal, normal, _mm_load_ps(point.m_normal.m_impulse));
+            ApplyImpulse(bodies, point.m_tangent0, tangent0, _mm_load_ps(point.m_tangent0.m_impulse));
+            ApplyImpulse(bodies, point.m_tangent1, tangent1, _mm_load_ps(point.m_tangent1.m_impulse));
+        }
+        ScatterBodies(bodies, linearVelocities, angularVelocities);
+    }
+
+    /*!
+     * \brief Makes one pass over every point of the row, friction first so the normal impulse has the final say.
+     * \param linearVelocities The linear velocity of every body.
+     * \param angularVelocities The angular velocity of every body.
+     */
+    void Solve(glm::vec3* linearVelocities, glm::vec3* angularVelocities)
+    {
+        Bodies bodies = GatherBodies(linearVelocities, angularVelocities);
+        const Vector normal = Load(m_normals);
+        const Vector tangent0 = Load(m_tangents0);
+        const Vector tangent1 = Load(m_tangents1);
+        const __m128 friction = _mm_load_ps(m_frictions);
+        const __m128 zero = _mm_setzero_ps();
+
+        for(uint32_t i = 0; i < m_pointCount; i++) {
+            Point& point = m_points[i];
+
+            //Friction can hold the points together up to the friction coefficient times the push between them.
+            const __m128 maxFriction = _mm_mul_ps(friction, _mm_load_ps(point.m_normal.m_impulse));
+            const __m128 minFriction = _mm_sub_ps(zero, maxFriction);
+            const __m128 speed0 = GetSpeed(bodies, point.m_tangent0, tangent0);
+            const __m128 speed1 = GetSpeed(bodies, point.m_tangent1, tangent1);
+            const __m128 oldTangent0 = _mm_load_ps(point.m_tangent0.m_impulse);
+            const __m128 oldTangent1 = _mm_load_ps(point.m_tangent1.m_impulse);
+            const __m128 newTangent0 = _mm_min_ps(_mm_max_ps(_mm_sub_ps(oldTangent0, _mm_mul_ps(_mm_load_ps(point.m_tangent0.m_mass), speed0)), minFriction), maxFriction);
+            const __m128 newTangent1 = _mm_min_ps(_mm_max_ps(_mm_sub_ps(oldTangent1, _mm_mul_ps(_mm_load_ps(point.m_tangent1.m_mass), speed1)), minFriction), maxFriction);
+            _mm_store_ps(point.m_tangent0.m_impulse, newTangent0);
+            _mm_store_ps(point.m_tangent1.m_impulse, newTangent1);
+            ApplyImpulse(bodies, point.m_tangent0, tangent0, _mm_sub_ps(newTangent0, oldTangent0));
+            ApplyImpulse(bodies, point.m_tangent1, tangent1, _mm_sub_ps(newTangent1, oldTangent1));
+
+            //The total push can only grow or shrink to zero, contacts never pull.
+            const __m128 speed = _mm_sub_ps(GetSpeed(bodies, point.m_normal, normal), _mm_load_ps(point.m_bias));
+            const __m128 oldNormal = _mm_load_ps(point.m_normal.m_impulse);
+            const __m128 newNormal = _mm_max_ps(_mm_sub_ps(oldNormal, _mm_mul_ps(_mm_load_ps(point.m_normal.m_mass), speed)), zero);
+            _mm_store_ps(point.m_normal.m_impulse, newNormal);
+            ApplyImpulse(bodies, point.m_normal, normal, _mm_sub_ps(newNormal, oldNormal));
+        }
+        ScatterBodies(bodies, linearVelocities, angularVelocities);
+    }
+
+private:
+    /*!
+     * \brief A vector in each lane.
+     */
+    struct Vector
+    {
+        __m128 x;
+        __m128 y;
+        __m128 z;
+    };
+
+    /*!
+     * \brief The velocities of both bodies of each lane, held while the row is solved.
+     */
+    struct Bodies
+    {
+        Vector m_linearA;
+        Vector m_angularA;
+        Vector m_linearB;
+        Vector m_angularB;
+        __m128 m_inverseMassA;
+        __m128 m_inverseMassB;
+    };
+
+    static inline Vector Load(const float (&lanes)[3][WIDTH])
+    {
+        return { _mm_load_ps(lanes[0]), _mm_load_ps(lanes[1]), _mm_load_ps(lanes[2]) };
+    }
+
+    static inline __m128 Dot(const Vector& a, const Vector& b)
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+    }
+
+    /*!
+     * \brief Adds a vector scaled per lane to another.
+     */
+    static inline void AddScaled(Vector& target, const Vector& vector, __m128 scale)
+    {
+        target.x = _mm_add_ps(target.x, _mm_mul_ps(vector.x, scale));
+        target.y = _mm_add_ps(target.y, _mm_mul_ps(vector.y, scale));
+        target.z = _mm_add_ps(target.z, _mm_mul_ps(vector.z, scale));
+    }
+
+    static inline Vector Gather(const glm::vec3* vectors, const uint32_t (&bodies)[WIDTH])
+    {
+        const glm::vec3& a = vectors[bodies[0]];
+        const glm::vec3& b = vectors[bodies[1]];
+        const glm::vec3& c = vectors[bodies[2]];
+        const glm::vec3& d = vectors[bodies[3]];
+        return { _mm_setr_ps(a.x, b.x, c.x, d.x), _mm_setr_ps(a.y, b.y, c.y, d.y), _mm_setr_ps(a.z, b.z, c.z, d.z) };
+    }
+
+    /*!
+     * \brief Writes each lane of a vector back to its body, skipping bodies that do not move.
+     */
+    static inline void Scatter(const Vector& vector, glm::vec3* vectors, const uint32_t (&bodies)[WIDTH], const float (&inverseMasses)[WIDTH])
+    {
+        alignas(16) float lanes[3][WIDTH];
+        _mm_store_ps(lanes[0], vector.x);
+        _mm_store_ps(lanes[1], vector.y);
+        _mm_store_ps(lanes[2], vector.z);
+        for(uint32_t lane = 0; lane < WIDTH; lane++) {
+            if(inverseMasses[lane] > 0.0f) {
+                vectors[bodies[lane]] = GetLane(lanes, lane);
+            }
+        }
+    }
+
+    inline Bodies GatherBodies(const glm::vec3* linearVelocities, const glm::vec3* angularVelocities) const
+    {
+        return { Gather(linearVelocities, m_bodiesA), Gather(angularVelocities, m_bodiesA),
+                 Gather(linearVelocities, m_bodiesB), Gather(angularVelocities, m_bodiesB),
+                 _mm_load_ps(m_inverseMassesA), _mm_load_ps(m_inverseMassesB) };
+    }
+
+    inline void ScatterBodies(const Bodies& bodies, glm::vec3* linearVelocities, glm::vec3* angularVelocities) const
+    {
+        Scatter(bodies.m_linearA, linearVelocities, m_bodiesA, m_inverseMassesA);
+        Scatter(bodies.m_angularA, angularVelocities, m_bodiesA, m_inverseMassesA);
+        Scatter(bodies.m_linearB, linearVelocities, m_bodiesB, m_inverseMassesB);
+        Scatter(bodies.m_angularB, angularVelocities, m_bodiesB, m_inverseMassesB);
+    }
+
+    /*!
+     * \brief Gets how fast the second body moves away from the first along an axis at the point.
+     */
+    static inline __m128 GetSpeed(const Bodies& bodies, const Axis& axis, const Vector& direction)
+    {
+        const Vector relative = { _mm_sub_ps(bodies.m_linearB.x, bodies.m_linearA.x),
+                                  _mm_sub_ps(bodies.m_linearB.y, bodies.m_linearA.y),
+                                  _mm_sub_ps(bodies.m_linearB.z, bodies.m_linearA.z) };
+        return _mm_sub_ps(_mm_add_ps(Dot(relative, direction), Dot(bodies.m_angularB, Load(axis.m_armB))), Dot(bodies.m_angularA, Load(axis.m_armA)));
+    }
+
+    /*!
+     * \brief Applies an impulse along an axis to the second body, and its opposite to the first.
+     */
+    static inline void ApplyImpulse(Bodies& bodies, const Axis& axis, const Vector& direction, __m128 impulse)
+    {
+        const __m128 negated = _mm_sub_ps(_mm_setzero_ps(), impulse);
+        AddScaled(bodies.m_linearA, direction, _mm_mul_ps(negated, bodies.m_inverseMassA));
+        AddScaled(bodies.m_angularA, Load(axis.m_responseA), negated);
+        AddScaled(bodies.m_linearB, direction, _mm_mul_ps(impulse, bodies.m_inverseMassB));
+        AddScaled(bodies.m_angularB, Load(axis.m_responseB), impulse);
+    }
+};
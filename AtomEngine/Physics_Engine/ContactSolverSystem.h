@@ -0,0 +1,480 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <initializer_list>
+#include "ECS_System.h"
+#include "TransformComponent.h"
+#include "RigidBodyComponent.h"
+#include "AABBComponent.h"
+#include "CollisionDetectionSystem.h"
+#include "ContactGeneration.h"
+#include "ContactRow.h"
+#include "ThreadPool.h"
+#include "ProfilerManager.h"
+
+/*!
+ * \class ContactSolverSystem "ContactSolverSystem.h"
+ * \brief Pushes touching rigid bodies apart with impulses.
+ *
+ * Must run after the CollisionDetectionSystem, and so before the PhysicsMovementSystem integrates the next step.
+ * Every contact point found by the narrow phase becomes a constraint, solved with sequential impulses: each
+ * iteration applies the impulse that stops the bodies moving into each other at the point, clamped so contacts
+ * only push, and a friction impulse limited by the push. Restitution and a small push out of any overlap are
+ * added as a target velocity along the normal.
+ * Each point's total impulse is kept in its pair entry, and points found again next frame start from it, which
+ * lets stacks settle in far fewer iterations.
+ * Colliders without a rigid body, and static ones, share body zero, which has no mass and never moves.
+ *
+ * The manifolds are coloured so no two of one colour share a moving body. A colour is packed four manifolds to a
+ * ContactRow and solved with SSE, its rows split into jobs on the job system, and the colours are solved one
+ * after another. Colouring is done in contact order and nothing in a colour touches the same body twice, so the
+ * result is the same whatever the number of threads. Manifolds left over once every colour is taken are solved
+ * one at a time after the rest.
+ */
+class ContactSolverSystem : public BaseECSSystem
+{
+public:
+    /*!
+     * \brief Constructor
+     * \param collisionDetection The system whose contacts are solved.
+     */
+    ContactSolverSystem(CollisionDetectionSystem& collisionDetection) : BaseECSSystem(),
+        m_collisionDetection(collisionDetection)
+    {
+        AddComponentType(TransformComponent::ID);
+        AddComponentType(RigidBodyComponent::ID);
+        AddComponentType(AABBComponent::ID);
+    }
+
+    virtual void UpdateComponents(float deltaTime, std::vector<std::vector<BaseECSComponent*>>& componentArrays) override
+    {
+        if(deltaTime <= 0.0f) {
+            return;
+        }
+
+        Profiler::Instance()->Start("Solve Contacts");
+        GatherBodies(componentArrays);
+        ColourManifolds();
+        BuildRows(deltaTime);
+        SolveBatches([this](ContactRow& row) {
+            row.WarmStart(m_linearVelocities.data(), m_angularVelocities.data());
+        });
+        for(uint32_t i = 0; i < m_iterations; i++) {
+            SolveBatches([this](ContactRow& row) {
+                row.Solve(m_linearVelocities.data(), m_angularVelocities.data());
+            });
+        }
+        StoreImpulses();
+        ScatterBodies(componentArrays);
+        Profiler::Instance()->End("Solve Contacts");
+    }
+
+    /*!
+     * \brief Sets how many times each frame every contact is solved.
+     */
+    void SetIterations(uint32_t iterations) {
+        m_iterations = iterations;
+    }
+
+    uint32_t GetIterations() const {
+        return m_iterations;
+    }
+
+    /*!
+     * \brief Gets the number of colours the manifolds were split into this frame, not counting the leftovers.
+     */
+    uint32_t GetColourCount() const {
+        return static_cast<uint32_t>(m_batches.size()) - (m_batches.empty() || m_batches.back().m_parallel ? 0 : 1);
+    }
+
+private:
+    /*!
+     * \brief A run of rows solved together, either one colour or the leftovers.
+     */
+    struct ColourBatch
+    {
+        uint32_t m_firstRow;
+        uint32_t m_rowCount;
+        bool m_parallel;        /*!< False for the leftovers, which may share bodies and are solved in order.*/
+    };
+
+    static constexpr uint32_t DEFAULT_ITERATIONS = 10;      /*!< Velocity iterations made each frame unless set.*/
+    static constexpr uint32_t WORLD_BODY = 0;               /*!< The massless body shared by everything that does not move.*/
+    static constexpr uint32_t MAX_COLOURS = 64;             /*!< One per bit of a body's colour mask.*/
+    static constexpr uint32_t NO_MANIFOLD = UINT32_MAX;     /*!< Marks an empty lane.*/
+    static constexpr uint32_t ROWS_PER_JOB = 16;            /*!< The fewest rows worth giving a job of their own.*/
+    static constexpr float BAUMGARTE = 0.2f;                /*!< The fraction of an overlap pushed out each step.*/
+    static constexpr float LINEAR_SLOP = 5e-3f;             /*!< The overlap allowed to remain, so resting contacts are not lost, in world units.*/
+    static constexpr float RESTITUTION_THRESHOLD = 1.0f;    /*!< The closing speed below which nothing bounces, so resting contacts do not jitter.*/
+    static constexpr float MATCH_TOLERANCE = 0.05f;         /*!< How far a point may move on its collider and still be the same point, in world units.*/
+    static constexpr float NORMAL_TOLERANCE = 0.95f;        /*!< How close the normal must stay to last frame's to keep the impulses, as a cosine.*/
+    static constexpr float DEFAULT_FRICTION = 0.5f;         /*!< The friction of colliders without a rigid body.*/
+    static constexpr float DEFAULT_RESTITUTION = 0.0f;      /*!< The restitution of colliders without a rigid body.*/
+
+    CollisionDetectionSystem& m_collisionDetection;
+    uint32_t m_iterations = DEFAULT_ITERATIONS;
+
+    //Bodies, one entry each, body zero is the world.
+    std::vector<std::pair<const AABB*, uint32_t>> m_bodyLookup;   /*!< Each moving AABB with its body, sorted by address.*/
+    std::vector<glm::vec3> m_linearVelocities;
+    std::vector<glm::vec3> m_angularVelocities;
+    std::vector<float> m_inverseMasses;
+    std::vector<glm::mat3> m_inverseInertias;                   /*!< Inverse inertia tensors in world space.*/
+    std::vector<float> m_frictions;
+    std::vector<float> m_restitutions;
+    std::vector<uint8_t> m_inContact;                           /*!< Whether each body has a contact, only those are written back.*/
+    std::vector<uint64_t> m_colourMasks;                        /*!< The colours each moving body already has a manifold in.*/
+
+    //Manifolds being solved, one entry each.
+    std::vector<ContactManifold*> m_manifolds;
+    std::vector<PairEntry*> m_manifoldPairs;                    /*!< The pair of each manifold, to keep its impulses in.*/
+    std::vector<uint32_t> m_manifoldBodiesA;
+    std::vector<uint32_t> m_manifoldBodiesB;
+    std::vector<uint32_t> m_manifoldColours;                    /*!< MAX_COLOURS for the leftovers.*/
+
+    std::vector<ContactRow> m_rows;
+    std::vector<uint32_t> m_rowManifolds;                       /*!< The manifold in each lane of each row.*/
+    std::vector<ColourBatch> m_batches;
+
+    /*!
+     * \brief Copies the velocity, mass and material of every rigid body into the body arrays.
+     */
+    void GatherBodies(std::vector<std::vector<BaseECSComponent*>>& componentArrays)
+    {
+        const uint32_t count = static_cast<uint32_t>(componentArrays[0].size());
+        m_bodyLookup.clear();
+        m_linearVelocities.assign(1, glm::vec3(0.0f));
+        m_angularVelocities.assign(1, glm::vec3(0.0f));
+        m_inverseMasses.assign(1, 0.0f);
+        m_inverseInertias.assign(1, glm::mat3(0.0f));
+        m_frictions.assign(1, DEFAULT_FRICTION);
+        m_restitutions.assign(1, DEFAULT_RESTITUTION);
+        m_inContact.assign(count + 1, 0);
+        m_colourMasks.assign(count + 1, 0);
+
+        for(uint32_t i = 0; i < count; i++) {
+            POD_Transform& transform = ((TransformComponent*)componentArrays[0][i])->m_transform;
+            const POD_RigidBody& body = ((RigidBodyComponent*)componentArrays[1][i])->m_rigidBody;
+            const AABB& aabb = ((AABBComponent*)componentArrays[2][i])->m_aabb;
+
+            const uint32_t index = static_cast<uint32_t>(m_inverseMasses.size());
+            m_bodyLookup.emplace_back(&aabb, index);
+            m_frictions.push_back(body.m_friction);
+            m_restitutions.push_back(body.m_restitution);
+            if(aabb.IsStatic()) {
+                m_linearVelocities.push_back(glm::vec3(0.0f));
+                m_angularVelocities.push_back(glm::vec3(0.0f));
+                m_inverseMasses.push_back(0.0f);
+                m_inverseInertias.push_back(glm::mat3(0.0f));
+                continue;
+            }
+
+            const glm::mat3 rotation = GetRotation(transform);
+            const glm::mat3 inverseInertia = rotation * body.m_inverseInertiaTensorIntegral * glm::transpose(rotation);
+            m_linearVelocities.push_back(body.m_linearMomentum / body.m_mass);
+            m_angularVelocities.push_back(inverseInertia * body.m_angularMomentum);
+            m_inverseMasses.push_back(1.0f / body.m_mass);
+            m_inverseInertias.push_back(inverseInertia);
+        }
+        std::sort(m_bodyLookup.begin(), m_bodyLookup.end());
+    }
+
+    /*!
+     * \brief Finds the body of an AABB, the world body if it has none.
+     */
+    uint32_t FindBody(const AABB* aabb) const
+    {
+        const auto found = std::lower_bound(m_bodyLookup.begin(), m_bodyLookup.end(), std::make_pair(aabb, 0u));
+        return found != m_bodyLookup.end() && found->first == aabb ? found->second : WORLD_BODY;
+    }
+
+    /*!
+     * \brief Gives each manifold the first colour neither of its moving bodies has yet, and lays the colours out in rows.
+     *
+     * Bodies that do not move are never written to, so any number of manifolds of one colour can share them.
+     */
+    void ColourManifolds()
+    {
+        m_manifolds.clear();
+        m_manifoldPairs.clear();
+        m_manifoldBodiesA.clear();
+        m_manifoldBodiesB.clear();
+        m_manifoldColours.clear();
+
+        uint32_t colourSizes[MAX_COLOURS + 1] = {};
+        PairManager& pairs = m_collisionDetection.GetPairManager();
+        for(ContactManifold& manifold : m_collisionDetection.GetContacts().GetManifolds()) {
+            const uint32_t bodyA = FindBody(manifold.m_first);
+            const uint32_t bodyB = FindBody(manifold.m_second);
+            PairEntry* pair = pairs.Find(manifold.m_first, manifold.m_second);
+            if(m_inverseMasses[bodyA] + m_inverseMasses[bodyB] == 0.0f || pair == nullptr) {
+                continue;
+            }
+            m_inContact[bodyA] = 1;
+            m_inContact[bodyB] = 1;
+
+            const uint64_t taken = m_colourMasks[bodyA] | m_colourMasks[bodyB];
+            uint32_t colour = 0;
+            while(colour < MAX_COLOURS && (taken >> colour) & 1) {
+                colour++;
+            }
+            if(colour < MAX_COLOURS) {
+                for(uint32_t body : { bodyA, bodyB }) {
+                    if(m_inverseMasses[body] > 0.0f) {
+                        m_colourMasks[body] |= uint64_t(1) << colour;
+                    }
+                }
+            }
+
+            m_manifolds.push_back(&manifold);
+            m_manifoldPairs.push_back(pair);
+            m_manifoldBodiesA.push_back(bodyA);
+            m_manifoldBodiesB.push_back(bodyB);
+            m_manifoldColours.push_back(colour);
+            colourSizes[colour]++;
+        }
+
+        //Each colour fills whole rows, the leftovers get a row each as they may share bodies.
+        uint32_t nextLanes[MAX_COLOURS + 1];
+        uint32_t rowCount = 0;
+        m_batches.clear();
+        for(uint32_t colour = 0; colour <= MAX_COLOURS; colour++) {
+            if(colourSizes[colour] == 0) {
+                continue;
+            }
+            const bool parallel = colour < MAX_COLOURS;
+            const uint32_t rows = parallel ? (colourSizes[colour] + ContactRow::WIDTH - 1) / ContactRow::WIDTH : colourSizes[colour];
+            m_batches.push_back({ rowCount, rows, parallel });
+            nextLanes[colour] = rowCount * ContactRow::WIDTH;
+            rowCount += rows;
+        }
+
+        m_rows.assign(rowCount, ContactRow());
+        m_rowManifolds.assign(rowCount * ContactRow::WIDTH, NO_MANIFOLD);
+        const uint32_t count = static_cast<uint32_t>(m_manifolds.size());
+        for(uint32_t i = 0; i < count; i++) {
+            const uint32_t colour = m_manifoldColours[i];
+            m_rowManifolds[nextLanes[colour]] = i;
+            nextLanes[colour] += colour < MAX_COLOURS ? 1 : ContactRow::WIDTH;
+        }
+    }
+
+    /*!
+     * \brief Fills every row with its manifolds' constraints, matching each point to last frame's for its impulses.
+     */
+    void BuildRows(float deltaTime)
+    {
+        const uint32_t count = static_cast<uint32_t>(m_rows.size());
+        ParallelFor(count, GetParallelJobCount(count, ROWS_PER_JOB), [this, deltaTime](uint32_t, uint32_t begin, uint32_t end) {
+            for(uint32_t row = begin; row < end; row++) {
+                for(uint32_t lane = 0; lane < ContactRow::WIDTH; lane++) {
+                    const uint32_t manifold = m_rowManifolds[row * ContactRow::WIDTH + lane];
+                    if(manifold != NO_MANIFOLD) {
+                        BuildLane(m_rows[row], lane, manifold, deltaTime);
+                    }
+                }
+            }
+        });
+    }
+
+    /*!
+     * \brief Fills one lane of a row with a manifold's constraints.
+     */
+    void BuildLane(ContactRow& row, uint32_t lane, uint32_t index, float deltaTime)
+    {
+        ContactManifold& manifold = *m_manifolds[index];
+        ContactCache& cache = m_manifoldPairs[index]->m_contactCache;
+        const uint32_t bodyA = m_manifoldBodiesA[index];
+        const uint32_t bodyB = m_manifoldBodiesB[index];
+        MatchPoints(manifold, cache);
+
+        const glm::vec3 centreA = manifold.m_first->GetTransform()->GetPosition();
+        const glm::vec3 centreB = manifold.m_second->GetTransform()->GetPosition();
+        const glm::vec3 normal = manifold.m_normal;
+        const glm::vec3 tangent0 = ContactGeneration::Perpendicular(normal);
+        const glm::vec3 tangent1 = glm::cross(normal, tangent0);
+        const float restitution = (std::max)(m_restitutions[bodyA], m_restitutions[bodyB]);
+
+        row.m_bodiesA[lane] = bodyA;
+        row.m_bodiesB[lane] = bodyB;
+        row.m_inverseMassesA[lane] = m_inverseMasses[bodyA];
+        row.m_inverseMassesB[lane] = m_inverseMasses[bodyB];
+        ContactRow::SetLane(row.m_normals, lane, normal);
+        ContactRow::SetLane(row.m_tangents0, lane, tangent0);
+        ContactRow::SetLane(row.m_tangents1, lane, tangent1);
+        row.m_frictions[lane] = std::sqrt(m_frictions[bodyA] * m_frictions[bodyB]);
+        row.m_pointCount = (std::max)(row.m_pointCount, manifold.m_pointCount);
+
+        for(uint32_t i = 0; i < manifold.m_pointCount; i++) {
+            const ContactPoint& point = manifold.m_points[i];
+            const glm::vec3 offsetA = point.m_position - centreA;
+            const glm::vec3 offsetB = point.m_position - centreB;
+            ContactRow::Point& rowPoint = row.m_points[i];
+
+            //MatchPoints left each matched point's impulses at the same index of the cache, new points have none.
+            SetAxis(rowPoint.m_normal, lane, bodyA, bodyB, offsetA, offsetB, normal, cache.m_normalImpulses[i]);
+            SetAxis(rowPoint.m_tangent0, lane, bodyA, bodyB, offsetA, offsetB, tangent0, glm::dot(cache.m_frictionImpulses[i], tangent0));
+            SetAxis(rowPoint.m_tangent1, lane, bodyA, bodyB, offsetA, offsetB, tangent1, glm::dot(cache.m_frictionImpulses[i], tangent1));
+
+            //Bounce back off fast impacts, and push out of the overlap beyond the slop. Points of the manifold
+            //that are still apart may close the gap this step, but no more.
+            const float closingSpeed = glm::dot(GetRelativeVelocity(bodyA, bodyB, offsetA, offsetB), normal);
+            const float bounce = closingSpeed < -RESTITUTION_THRESHOLD ? -restitution * closingSpeed : 0.0f;
+            const float pushOut = point.m_depth < 0.0f ? point.m_depth / deltaTime : BAUMGARTE / deltaTime * (std::max)(point.m_depth - LINEAR_SLOP, 0.0f);
+            rowPoint.m_bias[lane] = bounce > 0.0f ? bounce : pushOut;
+        }
+    }
+
+    /*!
+     * \brief Fills one lane of a point's axis with how an impulse along it moves the two bodies.
+     */
+    void SetAxis(ContactRow::Axis& axis, uint32_t lane, uint32_t bodyA, uint32_t bodyB, const glm::vec3& offsetA, const glm::vec3& offsetB, const glm::vec3& direction, float impulse) const
+    {
+        const glm::vec3 armA = glm::cross(offsetA, direction);
+        const glm::vec3 armB = glm::cross(offsetB, direction);
+        const glm::vec3 responseA = m_inverseInertias[bodyA] * armA;
+        const glm::vec3 responseB = m_inverseInertias[bodyB] * armB;
+        const float inverseMass = m_inverseMasses[bodyA] + m_inverseMasses[bodyB] + glm::dot(armA, responseA) + glm::dot(armB, responseB);
+
+        ContactRow::SetLane(axis.m_armA, lane, armA);
+        ContactRow::SetLane(axis.m_armB, lane, armB);
+        ContactRow::SetLane(axis.m_responseA, lane, responseA);
+        ContactRow::SetLane(axis.m_responseB, lane, responseB);
+        axis.m_mass[lane] = inverseMass > 0.0f ? 1.0f / inverseMass : 0.0f;
+        axis.m_impulse[lane] = impulse;
+    }
+
+    /*!
+     * \brief Gives each point of a manifold the ID of the nearest point from last frame, or a new one.
+     *
+     * The cache is reordered so each matched point's impulses sit at the index of the point they belong to.
+     */
+    void MatchPoints(ContactManifold& manifold, ContactCache& cache) const
+    {
+        ContactCache matched;
+        matched.m_nextID = cache.m_nextID;
+        matched.m_normal = cache.m_normal;
+        const bool sameNormal = glm::dot(cache.m_normal, manifold.m_normal) >= NORMAL_TOLERANCE;
+
+        POD_Transform& transform = *manifold.m_first->GetTransform();
+        const glm::mat3 toLocal = glm::transpose(GetRotation(transform));
+        const glm::vec3 position = transform.GetPosition();
+        bool used[ContactManifold::MAX_POINTS] = {};
+
+        for(uint32_t i = 0; i < manifold.m_pointCount; i++) {
+            const glm::vec3 local = toLocal * (manifold.m_points[i].m_position - position);
+            uint32_t nearest = ContactManifold::MAX_POINTS;
+            float nearestDistance = MATCH_TOLERANCE * MATCH_TOLERANCE;
+            for(uint32_t j = 0; j < cache.m_pointCount && sameNormal; j++) {
+                const glm::vec3 offset = cache.m_localPositions[j] - local;
+                const float distance = glm::dot(offset, offset);
+                if(!used[j] && distance < nearestDistance) {
+                    nearest = j;
+                    nearestDistance = distance;
+                }
+            }
+
+            matched.m_localPositions[i] = local;
+            if(nearest != ContactManifold::MAX_POINTS) {
+                used[nearest] = true;
+                matched.m_ids[i] = cache.m_ids[nearest];
+                matched.m_normalImpulses[i] = cache.m_normalImpulses[nearest];
+                matched.m_frictionImpulses[i] = cache.m_frictionImpulses[nearest];
+            }
+            else {
+                matched.m_ids[i] = matched.m_nextID++;
+                matched.m_normalImpulses[i] = 0.0f;
+                matched.m_frictionImpulses[i] = glm::vec3(0.0f);
+            }
+            manifold.m_points[i].m_id = matched.m_ids[i];
+        }
+        matched.m_pointCount = manifold.m_pointCount;
+        cache = matched;
+    }
+
+    /*!
+     * \brief Runs a pass over every row, one colour at a time.
+     * \param pass Called once per row.
+     */
+    template<class T>
+    void SolveBatches(const T& pass)
+    {
+        for(const ColourBatch& batch : m_batches) {
+            const uint32_t numJobs = batch.m_parallel ? GetParallelJobCount(batch.m_rowCount, ROWS_PER_JOB) : 1;
+            ParallelFor(batch.m_rowCount, numJobs, [this, &batch, &pass](uint32_t, uint32_t begin, uint32_t end) {
+                for(uint32_t row = batch.m_firstRow + begin; row < batch.m_firstRow + end; row++) {
+                    pass(m_rows[row]);
+                }
+            });
+        }
+    }
+
+    /*!
+     * \brief Keeps each point's total impulses in its pair's cache for next frame.
+     */
+    void StoreImpulses()
+    {
+        const uint32_t count = static_cast<uint32_t>(m_rows.size());
+        ParallelFor(count, GetParallelJobCount(count, ROWS_PER_JOB), [this](uint32_t, uint32_t begin, uint32_t end) {
+            for(uint32_t row = begin; row < end; row++) {
+                const ContactRow& contacts = m_rows[row];
+                for(uint32_t lane = 0; lane < ContactRow::WIDTH; lane++) {
+                    const uint32_t manifold = m_rowManifolds[row * ContactRow::WIDTH + lane];
+                    if(manifold == NO_MANIFOLD) {
+                        continue;
+                    }
+
+                    ContactCache& cache = m_manifoldPairs[manifold]->m_contactCache;
+                    const glm::vec3 tangent0 = ContactRow::GetLane(contacts.m_tangents0, lane);
+                    const glm::vec3 tangent1 = ContactRow::GetLane(contacts.m_tangents1, lane);
+                    cache.m_normal = ContactRow::GetLane(contacts.m_normals, lane);
+                    for(uint32_t i = 0; i < cache.m_pointCount; i++) {
+                        const ContactRow::Point& point = contacts.m_points[i];
+                        cache.m_normalImpulses[i] = point.m_normal.m_impulse[lane];
+                        cache.m_frictionImpulses[i] = tangent0 * point.m_tangent0.m_impulse[lane] + tangent1 * point.m_tangent1.m_impulse[lane];
+                    }
+                }
+            }
+        });
+    }
+
+    /*!
+     * \brief Writes the solved velocities back to the rigid bodies in contact as momentum.
+     */
+    void ScatterBodies(std::vector<std::vector<BaseECSComponent*>>& componentArrays)
+    {
+        const uint32_t count = static_cast<uint32_t>(componentArrays[0].size());
+        for(uint32_t i = 0; i < count; i++) {
+            POD_Transform& transform = ((TransformComponent*)componentArrays[0][i])->m_transform;
+            POD_RigidBody& body = ((RigidBodyComponent*)componentArrays[1][i])->m_rigidBody;
+            const uint32_t index = i + 1;
+            if(!m_inContact[index] || m_inverseMasses[index] == 0.0f) {
+                continue;
+            }
+
+            const glm::mat3 rotation = GetRotation(transform);
+            body.m_linearMomentum = m_linearVelocities[index] * body.m_mass;
+            body.m_angularMomentum = rotation * body.m_inertiaTensorIntegral * glm::transpose(rotation) * m_angularVelocities[index];
+        }
+    }
+
+    /*!
+     * \brief Gets the rotation matrix of a transform.
+     *
+     * Integration leaves the rotation slightly off unit length until the matrix is next built, the inertia
+     * has to be turned by a true rotation or momentum would grow each time it is converted.
+     */
+    static glm::mat3 GetRotation(POD_Transform& transform)
+    {
+        return glm::mat3_cast(glm::normalize(transform.GetRotation()));
+    }
+
+    glm::vec3 GetRelativeVelocity(uint32_t bodyA, uint32_t bodyB, const glm::vec3& offsetA, const glm::vec3& offsetB) const
+    {
+        return m_linearVelocities[bodyB] + glm::cross(m_angularVelocities[bodyB], offsetB) -
+            m_linearVelocities[bodyA] - glm::cross(m_angularVelocities[bodyA], offsetA);
+    }
+};
@@ -0,0 +1,171 @@
+#pragma once
+#include <vector>
+#include <cfloat>
+#include <algorithm>
+#include <initializer_list>
+#include "AABB.h"
+#include "PairManager.h"
+#include "GJKDistance.h"
+
+/*!
+ * \class ContinuousCollision "ContinuousCollision.h"
+ * \brief Stops fast bodies passing through others between steps.
+ *
+ * Runs between the broad phase and the narrow phase. Bodies flagged as continuous have AABB's covering their
+ * whole sweep, so the broad phase pairs them with everything they passed. For each of those pairs the time of
+ * impact is found by conservative advancement: the GJK distance between the two is divided by the fastest the
+ * gap could close, which is as far as both can safely move, and that is repeated until the gap is gone.
+ * Each continuous body is then moved back to its first time of impact, left just touching so the narrow phase
+ * finds the contact. The rest of its step is dropped. Bodies that are not continuous are held at the pose they
+ * ended the step at, so only the flagged bodies pay for the sweep.
+ */
+class ContinuousCollision
+{
+public:
+    /*!
+     * \brief Default Constructor
+     */
+    ContinuousCollision(){}
+
+    /*!
+     * \brief Default Destructor
+     */
+    ~ContinuousCollision(){}
+
+    /*!
+     * \brief Moves every continuous body back to its first time of impact.
+     * \param pairs The pairs found by the broad phase this frame.
+     */
+    void Solve(PairManager& pairs)
+    {
+        m_sweptPairs = 0;
+        m_totalIterations = 0;
+        m_impacts.clear();
+
+        for(PairEntry& pair : pairs.GetPairs()) {
+            AABB* box0 = pair.m_first;
+            AABB* box1 = pair.m_second;
+            if(!box0->IsContinuous() && !box1->IsContinuous()) {
+                continue;
+            }
+            m_sweptPairs++;
+
+            const float timeOfImpact = TimeOfImpact(*box0, *box1);
+            for(AABB* box : { box0, box1 }) {
+                if(box->IsContinuous() && timeOfImpact < box->GetTimeOfImpact()) {
+                    //Only list each body the first time it is hit.
+                    if(box->GetTimeOfImpact() == 1.0f) {
+                        m_impacts.push_back(box);
+                    }
+                    box->SetTimeOfImpact(timeOfImpact);
+                }
+            }
+        }
+
+        //The bodies stay inside their swept bounds, so the broad phase pairs are still valid.
+        for(AABB* box : m_impacts) {
+            POD_Transform* transform = box->GetTransform();
+            POD_Transform end = *transform;
+            GetPose(*box, end, box->GetTimeOfImpact(), *transform);
+            box->RecalculateAABB(transform, box->GetMesh());
+        }
+    }
+
+    /*!
+     * \brief Finds when two AABB's first touch over the step.
+     * \return Returns the fraction of the step, one if they never touch.
+     *
+     * Pairs already touching at the start of the step, or closer than the tolerance, are left to the narrow phase.
+     * Otherwise a body resting or sliding just above a surface would be cut back to a sliver of its step every frame.
+     */
+    float TimeOfImpact(AABB& box0, AABB& box1)
+    {
+        POD_Transform end0 = *box0.GetTransform();
+        POD_Transform end1 = *box1.GetTransform();
+        POD_Transform pose0 = end0;
+        POD_Transform pose1 = end1;
+
+        //How fast any point of each body can move along a direction, per step, is bounded by its displacement
+        //along that direction plus how far its furthest point turns.
+        const glm::vec3 displacement0 = box0.IsContinuous() ? end0.GetPosition() - box0.GetSweepPosition() : glm::vec3(0.0f);
+        const glm::vec3 displacement1 = box1.IsContinuous() ? end1.GetPosition() - box1.GetSweepPosition() : glm::vec3(0.0f);
+        const float angularBound = (box0.IsContinuous() ? box0.GetSweepAngle() * box0.GetBoundingRadius() : 0.0f) +
+            (box1.IsContinuous() ? box1.GetSweepAngle() * box1.GetBoundingRadius() : 0.0f);
+
+        float time = 0.0f;
+        for(uint32_t i = 0; i < MAX_ITERATIONS; i++) {
+            m_totalIterations++;
+            GetPose(box0, end0, time, pose0);
+            GetPose(box1, end1, time, pose1);
+
+            glm::vec3 normal;
+            float distance;
+            if(!GJKDistance::Compute(*box0.GetMesh(), pose0, *box1.GetMesh(), pose1, normal, distance)) {
+                return time == 0.0f ? 1.0f : time;
+            }
+
+            const float closingBound = glm::dot(displacement0 - displacement1, normal) + angularBound;
+            if(closingBound <= FLT_EPSILON) {
+                return 1.0f;
+            }
+            //Once they are close enough, step a little past so the narrow phase sees them overlap.
+            if(distance < TOLERANCE) {
+                return time == 0.0f ? 1.0f : (std::min)(time + LINEAR_SLOP / closingBound, 1.0f);
+            }
+
+            time += distance / closingBound;
+            if(time >= 1.0f) {
+                return 1.0f;
+            }
+        }
+        //Every step taken was safe, so where it got to is still before the impact.
+        return time;
+    }
+
+    /*!
+     * \brief Gets the number of pairs swept this frame.
+     */
+    uint32_t GetSweptPairs() const {
+        return m_sweptPairs;
+    }
+
+    /*!
+     * \brief Gets the number of bodies moved back to a time of impact this frame.
+     */
+    uint32_t GetImpacts() const {
+        return static_cast<uint32_t>(m_impacts.size());
+    }
+
+    /*!
+     * \brief Gets the conservative advancement steps taken over every pair this frame.
+     */
+    uint32_t GetTotalIterations() const {
+        return m_totalIterations;
+    }
+
+private:
+    static constexpr uint32_t MAX_ITERATIONS = 20;  /*!< The most advancement steps taken for a pair.*/
+    static constexpr float TOLERANCE = 1e-3f;       /*!< The gap at which two bodies count as touching, in world units.*/
+    static constexpr float LINEAR_SLOP = 5e-3f;     /*!< How far past touching a body is allowed to move, in world units.*/
+
+    uint32_t m_sweptPairs = 0;          /*!< Pairs with a continuous body this frame.*/
+    uint32_t m_totalIterations = 0;     /*!< Advancement steps taken this frame.*/
+    std::vector<AABB*> m_impacts;       /*!< Continuous AABB's that hit something this frame.*/
+
+    /*!
+     * \brief Gets the pose of an AABB's transform part way through the step.
+     * \param box The AABB.
+     * \param end The transform at the end of the step.
+     * \param time The fraction of the step.
+     * \param pose Receives the pose, with the scale of the end transform.
+     */
+    static void GetPose(const AABB& box, POD_Transform& end, float time, POD_Transform& pose)
+    {
+        if(!box.IsContinuous()) {
+            return;
+        }
+        pose.SetPosition(glm::mix(box.GetSweepPosition(), end.GetPosition(), time));
+        pose.SetRotation(glm::slerp(box.GetSweepRotation(), glm::normalize(end.GetRotation()), time));
+        pose.SetScale(end.GetScale());
+    }
+};
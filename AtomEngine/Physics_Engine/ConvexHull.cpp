@@ -0,0 +1,315 @@
+#include "ConvexHull.h"
+
+#include <set>
+#include <cmath>
+#include <cfloat>
+#include <utility>
+#include <algorithm>
+#include <emmintrin.h>
+
+namespace {
+
+    const float HULL_EPSILON = 1e-5f;  /*!< Distance a point must be outside a face to be added, relative to the size of the points.*/
+
+    /*!
+     * \brief A triangle of the hull, wound so its normal faces out.
+     */
+    struct HullFace
+    {
+        uint32_t m_vertices[3];
+        glm::vec3 m_normal;
+        float m_distance;
+        bool m_alive;
+    };
+
+    HullFace MakeFace(const std::vector<glm::vec3>& points, uint32_t a, uint32_t b, uint32_t c)
+    {
+        HullFace face;
+        face.m_vertices[0] = a;
+        face.m_vertices[1] = b;
+        face.m_vertices[2] = c;
+        const glm::vec3 normal = glm::cross(points[b] - points[a], points[c] - points[a]);
+        const float length = glm::length(normal);
+        face.m_normal = length > 0.0f ? normal / length : normal;
+        face.m_distance = glm::dot(face.m_normal, points[a]);
+        face.m_alive = true;
+        return face;
+    }
+
+    float DistanceToFace(const HullFace& face, const glm::vec3& point)
+    {
+        return glm::dot(face.m_normal, point) - face.m_distance;
+    }
+}
+
+void ConvexHull::Build(const std::vector<glm::vec3>& input)
+{
+    m_vertices.clear();
+    m_adjacencyOffsets.clear();
+    m_adjacency.clear();
+
+    //Meshes repeat a position for every face that shares it, so remove the duplicates first.
+    std::vector<glm::vec3> points = input;
+    std::sort(points.begin(), points.end(), [](const glm::vec3& a, const glm::vec3& b) {
+        return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+    });
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    if(points.empty()) {
+        FillScanArrays();
+        return;
+    }
+
+    glm::vec3 min = points[0];
+    glm::vec3 max = points[0];
+    for(const glm::vec3& point : points) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    const glm::vec3 extents = max - min;
+    const float epsilon = HULL_EPSILON * (std::max)((std::max)(extents.x, extents.y), extents.z);
+
+    //The starting tetrahedron, the two furthest apart points on the widest axis, then the point furthest
+    //from their line, then the point furthest from their plane.
+    const int axis = extents.x >= extents.y ? (extents.x >= extents.z ? 0 : 2) : (extents.y >= extents.z ? 1 : 2);
+    uint32_t initial[4] = { 0, 0, 0, 0 };
+    for(uint32_t i = 0; i < points.size(); i++) {
+        if(points[i][axis] < points[initial[0]][axis]) initial[0] = i;
+        if(points[i][axis] > points[initial[1]][axis]) initial[1] = i;
+    }
+
+    float furthest = 0.0f;
+    const glm::vec3 line = points[initial[1]] - points[initial[0]];
+    for(uint32_t i = 0; i < points.size(); i++) {
+        const float distance = glm::length(glm::cross(line, points[i] - points[initial[0]]));
+        if(distance > furthest) {
+            furthest = distance;
+            initial[2] = i;
+        }
+    }
+
+    furthest = 0.0f;
+    float side = 0.0f;
+    const HullFace base = MakeFace(points, initial[0], initial[1], initial[2]);
+    for(uint32_t i = 0; i < points.size(); i++) {
+        const float distance = DistanceToFace(base, points[i]);
+        if(std::abs(distance) > furthest) {
+            furthest = std::abs(distance);
+            side = distance;
+            initial[3] = i;
+        }
+    }
+
+    //Flat or degenerate point sets have no volume, so keep every point and always scan.
+    if(glm::length(line) <= epsilon || glm::length(base.m_normal) == 0.0f || furthest <= epsilon) {
+        m_vertices = points;
+        FillScanArrays();
+        return;
+    }
+
+    std::vector<HullFace> faces;
+    if(side > 0.0f) {
+        std::swap(initial[1], initial[2]);
+    }
+    faces.push_back(MakeFace(points, initial[0], initial[1], initial[2]));
+    faces.push_back(MakeFace(points, initial[0], initial[3], initial[1]));
+    faces.push_back(MakeFace(points, initial[1], initial[3], initial[2]));
+    faces.push_back(MakeFace(points, initial[2], initial[3], initial[0]));
+
+    //Add each point outside the hull, replacing every face it can see.
+    std::set<std::pair<uint32_t, uint32_t>> visibleEdges;
+    std::vector<std::pair<uint32_t, uint32_t>> horizon;
+    uint32_t aliveCount = 4;
+    for(uint32_t i = 0; i < points.size(); i++) {
+        if(i == initial[0] || i == initial[1] || i == initial[2] || i == initial[3]) {
+            continue;
+        }
+
+        visibleEdges.clear();
+        for(HullFace& face : faces) {
+            if(face.m_alive && DistanceToFace(face, points[i]) > epsilon) {
+                face.m_alive = false;
+                aliveCount--;
+                for(int edge = 0; edge < 3; edge++) {
+                    visibleEdges.emplace(face.m_vertices[edge], face.m_vertices[(edge + 1) % 3]);
+                }
+            }
+        }
+        if(visibleEdges.empty()) {
+            continue;
+        }
+
+        //The horizon is every edge of a visible face whose other face is hidden.
+        horizon.clear();
+        for(const auto& edge : visibleEdges) {
+            if(visibleEdges.find(std::make_pair(edge.second, edge.first)) == visibleEdges.end()) {
+                horizon.push_back(edge);
+            }
+        }
+        for(const auto& edge : horizon) {
+            faces.push_back(MakeFace(points, edge.first, edge.second, i));
+            aliveCount++;
+        }
+
+        //Drop dead faces once they outnumber the live ones.
+        if(faces.size() > 2 * aliveCount) {
+            faces.erase(std::remove_if(faces.begin(), faces.end(), [](const HullFace& face) { return !face.m_alive; }), faces.end());
+        }
+    }
+
+    //Keep only the points used by a face, in their sorted order.
+    std::vector<uint32_t> remap(points.size(), UINT32_MAX);
+    for(const HullFace& face : faces) {
+        if(face.m_alive) {
+            for(uint32_t vertex : face.m_vertices) {
+                remap[vertex] = 0;
+            }
+        }
+    }
+    for(uint32_t i = 0; i < points.size(); i++) {
+        if(remap[i] == 0) {
+            remap[i] = static_cast<uint32_t>(m_vertices.size());
+            m_vertices.push_back(points[i]);
+        }
+    }
+
+    //Each edge of the hull links two neighbouring vertices.
+    std::set<std::pair<uint32_t, uint32_t>> edges;
+    for(const HullFace& face : faces) {
+        if(face.m_alive) {
+            for(int edge = 0; edge < 3; edge++) {
+                const uint32_t a = remap[face.m_vertices[edge]];
+                const uint32_t b = remap[face.m_vertices[(edge + 1) % 3]];
+                edges.emplace(a, b);
+                edges.emplace(b, a);
+            }
+        }
+    }
+    m_adjacencyOffsets.assign(m_vertices.size() + 1, 0);
+    for(const auto& edge : edges) {
+        m_adjacencyOffsets[edge.first + 1]++;
+    }
+    for(uint32_t i = 0; i < m_vertices.size(); i++) {
+        m_adjacencyOffsets[i + 1] += m_adjacencyOffsets[i];
+    }
+    //The set is sorted by first vertex, so the neighbours come out grouped.
+    m_adjacency.reserve(edges.size());
+    for(const auto& edge : edges) {
+        m_adjacency.push_back(edge.second);
+    }
+
+    FillScanArrays();
+}
+
+uint32_t ConvexHull::GetSupportFeature(const glm::vec3& direction, float tolerance, uint32_t* indices, uint32_t maxCount) const
+{
+    if(m_vertices.empty() || maxCount == 0) {
+        return 0;
+    }
+
+    const uint32_t support = GetSupportIndex(direction);
+    const float threshold = glm::dot(m_vertices[support], direction) - tolerance;
+    indices[0] = support;
+    uint32_t count = 1;
+
+    if(m_adjacency.empty()) {
+        for(uint32_t i = 0; i < m_vertices.size() && count < maxCount; i++) {
+            if(i != support && glm::dot(m_vertices[i], direction) >= threshold) {
+                indices[count++] = i;
+            }
+        }
+        return count;
+    }
+
+    //The vertices above any plane form one connected cap of the hull, so flood out along the edges from
+    //the support, using the output as the queue.
+    for(uint32_t next = 0; next < count && count < maxCount; next++) {
+        const uint32_t vertex = indices[next];
+        for(uint32_t i = m_adjacencyOffsets[vertex]; i < m_adjacencyOffsets[vertex + 1] && count < maxCount; i++) {
+            const uint32_t neighbour = m_adjacency[i];
+            if(glm::dot(m_vertices[neighbour], direction) < threshold) {
+                continue;
+            }
+            bool found = false;
+            for(uint32_t j = 0; j < count && !found; j++) {
+                found = indices[j] == neighbour;
+            }
+            if(!found) {
+                indices[count++] = neighbour;
+            }
+        }
+    }
+    return count;
+}
+
+uint32_t ConvexHull::ScanSupport(const glm::vec3& direction) const
+{
+    const __m128 dx = _mm_set1_ps(direction.x);
+    const __m128 dy = _mm_set1_ps(direction.y);
+    const __m128 dz = _mm_set1_ps(direction.z);
+    const __m128i step = _mm_set1_epi32(4);
+
+    __m128 best = _mm_set1_ps(-FLT_MAX);
+    __m128i bestIndex = _mm_setzero_si128();
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+
+    for(size_t i = 0; i < m_x.size(); i += 4) {
+        const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_x[i]), dx), _mm_mul_ps(_mm_loadu_ps(&m_y[i]), dy)), _mm_mul_ps(_mm_loadu_ps(&m_z[i]), dz));
+        //Only a strictly further vertex replaces a lane's best, so each lane keeps its lowest index on ties.
+        const __m128 further = _mm_cmpgt_ps(dot, best);
+        const __m128i furtherMask = _mm_castps_si128(further);
+        best = _mm_or_ps(_mm_and_ps(further, dot), _mm_andnot_ps(further, best));
+        bestIndex = _mm_or_si128(_mm_and_si128(furtherMask, index), _mm_andnot_si128(furtherMask, bestIndex));
+        index = _mm_add_epi32(index, step);
+    }
+
+    alignas(16) float lanes[4];
+    alignas(16) uint32_t laneIndices[4];
+    _mm_store_ps(lanes, best);
+    _mm_store_si128(reinterpret_cast<__m128i*>(laneIndices), bestIndex);
+
+    uint32_t result = laneIndices[0];
+    float furthest = lanes[0];
+    for(int lane = 1; lane < 4; lane++) {
+        if(lanes[lane] > furthest || (lanes[lane] == furthest && laneIndices[lane] < result)) {
+            furthest = lanes[lane];
+            result = laneIndices[lane];
+        }
+    }
+    return result;
+}
+
+uint32_t ConvexHull::ClimbSupport(const glm::vec3& direction, uint32_t start) const
+{
+    uint32_t current = start;
+    float furthest = glm::dot(m_vertices[current], direction);
+
+    bool moved = true;
+    while(moved) {
+        moved = false;
+        const uint32_t end = m_adjacencyOffsets[current + 1];
+        for(uint32_t i = m_adjacencyOffsets[current]; i < end; i++) {
+            const uint32_t neighbour = m_adjacency[i];
+            const float distance = glm::dot(m_vertices[neighbour], direction);
+            if(distance > furthest) {
+                furthest = distance;
+                current = neighbour;
+                moved = true;
+            }
+        }
+    }
+    return current;
+}
+
+void ConvexHull::FillScanArrays()
+{
+    const size_t padded = (m_vertices.size() + 3) & ~static_cast<size_t>(3);
+    m_x.resize(padded);
+    m_y.resize(padded);
+    m_z.resize(padded);
+    for(size_t i = 0; i < padded; i++) {
+        const glm::vec3& vertex = m_vertices[i < m_vertices.size() ? i : 0];
+        m_x[i] = vertex.x;
+        m_y[i] = vertex.y;
+        m_z[i] = vertex.z;
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#ifdef BUILDING_DLL
+#define ATOM_API __declspec(dllexport)
+#else
+#define ATOM_API __declspec(dllimport)
+#endif
+
+#include <vector>
+#include <cstdint>
+#include <GLM/glm.hpp>
+
+/*!
+ * \class ConvexHull "ConvexHull.h"
+ * \brief The convex hull of a set of points, with the edges between its vertices, for fast support queries.
+ *
+ * Built once when a mesh is loaded and shared by every copy of that mesh. Small hulls are searched with a SIMD
+ * scan over every vertex. Larger hulls are searched by hill climbing along the edges from a starting vertex,
+ * which on a convex hull always ends at the furthest vertex. Neither search allocates.
+ */
+class ATOM_API ConvexHull
+{
+public:
+    static constexpr uint32_t HILL_CLIMB_THRESHOLD = 32;   /*!< Hulls with more vertices than this are hill climbed.*/
+
+    /*!
+     * \brief Default Constructor, makes an empty hull.
+     */
+    ConvexHull() = default;
+
+    /*!
+     * \brief Builds the hull of a set of points.
+     * \param points The points, duplicates and interior points are allowed.
+     */
+    explicit ConvexHull(const std::vector<glm::vec3>& points) {
+        Build(points);
+    }
+
+    /*!
+     * \brief Builds the hull of a set of points, replacing the current hull.
+     * \param points The points, duplicates and interior points are allowed.
+     *
+     * The hull is grown one point at a time from a starting tetrahedron, each point that is outside replaces
+     * the faces it can see with a fan of faces to their horizon. If the points are flat or all in a line
+     * every distinct point is kept and the hull is always searched by scanning.
+     */
+    void Build(const std::vector<glm::vec3>& points);
+
+    /*!
+     * \brief Finds the vertex furthest in a direction.
+     * \param direction The direction, does not need to be normalised.
+     * \param start The vertex hill climbing starts from, a nearby answer from a previous query makes it quicker.
+     * \return Returns the index of the furthest vertex.
+     */
+    uint32_t GetSupportIndex(const glm::vec3& direction, uint32_t start = 0) const {
+        if(m_vertices.size() <= HILL_CLIMB_THRESHOLD || m_adjacency.empty()) {
+            return ScanSupport(direction);
+        }
+        return ClimbSupport(direction, start < m_vertices.size() ? start : 0);
+    }
+
+    /*!
+     * \brief Finds the vertex furthest in a direction.
+     * \param direction The direction, does not need to be normalised.
+     */
+    const glm::vec3& GetSupport(const glm::vec3& direction) const {
+        return m_vertices[GetSupportIndex(direction)];
+    }
+
+    /*!
+     * \brief Finds every vertex within a tolerance of the furthest in a direction.
+     * \param direction The direction, does not need to be normalised.
+     * \param tolerance How far behind the furthest vertex, measured along the direction, a vertex may be.
+     * \param indices Receives the index of each vertex found, the furthest first.
+     * \param maxCount The most indices to write.
+     * \return Returns the number of vertices found.
+     *
+     * Gives the face, edge or single vertex the hull presents in that direction, used to build contact points.
+     */
+    uint32_t GetSupportFeature(const glm::vec3& direction, float tolerance, uint32_t* indices, uint32_t maxCount) const;
+
+    const glm::vec3& GetVertex(uint32_t index) const {
+        return m_vertices[index];
+    }
+
+    uint32_t GetVertexCount() const {
+        return static_cast<uint32_t>(m_vertices.size());
+    }
+
+    bool IsEmpty() const {
+        return m_vertices.empty();
+    }
+
+private:
+    /*!
+     * \brief Tests every vertex four at a time.
+     * \param direction The search direction.
+     *
+     * Ties go to the lowest index, the same as a scalar scan.
+     */
+    uint32_t ScanSupport(const glm::vec3& direction) const;
+
+    /*!
+     * \brief Walks from vertex to neighbouring vertex while the neighbour is further in the direction.
+     * \param direction The search direction.
+     * \param start The vertex to start from.
+     */
+    uint32_t ClimbSupport(const glm::vec3& direction, uint32_t start) const;
+
+    /*!
+     * \brief Fills the SIMD copies of the vertices.
+     */
+    void FillScanArrays();
+
+    std::vector<glm::vec3> m_vertices;          /*!< The vertices of the hull.*/
+    std::vector<uint32_t> m_adjacencyOffsets;   /*!< Where each vertex's neighbours start in the adjacency list, with one extra entry at the end.*/
+    std::vector<uint32_t> m_adjacency;          /*!< The neighbours of every vertex, one after another.*/
+
+    //Vertex components stored apart for the scan, padded to a multiple of four with copies of the first vertex.
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+};
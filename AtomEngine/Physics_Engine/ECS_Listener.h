@@ -0,0 +1,90 @@
+#pragma once
+
+#ifdef BUILDING_DLL
+#define ATOM_API __declspec(dllexport)
+#else
+#define ATOM_API __declspec(dllimport)
+#endif
+
+#include "ECS_Component.h"
+#include <vector>
+
+/*!
+ * \brief The Base class for anything that needs to hear about components being added, removed or moved in the ECS.
+ *
+ * Components are stored by value in one block of memory per type, so adding a component can grow the block and
+ * removing one moves the last component into the gap. Anything holding a pointer to a component must update it
+ * when it is told the component has moved.
+ */
+class ATOM_API ECSListener
+{
+public:
+    /*!
+     * \brief Default Constructor
+     */
+    ECSListener() = default;
+
+    /*!
+     * \brief Default Destructor
+     */
+    virtual ~ECSListener() = default;
+
+    /*!
+     * \brief Called after a component of a listened type has been added.
+     * \param entity The entity the component was added to.
+     * \param componentID The component type ID.
+     * \param component The new component.
+     */
+    virtual void OnComponentAdded(EntityHandle /*entity*/, uint32_t /*componentID*/, BaseECSComponent* /*component*/) {}
+
+    /*!
+     * \brief Called before a component of a listened type is removed.
+     * \param entity The entity the component is being removed from.
+     * \param componentID The component type ID.
+     * \param component The component, still valid during the call.
+     */
+    virtual void OnComponentRemoved(EntityHandle /*entity*/, uint32_t /*componentID*/, BaseECSComponent* /*component*/) {}
+
+    /*!
+     * \brief Called after a component of a listened type has moved to a new address.
+     * \param componentID The component type ID.
+     * \param component The component at its new address.
+     */
+    virtual void OnComponentMoved(uint32_t /*componentID*/, BaseECSComponent* /*component*/) {}
+
+    /*!
+     * \brief Gets the component types this listener wants to hear about.
+     * \return The component types listened to.
+     */
+    inline const std::vector<uint32_t>& GetListenedTypes() {
+        return m_listenedTypes;
+    }
+
+    /*!
+     * \brief Checks if this listener wants to hear about a component type.
+     * \param componentID The component type ID.
+     */
+    inline bool IsListeningTo(uint32_t componentID) {
+        for(uint32_t type : m_listenedTypes) {
+            if(type == componentID) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+protected:
+    /*!
+     * \brief Adds a component type to listen to.
+     * \param componentID The component type ID.
+     */
+    inline void AddListenedType(uint32_t componentID) {
+        m_listenedTypes.push_back(componentID);
+    }
+
+private:
+    /*!
+     * \brief A container of the component types this listener wants to hear about.
+     */
+    std::vector<uint32_t> m_listenedTypes;
+};
@@ -59,6 +59,9 @@ void ECS_Manager::RemoveEntity(EntityHandle handle)
 
     m_entities[destIndex] = m_entities[sourceIndex];
     m_entities.pop_back();
+    if(destIndex < m_entities.size()) {
+        m_entities[destIndex]->first = destIndex;
+    }
 
 }
 
@@ -125,6 +128,9 @@ void ECS_Manager::DeleteComponent(uint32_t componentID, uint32_t index)
     auto destComponent = (BaseECSComponent*)&data[index];
     auto sourceComponent = (BaseECSComponent*)&data[sourceIndex];
 
+    //Tell listeners while the component is still valid.
+    NotifyComponentRemoved(destComponent->m_entityID, componentID, destComponent);
+
     freeFunc(destComponent);
     if(index == sourceIndex) {
         data.resize(sourceIndex);
@@ -132,6 +138,7 @@ void ECS_Manager::DeleteComponent(uint32_t componentID, uint32_t index)
     }
 
     std::memcpy(destComponent, sourceComponent, size);
+    NotifyComponentMoved(componentID, destComponent);
 
     auto& entity = HandleToEntity(sourceComponent->m_entityID);
     for(auto& component : entity){
@@ -163,7 +170,24 @@ bool ECS_Manager::RemoveComponentInternal(EntityHandle handle, uint32_t componen
 void ECS_Manager::AddComponentInternal(EntityHandle handle, Entity& entity, uint32_t componentID, BaseECSComponent* component)
 {
     auto createFunc = BaseECSComponent::GetTypeCreateFunction(componentID);
-    entity.emplace_back(componentID, createFunc(m_components[componentID], handle, component));
+    std::vector<uint8_t>& data = m_components[componentID];
+
+    //Growing the memory block moves every component already in it.
+    const uint8_t* oldData = data.data();
+    const uint32_t index = createFunc(data, handle, component);
+    entity.emplace_back(componentID, index);
+
+    if(m_listeners.empty()) {
+        return;
+    }
+
+    if(oldData != data.data()) {
+        const auto size = BaseECSComponent::GetTypeSize(componentID);
+        for(uint32_t i = 0; i < index; i += size) {
+            NotifyComponentMoved(componentID, (BaseECSComponent*)&data[i]);
+        }
+    }
+    NotifyComponentAdded(handle, componentID, (BaseECSComponent*)&data[index]);
 }
 
 BaseECSComponent* ECS_Manager::GetComponentInternal(Entity& entity, std::vector<uint8_t>& data,  uint32_t componentID)
@@ -218,3 +242,56 @@ void ECS_Manager::UpdateSystemWithMultiComponent(uint32_t index, ECSSystemList&
 
     systemList[index]->UpdateComponents(deltaTime, components);
 }
+
+void ECS_Manager::AddListener(ECSListener* listener)
+{
+    m_listeners.push_back(listener);
+
+    //Tell the new listener about every component it has missed.
+    for(uint32_t componentID : listener->GetListenedTypes()) {
+        auto& data = m_components[componentID];
+        const auto size = BaseECSComponent::GetTypeSize(componentID);
+        for(uint32_t i = 0; i < data.size(); i += size) {
+            auto component = (BaseECSComponent*)&data[i];
+            listener->OnComponentAdded(component->m_entityID, componentID, component);
+        }
+    }
+}
+
+bool ECS_Manager::RemoveListener(ECSListener* listener)
+{
+    for(uint32_t i = 0; i < m_listeners.size(); i++) {
+        if(listener == m_listeners[i]) {
+            m_listeners.erase(m_listeners.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ECS_Manager::NotifyComponentAdded(EntityHandle handle, uint32_t componentID, BaseECSComponent* component)
+{
+    for(auto listener : m_listeners) {
+        if(listener->IsListeningTo(componentID)) {
+            listener->OnComponentAdded(handle, componentID, component);
+        }
+    }
+}
+
+void ECS_Manager::NotifyComponentRemoved(EntityHandle handle, uint32_t componentID, BaseECSComponent* component)
+{
+    for(auto listener : m_listeners) {
+        if(listener->IsListeningTo(componentID)) {
+            listener->OnComponentRemoved(handle, componentID, component);
+        }
+    }
+}
+
+void ECS_Manager::NotifyComponentMoved(uint32_t componentID, BaseECSComponent* component)
+{
+    for(auto listener : m_listeners) {
+        if(listener->IsListeningTo(componentID)) {
+            listener->OnComponentMoved(componentID, component);
+        }
+    }
+}
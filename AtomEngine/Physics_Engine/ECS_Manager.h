@@ -8,6 +8,7 @@
 
 #include "ECS_Component.h"
 #include "ECS_System.h"
+#include "ECS_Listener.h"
 #include <map>
 
 typedef std::vector<std::pair<uint32_t, uint32_t>> Entity;
@@ -57,8 +58,29 @@ public:
     
 #pragma endregion 
 
+#pragma region ListenerMethods
+
+    /*!
+     * \brief Adds a listener to be told about components being added, removed and moved.
+     * \param listener The listener to add.
+     *
+     * The listener is told about every existing component of the types it listens to straight away,
+     * so it does not matter whether it is added before or after the entities are made.
+     */
+    void AddListener(ECSListener* listener);
+
+    /*!
+     * \brief Stops a listener from being told about components.
+     * \param listener The listener to remove.
+     * \return Whether the listener was found.
+     */
+    bool RemoveListener(ECSListener* listener);
+
+#pragma endregion 
+
 private:
     std::vector<BaseECSSystem*> m_systems;
+    std::vector<ECSListener*> m_listeners;
     std::map<uint32_t, std::vector<uint8_t>> m_components;
     std::vector<EntityRaw*> m_entities;
 
@@ -90,6 +112,14 @@ private:
 
 #pragma endregion
 
+#pragma region InternalListenerMethods
+
+    void NotifyComponentAdded(EntityHandle handle, uint32_t componentID, BaseECSComponent* component);
+    void NotifyComponentRemoved(EntityHandle handle, uint32_t componentID, BaseECSComponent* component);
+    void NotifyComponentMoved(uint32_t componentID, BaseECSComponent* component);
+
+#pragma endregion
+
 #pragma region InternalSystemMethods
 
     void UpdateSystemWithMultiComponent(uint32_t index, ECSSystemList& systemList, float deltaTime, const std::vector<uint32_t>& componentTypes,
@@ -0,0 +1,249 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cfloat>
+#include <utility>
+#include "Simplex.h"
+
+/*!
+ * \class EPA "EPA.h"
+ * \brief Expanding Polytope Algorithm
+ *
+ * Finds how deep two touching colliders overlap, starting from the simplex GJK ended with. The simplex is grown
+ * into a polytope inside the Minkowski difference, and the face nearest the origin is pushed out with a new support
+ * point until it can move no further. That face's normal and distance are the contact normal and depth.
+ * The vertices, faces and horizon edges are kept in fixed size pools, if they fill up the best face found so far
+ * is used, so nothing is allocated.
+ */
+class EPA
+{
+public:
+    static constexpr uint32_t MAX_VERTICES = 64;   /*!< The most vertices the polytope can have.*/
+    static constexpr uint32_t MAX_FACES = 128;     /*!< The most faces the polytope can have.*/
+    static constexpr uint32_t MAX_HORIZON = 64;    /*!< The most edges the horizon can have when a point is added.*/
+
+    /*!
+     * \brief Default Constructor
+     */
+    EPA(){}
+
+    /*!
+     * \brief Default Destructor
+     */
+    ~EPA(){}
+
+    /*!
+     * \brief Finds the penetration normal and depth of two touching colliders.
+     * \param box0 The first collider.
+     * \param box1 The second collider.
+     * \param simplex The simplex GJK ended with, containing or touching the origin.
+     * \param normal Receives the unit contact normal, pointing from the first collider to the second.
+     * \param depth Receives how far the colliders overlap along the normal.
+     * \return Returns false if the simplex could not be grown into a tetrahedron, when the colliders only just touch.
+     */
+    bool Solve(const AABB& box0, const AABB& box1, const Simplex& simplex, glm::vec3& normal, float& depth)
+    {
+        m_iterations = 0;
+        if(!BuildTetrahedron(box0, box1, simplex)) {
+            return false;
+        }
+
+        uint32_t closest = 0;
+        while(true) {
+            //Find the face nearest the origin.
+            closest = 0;
+            for(uint32_t i = 1; i < m_faceCount; i++) {
+                if(m_faces[i].m_distance < m_faces[closest].m_distance) {
+                    closest = i;
+                }
+            }
+            const Face face = m_faces[closest];
+            if(face.m_distance == FLT_MAX) {
+                return false;
+            }
+
+            //Stop once the support point in the face's direction is no further out than the face.
+            const glm::vec3 support = MinkowskiDifferenceSupport(box0, box1, face.m_normal);
+            if(glm::dot(support, face.m_normal) - face.m_distance < TOLERANCE || m_vertexCount == MAX_VERTICES) {
+                break;
+            }
+            m_iterations++;
+
+            //Remove every face the new point can see, keeping the edges around them.
+            m_horizonCount = 0;
+            bool overflow = false;
+            for(uint32_t i = 0; i < m_faceCount;) {
+                const Face& visible = m_faces[i];
+                if(glm::dot(visible.m_normal, support - m_vertices[visible.m_vertices[0]]) > 0.0f) {
+                    for(int edge = 0; edge < 3 && !overflow; edge++) {
+                        overflow = !AddHorizonEdge(visible.m_vertices[edge], visible.m_vertices[(edge + 1) % 3]);
+                    }
+                    m_faces[i] = m_faces[--m_faceCount];
+                }
+                else {
+                    i++;
+                }
+            }
+            //The pools are full, fall back to the face found before this point.
+            if(overflow || m_faceCount + m_horizonCount > MAX_FACES) {
+                normal = -face.m_normal;
+                depth = (std::max)(face.m_distance, 0.0f);
+                return true;
+            }
+
+            //Join the new point to every horizon edge, keeping the winding of the removed faces.
+            const uint32_t vertex = m_vertexCount++;
+            m_vertices[vertex] = support;
+            for(uint32_t i = 0; i < m_horizonCount; i++) {
+                AddFace(m_horizon[i].first, m_horizon[i].second, vertex);
+            }
+        }
+
+        //The face normal points out of the Minkowski difference, the second collider minus the first, so the
+        //first collider has to move along it to separate and the contact normal is its reverse.
+        normal = -m_faces[closest].m_normal;
+        depth = (std::max)(m_faces[closest].m_distance, 0.0f);
+        return true;
+    }
+
+    /*!
+     * \brief Gets the number of points added to the polytope by the last call to Solve.
+     */
+    uint32_t GetIterations() const {
+        return m_iterations;
+    }
+
+private:
+    static constexpr float TOLERANCE = 1e-4f;   /*!< How close the support must be to the nearest face to stop, in world units.*/
+
+    /*!
+     * \struct Face
+     * \brief A triangle of the polytope, wound so its normal points away from the origin.
+     */
+    struct Face
+    {
+        uint32_t m_vertices[3];
+        glm::vec3 m_normal;
+        float m_distance;
+    };
+
+    std::array<glm::vec3, MAX_VERTICES> m_vertices;                     /*!< The vertices of the polytope.*/
+    std::array<Face, MAX_FACES> m_faces;                                /*!< The faces of the polytope.*/
+    std::array<std::pair<uint32_t, uint32_t>, MAX_HORIZON> m_horizon;  /*!< Edges around the faces being removed.*/
+    uint32_t m_vertexCount = 0;
+    uint32_t m_faceCount = 0;
+    uint32_t m_horizonCount = 0;
+    uint32_t m_iterations = 0;
+
+    /*!
+     * \brief Turns the GJK simplex into a tetrahedron around the origin.
+     *
+     * GJK stops early when the origin lies on a point, line or triangle of the simplex, so any missing points are
+     * found by searching away from what is there.
+     */
+    bool BuildTetrahedron(const AABB& box0, const AABB& box1, const Simplex& simplex)
+    {
+        static const glm::vec3 axes[3] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+
+        m_vertexCount = static_cast<uint32_t>(simplex.m_count);
+        for(uint32_t i = 0; i < m_vertexCount; i++) {
+            m_vertices[i] = simplex.m_points[i];
+        }
+
+        if(m_vertexCount == 1) {
+            for(int i = 0; i < 6 && m_vertexCount == 1; i++) {
+                const glm::vec3 point = MinkowskiDifferenceSupport(box0, box1, i < 3 ? axes[i] : -axes[i - 3]);
+                if(glm::length(point - m_vertices[0]) > TOLERANCE) {
+                    m_vertices[m_vertexCount++] = point;
+                }
+            }
+        }
+        if(m_vertexCount == 2) {
+            const glm::vec3 line = m_vertices[1] - m_vertices[0];
+            for(int i = 0; i < 6 && m_vertexCount == 2; i++) {
+                const glm::vec3 direction = glm::cross(line, axes[i % 3]) * (i < 3 ? 1.0f : -1.0f);
+                if(glm::dot(direction, direction) < TOLERANCE * TOLERANCE) {
+                    continue;
+                }
+                const glm::vec3 point = MinkowskiDifferenceSupport(box0, box1, direction);
+                if(glm::length(glm::cross(line, point - m_vertices[0])) > TOLERANCE * glm::length(line)) {
+                    m_vertices[m_vertexCount++] = point;
+                }
+            }
+        }
+        if(m_vertexCount == 3) {
+            const glm::vec3 triangle = glm::cross(m_vertices[1] - m_vertices[0], m_vertices[2] - m_vertices[0]);
+            for(int side = 0; side < 2 && m_vertexCount == 3; side++) {
+                const glm::vec3 direction = side == 0 ? triangle : -triangle;
+                const glm::vec3 point = MinkowskiDifferenceSupport(box0, box1, direction);
+                if(std::abs(glm::dot(point - m_vertices[0], triangle)) > TOLERANCE * glm::length(triangle)) {
+                    m_vertices[m_vertexCount++] = point;
+                }
+            }
+        }
+        if(m_vertexCount != 4) {
+            return false;
+        }
+
+        const glm::vec3& a = m_vertices[0];
+        const float volume = glm::dot(m_vertices[1] - a, glm::cross(m_vertices[2] - a, m_vertices[3] - a));
+        if(std::abs(volume) < TOLERANCE * TOLERANCE * TOLERANCE) {
+            return false;
+        }
+
+        //Wind each face so the vertex it does not use is behind it.
+        m_faceCount = 0;
+        const uint32_t faces[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+        for(const auto& face : faces) {
+            const glm::vec3 faceNormal = glm::cross(m_vertices[face[1]] - m_vertices[face[0]], m_vertices[face[2]] - m_vertices[face[0]]);
+            if(glm::dot(faceNormal, m_vertices[face[3]] - m_vertices[face[0]]) > 0.0f) {
+                AddFace(face[0], face[2], face[1]);
+            }
+            else {
+                AddFace(face[0], face[1], face[2]);
+            }
+        }
+        return true;
+    }
+
+    void AddFace(uint32_t a, uint32_t b, uint32_t c)
+    {
+        Face& face = m_faces[m_faceCount++];
+        face.m_vertices[0] = a;
+        face.m_vertices[1] = b;
+        face.m_vertices[2] = c;
+
+        const glm::vec3 normal = glm::cross(m_vertices[b] - m_vertices[a], m_vertices[c] - m_vertices[a]);
+        const float length = glm::length(normal);
+        //A sliver face has no usable normal, it is kept to close the polytope but never chosen.
+        if(length > FLT_EPSILON) {
+            face.m_normal = normal / length;
+            face.m_distance = glm::dot(face.m_normal, m_vertices[a]);
+        }
+        else {
+            face.m_normal = glm::vec3(0.0f);
+            face.m_distance = FLT_MAX;
+        }
+    }
+
+    /*!
+     * \brief Adds an edge of a removed face to the horizon.
+     * \return Returns false if the horizon is full.
+     *
+     * An edge shared by two removed faces is seen once in each direction, the second time it cancels the first.
+     */
+    bool AddHorizonEdge(uint32_t a, uint32_t b)
+    {
+        for(uint32_t i = 0; i < m_horizonCount; i++) {
+            if(m_horizon[i].first == b && m_horizon[i].second == a) {
+                m_horizon[i] = m_horizon[--m_horizonCount];
+                return true;
+            }
+        }
+        if(m_horizonCount == MAX_HORIZON) {
+            return false;
+        }
+        m_horizon[m_horizonCount++] = std::make_pair(a, b);
+        return true;
+    }
+};
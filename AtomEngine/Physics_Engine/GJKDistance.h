@@ -0,0 +1,235 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <GLM/glm.hpp>
+#include "POD_Mesh.h"
+#include "POD_Transform.h"
+#include "Simplex.h"
+
+/*!
+ * Finds how far apart two separated convex meshes are.
+ *
+ * The boolean GJK in the narrow phase only has to decide whether the origin is inside the Minkowski difference,
+ * this version finds the point of the difference nearest the origin. Each iteration the simplex is cut down to
+ * the point, edge or face nearest the origin, and a new support point is taken back towards it, until no support
+ * point gets any closer. The meshes are given with their own transforms rather than through an AABB, so they
+ * can be posed anywhere along a sweep.
+ */
+namespace GJKDistance {
+
+    const uint32_t MAX_ITERATIONS = 32;     /*!< The most support points taken before giving up with the best distance so far.*/
+    const float RELATIVE_TOLERANCE = 1e-4f; /*!< How far apart the upper and lower bounds on the distance can be when it is found, relative to the distance.*/
+    const float ABSOLUTE_TOLERANCE = 1e-5f; /*!< How far apart the bounds can be when it is found, in world units, for distances near zero.*/
+    const float OVERLAP_EPSILON = 1e-12f;   /*!< Squared distance below which the meshes are treated as touching.*/
+
+    /*!
+     * \brief Gets a support point from the Minkowski difference of two posed meshes, the second minus the first.
+     */
+    inline glm::vec3 Support(POD_Mesh& mesh0, POD_Transform& transform0, POD_Mesh& mesh1, POD_Transform& transform1, const glm::vec3& direction) {
+        return mesh1.Support(transform1, direction) - mesh0.Support(transform0, -direction);
+    }
+
+    /*!
+     * \brief Finds the point on a line segment nearest the origin, cutting the simplex down to the feature it lies on.
+     */
+    inline glm::vec3 ClosestOnLine(Simplex& simplex) {
+        const glm::vec3 a = simplex.m_points[0];
+        const glm::vec3 b = simplex.m_points[1];
+        const glm::vec3 lineAB = b - a;
+        const float lengthSquared = glm::dot(lineAB, lineAB);
+        const float t = lengthSquared > 0.0f ? glm::dot(-a, lineAB) / lengthSquared : 0.0f;
+        if(t <= 0.0f) {
+            simplex.Set(a);
+            return a;
+        }
+        if(t >= 1.0f) {
+            simplex.Set(b);
+            return b;
+        }
+        return a + lineAB * t;
+    }
+
+    /*!
+     * \brief Finds the point on a triangle nearest the origin, cutting the simplex down to the feature it lies on.
+     *
+     * Works through the vertex, edge and face regions of the triangle in turn, as in Ericson's Real-Time Collision Detection.
+     */
+    inline glm::vec3 ClosestOnTriangle(Simplex& simplex) {
+        const glm::vec3 a = simplex.m_points[0];
+        const glm::vec3 b = simplex.m_points[1];
+        const glm::vec3 c = simplex.m_points[2];
+        const glm::vec3 lineAB = b - a;
+        const glm::vec3 lineAC = c - a;
+
+        const glm::vec3 lineAO = -a;
+        const float d1 = glm::dot(lineAB, lineAO);
+        const float d2 = glm::dot(lineAC, lineAO);
+        if(d1 <= 0.0f && d2 <= 0.0f) {
+            simplex.Set(a);
+            return a;
+        }
+
+        const glm::vec3 lineBO = -b;
+        const float d3 = glm::dot(lineAB, lineBO);
+        const float d4 = glm::dot(lineAC, lineBO);
+        if(d3 >= 0.0f && d4 <= d3) {
+            simplex.Set(b);
+            return b;
+        }
+
+        const float vc = d1 * d4 - d3 * d2;
+        if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            simplex.Set(a, b);
+            return a + lineAB * (d1 / (d1 - d3));
+        }
+
+        const glm::vec3 lineCO = -c;
+        const float d5 = glm::dot(lineAB, lineCO);
+        const float d6 = glm::dot(lineAC, lineCO);
+        if(d6 >= 0.0f && d5 <= d6) {
+            simplex.Set(c);
+            return c;
+        }
+
+        const float vb = d5 * d2 - d1 * d6;
+        if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            simplex.Set(a, c);
+            return a + lineAC * (d2 / (d2 - d6));
+        }
+
+        const float va = d3 * d6 - d5 * d4;
+        if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+            simplex.Set(b, c);
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        }
+
+        //A flat triangle has no face region, so take the nearer of its two edges through A.
+        if(va + vb + vc <= 0.0f) {
+            Simplex edgeAB;
+            Simplex edgeAC;
+            edgeAB.Set(a, b);
+            edgeAC.Set(a, c);
+            const glm::vec3 pointAB = ClosestOnLine(edgeAB);
+            const glm::vec3 pointAC = ClosestOnLine(edgeAC);
+            const bool nearerAB = glm::dot(pointAB, pointAB) <= glm::dot(pointAC, pointAC);
+            simplex = nearerAB ? edgeAB : edgeAC;
+            return nearerAB ? pointAB : pointAC;
+        }
+
+        const float denominator = 1.0f / (va + vb + vc);
+        return a + lineAB * (vb * denominator) + lineAC * (vc * denominator);
+    }
+
+    /*!
+     * \brief Finds the point on a tetrahedron nearest the origin, cutting the simplex down to the feature it lies on.
+     * \return Returns false if the origin is inside the tetrahedron.
+     *
+     * Only faces with the origin on their outside can hold the nearest point, the nearest of those is kept.
+     */
+    inline bool ClosestOnTetrahedron(Simplex& simplex, glm::vec3& closest) {
+        const glm::vec3 a = simplex.m_points[0];
+        const glm::vec3 b = simplex.m_points[1];
+        const glm::vec3 c = simplex.m_points[2];
+        const glm::vec3 d = simplex.m_points[3];
+        //Each face with the vertex it leaves out.
+        const glm::vec3 faces[4][4] = { { a, b, c, d }, { a, c, d, b }, { a, d, b, c }, { b, d, c, a } };
+
+        bool outside = false;
+        float nearest = 0.0f;
+        for(const auto& face : faces) {
+            const glm::vec3 normal = glm::cross(face[1] - face[0], face[2] - face[0]);
+            const float originSide = glm::dot(-face[0], normal);
+            const float vertexSide = glm::dot(face[3] - face[0], normal);
+            //A flat tetrahedron has no inside, so every face is tried.
+            if(originSide * vertexSide > 0.0f) {
+                continue;
+            }
+
+            Simplex triangle;
+            triangle.Set(face[0], face[1], face[2]);
+            const glm::vec3 point = ClosestOnTriangle(triangle);
+            const float distance = glm::dot(point, point);
+            if(!outside || distance < nearest) {
+                outside = true;
+                nearest = distance;
+                closest = point;
+                simplex = triangle;
+            }
+        }
+        return outside;
+    }
+
+    /*!
+     * \brief Finds the point on the simplex nearest the origin, cutting the simplex down to the feature it lies on.
+     * \return Returns false if the simplex is a tetrahedron containing the origin.
+     */
+    inline bool ClosestOnSimplex(Simplex& simplex, glm::vec3& closest) {
+        switch(simplex.m_count)
+        {
+        case 1:
+            closest = simplex.m_points[0];
+            return true;
+        case 2:
+            closest = ClosestOnLine(simplex);
+            return true;
+        case 3:
+            closest = ClosestOnTriangle(simplex);
+            return true;
+        default:
+            return ClosestOnTetrahedron(simplex, closest);
+        }
+    }
+
+    /*!
+     * \brief Finds the distance between two posed convex meshes.
+     * \param mesh0 The first mesh.
+     * \param transform0 The pose of the first mesh.
+     * \param mesh1 The second mesh.
+     * \param transform1 The pose of the second mesh.
+     * \param normal Receives the unit direction from the nearest point of the first mesh to the nearest of the second.
+     * \param distance Receives the distance between the meshes.
+     * \return Returns false if the meshes are touching, when there is no distance to find.
+     */
+    inline bool Compute(POD_Mesh& mesh0, POD_Transform& transform0, POD_Mesh& mesh1, POD_Transform& transform1, glm::vec3& normal, float& distance) {
+        glm::vec3 direction = transform0.GetPosition() - transform1.GetPosition();
+        if(glm::dot(direction, direction) < OVERLAP_EPSILON) {
+            direction = glm::vec3(1.0f, 0.0f, 0.0f);
+        }
+
+        Simplex simplex;
+        simplex.Set(Support(mesh0, transform0, mesh1, transform1, direction));
+        glm::vec3 closest = simplex.m_points[0];
+
+        for(uint32_t i = 0; i < MAX_ITERATIONS; i++) {
+            const float closestSquared = glm::dot(closest, closest);
+            if(closestSquared < OVERLAP_EPSILON) {
+                return false;
+            }
+
+            //The nearest point found is an upper bound on the distance, and the plane through the support back
+            //towards the origin is a lower bound. Stop once they meet.
+            const glm::vec3 support = Support(mesh0, transform0, mesh1, transform1, -closest);
+            const float upper = std::sqrt(closestSquared);
+            const float lower = glm::dot(closest, support) / upper;
+            if(upper - lower <= (std::max)(RELATIVE_TOLERANCE * upper, ABSOLUTE_TOLERANCE)) {
+                break;
+            }
+
+            simplex.Push(support);
+            glm::vec3 next;
+            if(!ClosestOnSimplex(simplex, next)) {
+                return false;
+            }
+            //Rounding can stop the point getting any nearer, or a degenerate simplex can give no point at all,
+            //keep the last one when it does.
+            if(!(glm::dot(next, next) < closestSquared)) {
+                break;
+            }
+            closest = next;
+        }
+
+        distance = glm::length(closest);
+        normal = closest / distance;
+        return true;
+    }
+}
@@ -0,0 +1,166 @@
+#include "IntegrationKernels.h"
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define TARGET_AVX
+#else
+#define TARGET_AVX __attribute__((target("avx")))
+#endif
+
+namespace IntegrationKernels {
+
+    void IntegrateScalar(BodyStore& store, uint32_t begin, uint32_t end, float deltaTime)
+    {
+        float* positionX = store[BodyStore::POSITION_X];
+        float* positionY = store[BodyStore::POSITION_Y];
+        float* positionZ = store[BodyStore::POSITION_Z];
+        float* rotationW = store[BodyStore::ROTATION_W];
+        float* rotationX = store[BodyStore::ROTATION_X];
+        float* rotationY = store[BodyStore::ROTATION_Y];
+        float* rotationZ = store[BodyStore::ROTATION_Z];
+        float* linearY = store[BodyStore::LINEAR_MOMENTUM_Y];
+        const float* linearX = store[BodyStore::LINEAR_MOMENTUM_X];
+        const float* linearZ = store[BodyStore::LINEAR_MOMENTUM_Z];
+        const float* angularX = store[BodyStore::ANGULAR_MOMENTUM_X];
+        const float* angularY = store[BodyStore::ANGULAR_MOMENTUM_Y];
+        const float* angularZ = store[BodyStore::ANGULAR_MOMENTUM_Z];
+        const float* inverseMass = store[BodyStore::INVERSE_MASS];
+        const float* gravity = store[BodyStore::GRAVITY];
+        const float* inertiaXX = store[BodyStore::INVERSE_INERTIA_XX];
+        const float* inertiaXY = store[BodyStore::INVERSE_INERTIA_XY];
+        const float* inertiaXZ = store[BodyStore::INVERSE_INERTIA_XZ];
+        const float* inertiaYY = store[BodyStore::INVERSE_INERTIA_YY];
+        const float* inertiaYZ = store[BodyStore::INVERSE_INERTIA_YZ];
+        const float* inertiaZZ = store[BodyStore::INVERSE_INERTIA_ZZ];
+        const float halfDeltaTime = 0.5f * deltaTime;
+
+        for(uint32_t i = begin; i < end; i++) {
+            const float scale = inverseMass[i] * deltaTime;
+            positionX[i] += linearX[i] * scale;
+            positionY[i] += linearY[i] * scale;
+            positionZ[i] += linearZ[i] * scale;
+
+            //The rotation matrix as glm::mat3_cast builds it, one column at a time.
+            const float w = rotationW[i], x = rotationX[i], y = rotationY[i], z = rotationZ[i];
+            const float xx = x * x, yy = y * y, zz = z * z;
+            const float xy = x * y, xz = x * z, yz = y * z;
+            const float wx = w * x, wy = w * y, wz = w * z;
+            const float m00 = 1.0f - 2.0f * (yy + zz), m01 = 2.0f * (xy + wz), m02 = 2.0f * (xz - wy);
+            const float m10 = 2.0f * (xy - wz), m11 = 1.0f - 2.0f * (xx + zz), m12 = 2.0f * (yz + wx);
+            const float m20 = 2.0f * (xz + wy), m21 = 2.0f * (yz - wx), m22 = 1.0f - 2.0f * (xx + yy);
+
+            //The angular velocity is the momentum taken into body space, through the inverse inertia and back out.
+            const float localX = m00 * angularX[i] + m01 * angularY[i] + m02 * angularZ[i];
+            const float localY = m10 * angularX[i] + m11 * angularY[i] + m12 * angularZ[i];
+            const float localZ = m20 * angularX[i] + m21 * angularY[i] + m22 * angularZ[i];
+            const float bodyX = inertiaXX[i] * localX + inertiaXY[i] * localY + inertiaXZ[i] * localZ;
+            const float bodyY = inertiaXY[i] * localX + inertiaYY[i] * localY + inertiaYZ[i] * localZ;
+            const float bodyZ = inertiaXZ[i] * localX + inertiaYZ[i] * localY + inertiaZZ[i] * localZ;
+            const float spinX = (m00 * bodyX + m10 * bodyY + m20 * bodyZ) * halfDeltaTime;
+            const float spinY = (m01 * bodyX + m11 * bodyY + m21 * bodyZ) * halfDeltaTime;
+            const float spinZ = (m02 * bodyX + m12 * bodyY + m22 * bodyZ) * halfDeltaTime;
+
+            //Adds half the angular velocity, as a pure quaternion, times the rotation.
+            rotationW[i] = w - (spinX * x + spinY * y + spinZ * z);
+            rotationX[i] = x + (spinX * w + spinY * z - spinZ * y);
+            rotationY[i] = y + (spinY * w + spinZ * x - spinX * z);
+            rotationZ[i] = z + (spinZ * w + spinX * y - spinY * x);
+
+            linearY[i] += gravity[i] * deltaTime;
+        }
+    }
+
+    TARGET_AVX void IntegrateAVX(BodyStore& store, uint32_t begin, uint32_t end, float deltaTime)
+    {
+        float* positionX = store[BodyStore::POSITION_X];
+        float* positionY = store[BodyStore::POSITION_Y];
+        float* positionZ = store[BodyStore::POSITION_Z];
+        float* rotationW = store[BodyStore::ROTATION_W];
+        float* rotationX = store[BodyStore::ROTATION_X];
+        float* rotationY = store[BodyStore::ROTATION_Y];
+        float* rotationZ = store[BodyStore::ROTATION_Z];
+        float* linearY = store[BodyStore::LINEAR_MOMENTUM_Y];
+        const float* linearX = store[BodyStore::LINEAR_MOMENTUM_X];
+        const float* linearZ = store[BodyStore::LINEAR_MOMENTUM_Z];
+        const float* angularX = store[BodyStore::ANGULAR_MOMENTUM_X];
+        const float* angularY = store[BodyStore::ANGULAR_MOMENTUM_Y];
+        const float* angularZ = store[BodyStore::ANGULAR_MOMENTUM_Z];
+        const float* inverseMass = store[BodyStore::INVERSE_MASS];
+        const float* gravity = store[BodyStore::GRAVITY];
+        const float* inertiaXX = store[BodyStore::INVERSE_INERTIA_XX];
+        const float* inertiaXY = store[BodyStore::INVERSE_INERTIA_XY];
+        const float* inertiaXZ = store[BodyStore::INVERSE_INERTIA_XZ];
+        const float* inertiaYY = store[BodyStore::INVERSE_INERTIA_YY];
+        const float* inertiaYZ = store[BodyStore::INVERSE_INERTIA_YZ];
+        const float* inertiaZZ = store[BodyStore::INVERSE_INERTIA_ZZ];
+        const __m256 step = _mm256_set1_ps(deltaTime);
+        const __m256 halfStep = _mm256_set1_ps(0.5f * deltaTime);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 two = _mm256_set1_ps(2.0f);
+
+        for(uint32_t i = begin; i < end; i += BodyStore::WIDTH) {
+            const __m256 scale = _mm256_mul_ps(_mm256_load_ps(inverseMass + i), step);
+            const __m256 momentumX = _mm256_load_ps(linearX + i);
+            const __m256 momentumY = _mm256_load_ps(linearY + i);
+            const __m256 momentumZ = _mm256_load_ps(linearZ + i);
+            _mm256_store_ps(positionX + i, _mm256_add_ps(_mm256_load_ps(positionX + i), _mm256_mul_ps(momentumX, scale)));
+            _mm256_store_ps(positionY + i, _mm256_add_ps(_mm256_load_ps(positionY + i), _mm256_mul_ps(momentumY, scale)));
+            _mm256_store_ps(positionZ + i, _mm256_add_ps(_mm256_load_ps(positionZ + i), _mm256_mul_ps(momentumZ, scale)));
+
+            const __m256 w = _mm256_load_ps(rotationW + i);
+            const __m256 x = _mm256_load_ps(rotationX + i);
+            const __m256 y = _mm256_load_ps(rotationY + i);
+            const __m256 z = _mm256_load_ps(rotationZ + i);
+            const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+            const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+            const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+            const __m256 m00 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz)));
+            const __m256 m01 = _mm256_mul_ps(two, _mm256_add_ps(xy, wz));
+            const __m256 m02 = _mm256_mul_ps(two, _mm256_sub_ps(xz, wy));
+            const __m256 m10 = _mm256_mul_ps(two, _mm256_sub_ps(xy, wz));
+            const __m256 m11 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz)));
+            const __m256 m12 = _mm256_mul_ps(two, _mm256_add_ps(yz, wx));
+            const __m256 m20 = _mm256_mul_ps(two, _mm256_add_ps(xz, wy));
+            const __m256 m21 = _mm256_mul_ps(two, _mm256_sub_ps(yz, wx));
+            const __m256 m22 = _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)));
+
+            const __m256 momentumAX = _mm256_load_ps(angularX + i);
+            const __m256 momentumAY = _mm256_load_ps(angularY + i);
+            const __m256 momentumAZ = _mm256_load_ps(angularZ + i);
+            const __m256 localX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, momentumAX), _mm256_mul_ps(m01, momentumAY)), _mm256_mul_ps(m02, momentumAZ));
+            const __m256 localY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, momentumAX), _mm256_mul_ps(m11, momentumAY)), _mm256_mul_ps(m12, momentumAZ));
+            const __m256 localZ = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m20, momentumAX), _mm256_mul_ps(m21, momentumAY)), _mm256_mul_ps(m22, momentumAZ));
+
+            const __m256 iXX = _mm256_load_ps(inertiaXX + i), iXY = _mm256_load_ps(inertiaXY + i), iXZ = _mm256_load_ps(inertiaXZ + i);
+            const __m256 iYY = _mm256_load_ps(inertiaYY + i), iYZ = _mm256_load_ps(inertiaYZ + i), iZZ = _mm256_load_ps(inertiaZZ + i);
+            const __m256 bodyX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(iXX, localX), _mm256_mul_ps(iXY, localY)), _mm256_mul_ps(iXZ, localZ));
+            const __m256 bodyY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(iXY, localX), _mm256_mul_ps(iYY, localY)), _mm256_mul_ps(iYZ, localZ));
+            const __m256 bodyZ = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(iXZ, localX), _mm256_mul_ps(iYZ, localY)), _mm256_mul_ps(iZZ, localZ));
+
+            const __m256 spinX = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, bodyX), _mm256_mul_ps(m10, bodyY)), _mm256_mul_ps(m20, bodyZ)), halfStep);
+            const __m256 spinY = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m01, bodyX), _mm256_mul_ps(m11, bodyY)), _mm256_mul_ps(m21, bodyZ)), halfStep);
+            const __m256 spinZ = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m02, bodyX), _mm256_mul_ps(m12, bodyY)), _mm256_mul_ps(m22, bodyZ)), halfStep);
+
+            _mm256_store_ps(rotationW + i, _mm256_sub_ps(w, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(spinX, x), _mm256_mul_ps(spinY, y)), _mm256_mul_ps(spinZ, z))));
+            _mm256_store_ps(rotationX + i, _mm256_add_ps(x, _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(spinX, w), _mm256_mul_ps(spinY, z)), _mm256_mul_ps(spinZ, y))));
+            _mm256_store_ps(rotationY + i, _mm256_add_ps(y, _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(spinY, w), _mm256_mul_ps(spinZ, x)), _mm256_mul_ps(spinX, z))));
+            _mm256_store_ps(rotationZ + i, _mm256_add_ps(z, _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(spinZ, w), _mm256_mul_ps(spinX, y)), _mm256_mul_ps(spinY, x))));
+
+            _mm256_store_ps(linearY + i, _mm256_add_ps(momentumY, _mm256_mul_ps(_mm256_load_ps(gravity + i), step)));
+        }
+    }
+
+    IntegrateFunction GetIntegrateFunction(OverlapKernels::InstructionSet set)
+    {
+        if((std::min)(set, OverlapKernels::GetInstructionSet()) >= OverlapKernels::AVX) {
+            return &IntegrateAVX;
+        }
+        return &IntegrateScalar;
+    }
+
+    IntegrateFunction GetIntegrateFunction()
+    {
+        return GetIntegrateFunction(OverlapKernels::GetInstructionSet());
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#ifdef BUILDING_DLL
+#define ATOM_API __declspec(dllexport)
+#else
+#define ATOM_API __declspec(dllimport)
+#endif
+
+#include "BodyStore.h"
+#include "OverlapKernels.h"
+
+namespace IntegrationKernels {
+
+    /*!
+     * \brief Integrates a range of bodies in the store over one step.
+     * \param store The bodies being integrated.
+     * \param begin The first body of the range, must be a multiple of BodyStore::WIDTH.
+     * \param end One past the last body of the range, must be a multiple of BodyStore::WIDTH.
+     * \param deltaTime The length of the step, in seconds.
+     *
+     * Each body is moved by its momentum, then has gravity added to its momentum, so the contact solver sees
+     * gravity before the next step integrates it. Every kernel works through the same operations in the same
+     * order, so they all give the same results.
+     */
+    typedef void(*IntegrateFunction)(BodyStore& store, uint32_t begin, uint32_t end, float deltaTime);
+
+    ATOM_API void IntegrateScalar(BodyStore& store, uint32_t begin, uint32_t end, float deltaTime);
+    ATOM_API void IntegrateAVX(BodyStore& store, uint32_t begin, uint32_t end, float deltaTime);
+
+    /*!
+     * \brief Gets the kernel for an instruction set.
+     * \param set The instruction set, if it is not supported the widest one that is will be used.
+     *
+     * The widest kernel only needs AVX, there is no SSE kernel so CPUs without AVX use the scalar one.
+     */
+    ATOM_API IntegrateFunction GetIntegrateFunction(OverlapKernels::InstructionSet set);
+
+    /*!
+     * \brief Gets the fastest kernel supported by this CPU.
+     */
+    ATOM_API IntegrateFunction GetIntegrateFunction();
+}
@@ -0,0 +1,218 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "ECS_System.h"
+#include "TransformComponent.h"
+#include "RigidBodyComponent.h"
+#include "AABBComponent.h"
+#include "CollisionDetectionSystem.h"
+#include "LogManager.h"
+#include "ProfilerManager.h"
+
+/*!
+ * \class IslandSystem "IslandSystem.h"
+ * \brief Groups touching rigid bodies into islands, and puts islands that have come to rest to sleep.
+ *
+ * Must run after the ContactSolverSystem, so the velocities it checks are the solved ones. Islands are found
+ * with a union-find over the pairs the narrow phase last found touching, joining any two bodies that are not
+ * static. Static bodies are left out, or everything resting on the same ground would be one island.
+ * Each body keeps how long it has stayed under both velocity thresholds. Once every body of an island has been
+ * still for the time to sleep, the whole island sleeps: its momentum is cleared, and it is not integrated,
+ * recalculated or refit until it wakes. An island wakes as soon as any of its bodies is awake and moving, so a
+ * body that lands on a sleeping pile, or has a force applied to it, wakes everything it touches. Colliders
+ * without a rigid body are moved by hand, so bodies touching one never sleep.
+ */
+class IslandSystem : public BaseECSSystem
+{
+public:
+    /*!
+     * \brief Constructor
+     * \param collisionDetection The system whose pairs the islands are built from.
+     */
+    IslandSystem(CollisionDetectionSystem& collisionDetection) : BaseECSSystem(),
+        m_collisionDetection(collisionDetection)
+    {
+        AddComponentType(TransformComponent::ID);
+        AddComponentType(RigidBodyComponent::ID);
+        AddComponentType(AABBComponent::ID);
+    }
+
+    virtual void UpdateComponents(float deltaTime, std::vector<std::vector<BaseECSComponent*>>& componentArrays) override
+    {
+        Profiler::Instance()->Start("Build Islands");
+        const uint32_t count = static_cast<uint32_t>(componentArrays[0].size());
+        m_bodyLookup.clear();
+        m_parents.resize(count);
+        m_touchingMover.assign(count, 0);
+        for(uint32_t i = 0; i < count; i++) {
+            m_bodyLookup.emplace_back(&((AABBComponent*)componentArrays[2][i])->m_aabb, i);
+            m_parents[i] = i;
+        }
+        std::sort(m_bodyLookup.begin(), m_bodyLookup.end());
+
+        for(const PairEntry& pair : m_collisionDetection.GetPairManager().GetPairs()) {
+            if(!pair.m_touching || pair.m_first->IsStatic() || pair.m_second->IsStatic()) {
+                continue;
+            }
+            const uint32_t first = FindBody(pair.m_first);
+            const uint32_t second = FindBody(pair.m_second);
+            if(first != NO_BODY && second != NO_BODY) {
+                Union(first, second);
+            }
+            //Colliders without a rigid body are moved by hand, so whatever they touch has to stay awake.
+            else if(first != NO_BODY || second != NO_BODY) {
+                m_touchingMover[first != NO_BODY ? first : second] = 1;
+            }
+        }
+
+        m_islandSleepTimes.assign(count, m_timeToSleep);
+        for(uint32_t i = 0; i < count; i++) {
+            POD_RigidBody& body = ((RigidBodyComponent*)componentArrays[1][i])->m_rigidBody;
+            if(((AABBComponent*)componentArrays[2][i])->m_aabb.IsStatic()) {
+                continue;
+            }
+            if(m_touchingMover[i]) {
+                body.WakeUp();
+            }
+            else if(!body.m_sleeping) {
+                UpdateSleepTime(body, ((TransformComponent*)componentArrays[0][i])->m_transform, deltaTime);
+            }
+            const uint32_t root = Find(i);
+            m_islandSleepTimes[root] = (std::min)(m_islandSleepTimes[root], body.m_sleepTime);
+        }
+
+        m_islandCount = 0;
+        m_sleepingCount = 0;
+        for(uint32_t i = 0; i < count; i++) {
+            POD_RigidBody& body = ((RigidBodyComponent*)componentArrays[1][i])->m_rigidBody;
+            AABB& aabb = ((AABBComponent*)componentArrays[2][i])->m_aabb;
+            if(aabb.IsStatic()) {
+                continue;
+            }
+            const uint32_t root = Find(i);
+            if(root == i) {
+                m_islandCount++;
+            }
+
+            if(m_islandSleepTimes[root] >= m_timeToSleep) {
+                body.m_sleeping = true;
+                body.m_linearMomentum = glm::vec3(0.0f);
+                body.m_angularMomentum = glm::vec3(0.0f);
+                m_sleepingCount++;
+            }
+            else if(body.m_sleeping) {
+                body.WakeUp();
+            }
+            aabb.SetSleeping(body.m_sleeping);
+        }
+        Profiler::Instance()->End("Build Islands");
+
+        //Logged with the collision stats, the counts can also be read through GetIslandCount and GetSleepingCount.
+        if(*m_collisionDetection.GetLogStats()) {
+            Logger::Instance()->LogInfo("Islands: " + std::to_string(m_islandCount));
+            Logger::Instance()->LogInfo("Sleeping Bodies: " + std::to_string(m_sleepingCount));
+        }
+    }
+
+    /*!
+     * \brief Sets how slowly a body must move to count as still.
+     * \param linear The highest linear speed, in world units per second.
+     * \param angular The highest angular speed, in radians per second.
+     */
+    void SetSleepThresholds(float linear, float angular) {
+        m_linearThreshold = linear;
+        m_angularThreshold = angular;
+    }
+
+    /*!
+     * \brief Sets how long every body of an island must stay still before it sleeps, in seconds.
+     */
+    void SetTimeToSleep(float timeToSleep) {
+        m_timeToSleep = timeToSleep;
+    }
+
+    float GetTimeToSleep() const {
+        return m_timeToSleep;
+    }
+
+    /*!
+     * \brief Gets the number of islands found this frame, counting each body touching nothing as its own.
+     */
+    uint32_t GetIslandCount() const {
+        return m_islandCount;
+    }
+
+    /*!
+     * \brief Gets the number of bodies asleep after this frame.
+     */
+    uint32_t GetSleepingCount() const {
+        return m_sleepingCount;
+    }
+
+private:
+    static constexpr uint32_t NO_BODY = UINT32_MAX;         /*!< Returned for AABB's without a rigid body.*/
+    static constexpr float DEFAULT_LINEAR_THRESHOLD = 0.05f;    /*!< Linear speed below which a body is still, in world units per second.*/
+    static constexpr float DEFAULT_ANGULAR_THRESHOLD = 0.05f;   /*!< Angular speed below which a body is still, in radians per second.*/
+    static constexpr float DEFAULT_TIME_TO_SLEEP = 0.5f;        /*!< Seconds an island must be still for before it sleeps.*/
+
+    CollisionDetectionSystem& m_collisionDetection;
+    float m_linearThreshold = DEFAULT_LINEAR_THRESHOLD;
+    float m_angularThreshold = DEFAULT_ANGULAR_THRESHOLD;
+    float m_timeToSleep = DEFAULT_TIME_TO_SLEEP;
+    uint32_t m_islandCount = 0;
+    uint32_t m_sleepingCount = 0;
+
+    std::vector<std::pair<const AABB*, uint32_t>> m_bodyLookup;   /*!< Each AABB with its body, sorted by address.*/
+    std::vector<uint32_t> m_parents;                            /*!< The union-find forest, each body's parent.*/
+    std::vector<float> m_islandSleepTimes;                      /*!< Each island's shortest time still, at its root.*/
+    std::vector<uint8_t> m_touchingMover;                       /*!< Whether each body touches a collider without a rigid body.*/
+
+    /*!
+     * \brief Finds the body of an AABB, NO_BODY if it has no rigid body.
+     */
+    uint32_t FindBody(const AABB* aabb) const
+    {
+        const auto found = std::lower_bound(m_bodyLookup.begin(), m_bodyLookup.end(), std::make_pair(aabb, 0u));
+        return found != m_bodyLookup.end() && found->first == aabb ? found->second : NO_BODY;
+    }
+
+    /*!
+     * \brief Finds the root of a body's island, halving the path on the way up.
+     */
+    uint32_t Find(uint32_t body)
+    {
+        while(m_parents[body] != body) {
+            m_parents[body] = m_parents[m_parents[body]];
+            body = m_parents[body];
+        }
+        return body;
+    }
+
+    /*!
+     * \brief Joins the islands of two bodies, the lower root always becomes the parent so islands come out the same every run.
+     */
+    void Union(uint32_t a, uint32_t b)
+    {
+        a = Find(a);
+        b = Find(b);
+        if(a != b) {
+            m_parents[(std::max)(a, b)] = (std::min)(a, b);
+        }
+    }
+
+    /*!
+     * \brief Adds the step to how long an awake body has been still, or restarts it if the body is moving.
+     */
+    void UpdateSleepTime(POD_RigidBody& body, POD_Transform& transform, float deltaTime) const
+    {
+        const glm::mat3 rotation = glm::mat3_cast(glm::normalize(transform.GetRotation()));
+        const glm::vec3 angularVelocity = rotation * body.m_inverseInertiaTensorIntegral * glm::transpose(rotation) * body.m_angularMomentum;
+        const glm::vec3 linearVelocity = body.GetLinearVelocity();
+        const bool still = glm::dot(linearVelocity, linearVelocity) <= m_linearThreshold * m_linearThreshold &&
+            glm::dot(angularVelocity, angularVelocity) <= m_angularThreshold * m_angularThreshold;
+        body.m_sleepTime = still ? body.m_sleepTime + deltaTime : 0.0f;
+    }
+};
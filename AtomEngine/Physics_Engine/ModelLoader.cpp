@@ -21,6 +21,7 @@ bool ModelLoader::LoadModel(const std::string& fileName)
     mesh.m_meshName = fileName;
     ProcessNode(scene->mRootNode, scene, &mesh);
     CalculateMeshBounds(&mesh);
+    mesh.BuildConvexHull();
 
     auto resource = std::make_shared<POD_Mesh>(mesh);
 
@@ -40,6 +41,7 @@ bool ModelLoader::LoadModel(const std::string& fileName, POD_Mesh* mesh)
     mesh->m_meshName = fileName;
     ProcessNode(scene->mRootNode, scene, mesh);
     CalculateMeshBounds(mesh);
+    mesh->BuildConvexHull();
 
     auto resource = std::make_shared<POD_Mesh>(*mesh);
 
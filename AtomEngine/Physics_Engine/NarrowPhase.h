@@ -1,12 +1,105 @@
 #pragma once
+#include <memory>
+#include <vector>
+#include <algorithm>
 #include "AABB.h"
-#include "ProfilerManager.h"
+#include "PairManager.h"
+#include "Simplex.h"
+#include "EPA.h"
+#include "ContactManifold.h"
+#include "ContactGeneration.h"
+#include "ThreadPool.h"
+
+/*!
+ * \struct NarrowPhaseStats "NarrowPhase.h"
+ * \brief Counters kept by the narrow phase over one frame.
+ *
+ * Plain integers updated as each pair is tested, so they cost nothing to keep and can be read once the frame is done.
+ */
+struct NarrowPhaseStats
+{
+    uint32_t m_pairsTested = 0;         /*!< Pairs given to the narrow phase.*/
+    uint32_t m_collisionsFound = 0;     /*!< Pairs found to be touching.*/
+    uint32_t m_totalIterations = 0;     /*!< GJK iterations summed over every pair.*/
+    uint32_t m_maxIterations = 0;       /*!< The most GJK iterations any one pair took.*/
+    uint32_t m_earlyOuts = 0;           /*!< Pairs shown to be apart by their first support point.*/
+    uint32_t m_iterationLimits = 0;     /*!< Pairs that ran out of iterations and were treated as apart.*/
+    uint32_t m_contactPoints = 0;       /*!< Contact points written to the contact buffer.*/
+    uint32_t m_analyticPairs = 0;       /*!< Pairs tested in closed form rather than with GJK.*/
+    uint32_t m_warmStartHits = 0;       /*!< Pairs shown to be apart by the axis cached from the last frame.*/
+
+    /*!
+     * \brief Resets every counter for a new frame.
+     */
+    void Reset() {
+        *this = NarrowPhaseStats();
+    }
+
+    /*!
+     * \brief Records the result of testing one pair.
+     * \param iterations The GJK iterations the pair took.
+     * \param colliding Whether the pair was touching.
+     */
+    void AddPair(uint32_t iterations, bool colliding) {
+        m_pairsTested++;
+        m_collisionsFound += colliding ? 1 : 0;
+        m_totalIterations += iterations;
+        m_maxIterations = (std::max)(m_maxIterations, iterations);
+    }
+
+    /*!
+     * \brief Records the result of testing one pair in closed form.
+     * \param colliding Whether the pair was touching.
+     */
+    void AddAnalyticPair(bool colliding) {
+        m_pairsTested++;
+        m_analyticPairs++;
+        m_collisionsFound += colliding ? 1 : 0;
+    }
+
+    /*!
+     * \brief Adds the counters from another set, such as one worker's.
+     */
+    void Merge(const NarrowPhaseStats& other) {
+        m_pairsTested += other.m_pairsTested;
+        m_collisionsFound += other.m_collisionsFound;
+        m_totalIterations += other.m_totalIterations;
+        m_maxIterations = (std::max)(m_maxIterations, other.m_maxIterations);
+        m_earlyOuts += other.m_earlyOuts;
+        m_iterationLimits += other.m_iterationLimits;
+        m_contactPoints += other.m_contactPoints;
+        m_analyticPairs += other.m_analyticPairs;
+        m_warmStartHits += other.m_warmStartHits;
+    }
+
+    /*!
+     * \brief Gets the average GJK iterations per pair tested with GJK.
+     */
+    float GetMeanIterations() const {
+        const uint32_t gjkPairs = m_pairsTested - m_analyticPairs;
+        return gjkPairs > 0 ? static_cast<float>(m_totalIterations) / gjkPairs : 0.0f;
+    }
+};
+
+/*!
+ * \struct NarrowPhaseWorker "NarrowPhase.h"
+ * \brief Everything one narrow phase job writes to, so jobs never share state.
+ */
+struct NarrowPhaseWorker
+{
+    EPA m_epa;                  /*!< The job's own EPA pools.*/
+    ContactBuffer m_contacts;   /*!< Manifolds found by the job, in pair order.*/
+    NarrowPhaseStats m_stats;   /*!< Counters for the job's pairs.*/
+};
 
 /*!
  * \class NarrowPhase "NarrowPhase.h"
  * \brief Base class for all Narrow Phase collision stages.
  * 
  * Sets up the base class for all Narrow Phase collisions, with the mandatory functions required.
+ * The pairs are split into contiguous ranges run as jobs on the job system, each with its own worker.
+ * The workers' manifolds are joined in job order afterwards, which is pair order, so the contacts come out
+ * the same whatever the number of threads.
  */
 class NarrowPhase
 
@@ -24,13 +117,94 @@ public:
 
     /*!
      * \brief Gets all the collision pairs
-     * \param potentials List of all potential collisions from the broadphase.
+     * \param pairs The pairs found by the broadphase this frame.
      * 
-     * Runs the narrow phase collision detection on the list of collision pairs provided by
-     * the broad phase.
+     * Runs the narrow phase collision detection on the pairs provided by the broad phase,
+     * storing the result of each test in its pair entry and the contacts in the contact buffer.
      */
-    virtual CollisionPairList GetCollisions(const CollisionPairList& potentials) = 0;
+    virtual void GetCollisions(PairManager& pairs)
+    {
+        std::vector<PairEntry>& entries = pairs.GetPairs();
+        const uint32_t count = static_cast<uint32_t>(entries.size());
 
+        //Transforms build their matrix when first asked, do that here so the jobs only read them.
+        for(const PairEntry& pair : entries) {
+            pair.m_first->GetTransform()->GetMatrix();
+            pair.m_second->GetTransform()->GetMatrix();
+        }
+
+        const uint32_t numJobs = GetParallelJobCount(count, PAIRS_PER_JOB);
+        while(m_workers.size() < numJobs) {
+            m_workers.push_back(std::make_unique<NarrowPhaseWorker>());
+        }
+
+        ParallelFor(count, numJobs, [this, &entries](uint32_t job, uint32_t begin, uint32_t end) {
+            NarrowPhaseWorker& worker = *m_workers[job];
+            worker.m_contacts.Clear();
+            worker.m_stats.Reset();
+            for(uint32_t i = begin; i < end; i++) {
+                PairEntry& pair = entries[i];
+                //Nothing in the pair has moved, so it keeps last frame's result and has no contact to solve.
+                if(!pair.m_first->IsMoving() && !pair.m_second->IsMoving()) {
+                    continue;
+                }
+                ContactManifold manifold;
+                pair.m_touching = Collide(*pair.m_first, *pair.m_second, pair.m_separatingAxis, manifold, worker);
+                if(pair.m_touching && manifold.m_pointCount > 0) {
+                    worker.m_stats.m_contactPoints += manifold.m_pointCount;
+                    worker.m_contacts.Add(manifold);
+                }
+            }
+        });
+
+        m_stats.Reset();
+        m_contacts.Clear();
+        for(uint32_t job = 0; job < numJobs; job++) {
+            m_stats.Merge(m_workers[job]->m_stats);
+            m_contacts.Append(m_workers[job]->m_contacts);
+        }
+
+        //An AABB can be in pairs handled by different jobs, so its flag is only set once they are done.
+        for(PairEntry& pair : entries) {
+            if(pair.m_touching) {
+                pair.m_first->IsColliding() = AABB::COLLIDING;
+                pair.m_second->IsColliding() = AABB::COLLIDING;
+            }
+        }
+    }
+
+    /*!
+     * \brief Tests one pair and builds its contact.
+     * \param box0 First Collider.
+     * \param box1 Second Collider.
+     * \param separatingAxis The axis the pair was last found apart along, kept in its pair entry from frame to frame.
+     *        Tests that can use it should update it, and set it to zero when no separating axis is found.
+     * \param manifold Receives the contact, left without points if none could be found.
+     * \param worker The calling job's worker, for any scratch memory and the counters.
+     * \return Returns true if the colliders are touching.
+     */
+    virtual bool Collide(AABB& box0, AABB& box1, glm::vec3& separatingAxis, ContactManifold& manifold, NarrowPhaseWorker& worker) = 0;
+
+    /*!
+     * \brief Gets the counters from the last call to GetCollisions.
+     */
+    const NarrowPhaseStats& GetStats() const {
+        return m_stats;
+    }
+
+    /*!
+     * \brief Gets the contact manifolds from the last call to GetCollisions, one for each touching pair.
+     */
+    ContactBuffer& GetContacts() {
+        return m_contacts;
+    }
+
+protected:
+    static constexpr uint32_t PAIRS_PER_JOB = 256;  /*!< The fewest pairs worth giving a job of their own.*/
+
+    NarrowPhaseStats m_stats;   /*!< Counters for the current frame.*/
+    ContactBuffer m_contacts;   /*!< Manifolds for the current frame.*/
+    std::vector<std::unique_ptr<NarrowPhaseWorker>> m_workers;   /*!< One worker per job, kept so their buffers are reused.*/
 };
 
 /*!
@@ -53,293 +227,253 @@ public:
     ~GJK(){}
 
     /*!
-     * \brief Gets all the collision pairs that are actually colliding.
-     * \param potentials List of all potential collisions from the broad phase.
+     * \brief Tests one pair and builds its contact.
+     * \param box0 First Collider.
+     * \param box1 Second Collider.
+     * \param separatingAxis The axis the pair was last found apart along, updated by the test.
+     * \param manifold Receives the contact, left without points if EPA could not find one.
+     * \param worker The calling job's worker.
+     * \return Returns true if the colliders are touching.
      * 
      * Creates a 4 point simplex (tetrahedron) and checks if it contains the origin.
-     * If it does then the 2 objects must be colliding.
+     * If it does then the 2 objects must be colliding, EPA then finds the normal and depth
+     * from that simplex and a manifold is built for the pair.
      */
-    CollisionPairList GetCollisions(const CollisionPairList& potentials) override
+    bool Collide(AABB& box0, AABB& box1, glm::vec3& separatingAxis, ContactManifold& manifold, NarrowPhaseWorker& worker) override
     {
-        CollisionPairList ammendedList;
-
-        for(auto& pair : potentials) {
-            if(EvolveSimplex(*pair.first, *pair.second)) {
-                pair.first->IsColliding() = AABB::COLLIDING;
-                pair.second->IsColliding() = AABB::COLLIDING;
-            }
+        Simplex simplex;
+        if(!EvolveSimplex(box0, box1, simplex, separatingAxis, worker.m_stats)) {
+            return false;
         }
 
-        return ammendedList;
+        glm::vec3 normal;
+        float depth;
+        if(worker.m_epa.Solve(box0, box1, simplex, normal, depth)) {
+            ContactGeneration::Generate(box0, box1, normal, depth, manifold);
+        }
+        return true;
     }
 
     /*!
      * \brief Creates a 4 point simplex (tetrahedron) over many iterations.
      * \param box0 First Collider.
      * \param box1 Second Collider.
+     * \param simplex Receives the final simplex, which encloses the origin if the colliders are touching.
+     * \param separatingAxis The axis the pair was last found apart along, or zero. Receives the axis found this time.
+     * \param stats The counters to record the test in.
      * 
      * Creates a simplex, and evaluates where the origin is in relation. If the tetrahedron contains the origin
      * then the two colliders must be touching.
+     * A pair that was apart last frame has usually only moved a little, so the axis that separated it then is
+     * tried first. If the first support point along it does not pass the origin the pair is still apart and
+     * nothing more is needed, otherwise the search carries on from that point.
      */
-    bool EvolveSimplex(const AABB& box0, const AABB& box1)
+    bool EvolveSimplex(const AABB& box0, const AABB& box1, Simplex& simplex, glm::vec3& separatingAxis, NarrowPhaseStats& stats) const
     {
-        //Starting Iterations
-        int iterationsDone = 0;
-        //Create the first support point from the MinkowskiDifference, in the direction of seperation.
-        auto support = MinkowskiDifferenceSupport(box0, box1, box0.m_transform->GetPosition() - box1.m_transform->GetPosition());
-        //List of all support points.
-        std::vector<glm::vec3> supports;
-        //Add the first support point to the list.
+        const bool warmStart = glm::dot(separatingAxis, separatingAxis) > DIRECTION_EPSILON;
+        //Without a cached axis, create the first support point in the direction of seperation.
+        glm::vec3 direction = warmStart ? separatingAxis : box0.m_transform->GetPosition() - box1.m_transform->GetPosition();
+        if(glm::dot(direction, direction) < DIRECTION_EPSILON) {
+            direction = glm::vec3(1.0f, 0.0f, 0.0f);
+        }
         //This is point A.
-        supports.push_back(support);
-        //Reverse the diretion vector.
-        m_direction = -support;
+        simplex.Set(MinkowskiDifferenceSupport(box0, box1, direction));
+        if(warmStart && glm::dot(simplex.m_points[0], direction) < 0.0f) {
+            stats.m_earlyOuts++;
+            stats.m_warmStartHits++;
+            stats.AddPair(1, false);
+            return false;
+        }
+        //Search back towards the origin.
+        direction = -simplex.m_points[0];
 
-        Profiler::Instance()->Start("GJK");
-        //Start the loop, only run until the max iterations.
-        while(iterationsDone < m_maxIterations) {
+        uint32_t iterations = 0;
+        bool colliding = false;
+        separatingAxis = glm::vec3(0.0f);
+        while(iterations < m_maxIterations) {
+            iterations++;
+            //A search direction of zero means the origin lies on the simplex, so the colliders are just touching.
+            //Degenerate simplices never get here, they are reduced to the line or point they collapse to first.
+            if(glm::dot(direction, direction) < DIRECTION_EPSILON) {
+                colliding = true;
+                break;
+            }
             //Get next support point in the new direction.
-            auto a = MinkowskiDifferenceSupport(box0, box1, m_direction);
-            //Check if this new support point is in the same direction as the origin. If not early out as
-            //cant be colliding.
-            if (glm::dot(a, m_direction) < 0) return false;
-            //Add the new support to the list. This is the new point A.
-            supports.push_back(a);
-            //Start Evaluating the Simplex.
-            if (EvaluateSimplex(supports, m_direction)) return true;
-            //Increase the iteration count.
-            iterationsDone++;
+            const glm::vec3 a = MinkowskiDifferenceSupport(box0, box1, direction);
+            //If the new support point does not pass the origin the colliders cant be colliding.
+            if(glm::dot(a, direction) < 0.0f) {
+                if(iterations == 1) {
+                    stats.m_earlyOuts++;
+                }
+                separatingAxis = glm::normalize(direction);
+                break;
+            }
+            //This is the new point A.
+            simplex.Push(a);
+            if(EvaluateSimplex(simplex, direction)) {
+                colliding = true;
+                break;
+            }
         }
-        Profiler::Instance()->End("GJK");
-        //If while loop has finished return if max iterations was hit or not.
-        return iterationsDone < m_maxIterations;
 
+        if(!colliding && iterations == m_maxIterations) {
+            stats.m_iterationLimits++;
+        }
+        stats.AddPair(iterations, colliding);
+        return colliding;
     }
 
     /*!
-     * \brief Evaluates the simplex and sorts the vertex order and direction to check.
-     * \param supports List of current simplex supports.
+     * \brief Reduces the simplex to the feature nearest the origin and sets the direction to search next.
+     * \param simplex The current simplex, newest point first.
      * \param direction The direction to check for the new support.
+     * \return Returns true if the simplex is a tetrahedron containing the origin.
      */
-    bool EvaluateSimplex(std::vector<glm::vec3>& supports, glm::vec3& direction)
+    static bool EvaluateSimplex(Simplex& simplex, glm::vec3& direction)
     {
-        //Switch on the number of current supports.
-        switch(supports.size())
+        switch(simplex.m_count)
         {
         case 2:
-            {
-                //Create a line from point A to point B.
-                auto lineAB = supports[0] - supports[1];
-                //Create a line from point A to origin.
-                auto lineAO = -supports[1];
-                //If line AB is in same direction as origin.
-                if (glm::dot(lineAB, lineAO) > 0) {
-                    //Set the new direction to the triple cross product.
-                    //This gives a direction that is perpendicular to AB and AO in the direction of AB.
-                    direction = glm::TripleProduct(lineAB, lineAO, lineAB);
-                }
-                //If not, set simplex to just point A and set direction to origin.
-                else {
-                    //Clear all old supports.
-                    supports.clear();
-                    //Set support to just point A.
-                    supports.push_back(-lineAO);
-                    direction = lineAO;
-                }
-                return false;
-            }
-            break;
+            return EvaluateLine(simplex, direction);
         case 3:
-            {
-                //Create line from point A to origin.
-                auto lineAO = -supports[2];
-                //Create line from point A to point B.
-                auto lineAB = supports[1] - supports[2];
-                //Create line from point A to point C.
-                auto lineAC = supports[0] - supports[2];
-                //Create line that is perpendicular to the triangle ABC.
-                auto lineABC = glm::cross(lineAB, lineAC);
-
-                //Check if origin is on outside of edge AC.
-                if(glm::dot(glm::cross(lineABC, lineAC), lineAO) > 0) {
-                    //Check if origin is in same direction as line AC.
-                    if(glm::dot(lineAC, lineAO) > 0) {
-                        //Set the supports to be just A and C.
-                        std::vector<glm::vec3> newSupports;
-                        newSupports.push_back(supports[0]); //Point C
-                        newSupports.push_back(supports[2]); //Point A
-                        supports = newSupports;
-
-                        //Set direction to be perpendicular to AC and AO but in the direction of AC.
-                        direction = glm::TripleProduct(lineAC, lineAO, lineAC);
-                        return false;
-                    }
-                    else {
-                        //Check if AB is in the direction of origin.
-                        if (glm::dot(lineAB, lineAO) > 0) {
-                            //Set the new points to be just A and B
-                            std::vector<glm::vec3> newSupports;
-                            newSupports.push_back(supports[1]); //Point B
-                            newSupports.push_back(supports[2]); //Point A
-                            supports = newSupports;
-
-                            //Set direction to be perpendicular to line AB and AB but in direction of AB.
-                            direction = glm::TripleProduct(lineAB, lineAO, lineAB);
-                            return false;
-                        }
-                        else {
-                            //Closest point to origin is just point A
-                            auto pointA = -lineAO;
-                            //Set the only support to A
-                            supports.clear();
-                            supports.push_back(pointA);
-                            //Set the search direction to be towards the origin.
-                            direction = lineAO;
-                            return false;
-                        }
-                    }
-                }
-                else {
-                    //Check if origin is outside edge AB
-                    if(glm::dot(glm::cross(lineAB, lineABC), lineAO) > 0) {
-                        //Check if line AB is in the direction of origin.
-                        if (glm::dot(lineAB, lineAO) > 0) {
-                            //Set the support points to be A and B.
-                            std::vector<glm::vec3> newSupports;
-                            newSupports.push_back(supports[1]); //Point B.
-                            newSupports.push_back(supports[2]); //Point A.
-                            supports = newSupports;
-
-                            //Set direction to be perpendicular to AB and AO in the direction of AB.
-                            direction = glm::TripleProduct(lineAB, lineAO, lineAB);
-                            return false;
-                        }
-                        else {
-                            //Closest point to origin is A
-                            auto pointA = -lineAO;
-                            //Set the only support point to A.
-                            supports.clear();
-                            supports.push_back(pointA);
-                            //Set the search direction to be towards the origin.
-                            direction = lineAO;
-                            return false;
-                        }
-                    }
-                    else {
-                        //Check if the origin is above the triangle ABC or not.
-                        if(glm::dot(lineABC, lineAO) > 0) {
-                            //Set search direction to be above triangle.
-                            direction = lineABC;
-
-                            return false;
-                        }
-                        else {
-                            //If below the triangle change the winding order of the vertices.
-                            //To be BCA.
-                            std::vector<glm::vec3> newSupports;
-                            newSupports.push_back(supports[1]); //Point B.
-                            newSupports.push_back(supports[0]); //Point C.
-                            newSupports.push_back(supports[2]); //Point A.
-                            supports = newSupports;
-                            //Set direction to be below the triangle.
-                            direction = -lineABC;
-                            return false;
-                        }
-                    }
-                }
-            }
-            return false;
-            break;
+            return EvaluateTriangle(simplex, direction);
         case 4:
-            {
-                //Create line towards origin.
-                auto lineAO = -supports[3];
-                //Create line from A to B.
-                auto lineAB = supports[2] - supports[3];
-                //Create line from A to C.
-                auto lineAC = supports[1] - supports[3];
-                //Create line from A to D.
-                auto lineAD = supports[0] - supports[3];
-
-                //Get line perpendicular to ABC triangle.
-                auto lineABC = glm::cross(lineAB, lineAC);
-                //Get line perpendicular to ADB triangle.
-                auto lineADB = glm::cross(lineAD, lineAB);
-                //Get line perpendicular to ACD triangle.
-                auto lineACD = glm::cross(lineAC, lineAD);
-
-                //Check if origin is outside ABC triangle.
-                if(glm::dot(lineABC, lineAO) > 0) {
-                    //Set supports to be just triangle ABC.
-                    std::vector<glm::vec3> newSupports;
-                    newSupports.push_back(supports[1]); //Point C
-                    newSupports.push_back(supports[2]); //Point B
-                    newSupports.push_back(supports[3]); //Point A
-                    supports = newSupports;
-
-                    //Set search direction to be above triangle.
-                    direction = lineABC;
-                    return false;
-                }
-                //Check if origin is outside ADB triangle.
-                else if (glm::dot(lineADB, lineAO) > 0) {
-                    //Set supports to be just triangle ADB.
-                    std::vector<glm::vec3> newSupports;
-                    newSupports.push_back(supports[0]); //Point D.
-                    newSupports.push_back(supports[2]); //Point B.
-                    newSupports.push_back(supports[3]); //Point A.
-                    supports = newSupports;
-
-                    //Set search direction to be above triangle.
-                    direction = lineADB;
-                    return false;
-                }
-                //Check if origin is outside ACD triangle.
-                else if (glm::dot(lineACD, lineAO) > 0) {
-                    //Set supports to be just triangle ACD.
-                    std::vector<glm::vec3> newSupports;
-                    newSupports.push_back(supports[0]); //Point D.
-                    newSupports.push_back(supports[1]); //Point C.
-                    newSupports.push_back(supports[3]); //Point A
-                    supports = newSupports;
-
-                    //Set search direction to be above triangle.
-                    direction = lineACD;
-                    return false;
-                }else {
-                    //If this stage is reached the Simplex encompasses the origin.
-                    return true;
-                }
-            }
-            break;
+            return EvaluateTetrahedron(simplex, direction);
         default:
             //This stage should never be reached. If it is just default to false.
             return false;
-            break;
         }
     }
 
+    void SetMaxIterations(uint32_t maxIterations) {
+        m_maxIterations = maxIterations;
+    }
 
 private:
-    int m_maxIterations = 100; /*! The maximum iterations GJK will make before it aborts.*/
-    glm::vec3 m_direction = glm::vec3(0.0f);    /*!< The Search direction for the simplex.*/
+    static constexpr float DIRECTION_EPSILON = 1e-12f;  /*!< Squared length below which a search direction is treated as zero.*/
+    static constexpr float DEGENERATE_EPSILON = 1e-10f; /*!< Squared sine of the angle below which a triangle's edges are treated as collinear.*/
+
+    uint32_t m_maxIterations = 100; /*!< The maximum iterations GJK will make before it aborts.*/
 
     /*!
-     * \brief Gets a support point from the Minkowski Difference.
-     * \param box0 The first collider as reference.
-     * \param box1 The second collider as reference.
-     * \param direction The search direction as reference.
-     * 
-     * Uses the Minkowski difference of both colliders and the supplied direction vector to get a support
-     * point for the Simplex.
+     * \brief Handles a line simplex AB.
+     */
+    static bool EvaluateLine(Simplex& simplex, glm::vec3& direction)
+    {
+        const glm::vec3 a = simplex.m_points[0];
+        const glm::vec3 b = simplex.m_points[1];
+        const glm::vec3 lineAB = b - a;
+        const glm::vec3 lineAO = -a;
+
+        const float lengthAB = glm::dot(lineAB, lineAB);
+        const float alongAB = glm::dot(lineAB, lineAO);
+
+        //If line AB is in same direction as origin search perpendicular to AB towards the origin.
+        //A repeated point has no direction, so it is treated like a line facing away.
+        if(lengthAB >= DIRECTION_EPSILON && alongAB > 0.0f) {
+            //Past B the closest point is B, which only happens once a collinear triangle is cut back to a line.
+            if(alongAB >= lengthAB) {
+                simplex.Set(b);
+                direction = -b;
+            }
+            else {
+                direction = glm::TripleProduct(lineAB, lineAO, lineAB);
+            }
+        }
+        //If not, closest point to origin is just point A.
+        else {
+            simplex.Set(a);
+            direction = lineAO;
+        }
+        return false;
+    }
+
+    /*!
+     * \brief Handles a triangle simplex ABC.
+     */
+    static bool EvaluateTriangle(Simplex& simplex, glm::vec3& direction)
+    {
+        const glm::vec3 a = simplex.m_points[0];
+        const glm::vec3 b = simplex.m_points[1];
+        const glm::vec3 c = simplex.m_points[2];
+        const glm::vec3 lineAB = b - a;
+        const glm::vec3 lineAC = c - a;
+        const glm::vec3 lineAO = -a;
+        //Create line that is perpendicular to the triangle ABC.
+        const glm::vec3 lineABC = glm::cross(lineAB, lineAC);
+
+        //Three points in a line have no normal, so drop the one between the other two and carry on with the line.
+        const float lengthAB = glm::dot(lineAB, lineAB);
+        const float lengthAC = glm::dot(lineAC, lineAC);
+        if(glm::dot(lineABC, lineABC) <= DEGENERATE_EPSILON * lengthAB * lengthAC) {
+            const glm::vec3 lineBC = c - b;
+            if(glm::dot(lineBC, lineBC) > (std::max)(lengthAB, lengthAC)) {
+                simplex.Set(b, c);
+            }
+            else if(lengthAB >= lengthAC) {
+                simplex.Set(a, b);
+            }
+            else {
+                simplex.Set(a, c);
+            }
+            return EvaluateLine(simplex, direction);
+        }
+
+        //Check if origin is on outside of edge AC.
+        if(glm::dot(glm::cross(lineABC, lineAC), lineAO) > 0.0f) {
+            if(glm::dot(lineAC, lineAO) > 0.0f) {
+                simplex.Set(a, c);
+                direction = glm::TripleProduct(lineAC, lineAO, lineAC);
+                return false;
+            }
+            simplex.Set(a, b);
+            return EvaluateLine(simplex, direction);
+        }
+        //Check if origin is outside edge AB.
+        if(glm::dot(glm::cross(lineAB, lineABC), lineAO) > 0.0f) {
+            simplex.Set(a, b);
+            return EvaluateLine(simplex, direction);
+        }
+        //Check if the origin is above the triangle ABC or not.
+        if(glm::dot(lineABC, lineAO) > 0.0f) {
+            direction = lineABC;
+        }
+        //If below the triangle change the winding order so the next point is always above it.
+        else {
+            simplex.Set(a, c, b);
+            direction = -lineABC;
+        }
+        return false;
+    }
+
+    /*!
+     * \brief Handles a tetrahedron simplex ABCD, where D is below triangle ABC.
      */
-    glm::vec3 MinkowskiDifferenceSupport(const AABB& box0, const AABB& box1, const glm::vec3& direction) {
-        //Get the first support from second collider.
-        auto supportA = box1.m_mesh->Support(*box1.m_transform, direction);
-        //Get the second support from first collider.
-        auto supportB = box0.m_mesh->Support(*box0.m_transform, -direction);
-        //Get the difference of the two supports.
-        return glm::vec3(supportA - supportB);
+    static bool EvaluateTetrahedron(Simplex& simplex, glm::vec3& direction)
+    {
+        const glm::vec3 a = simplex.m_points[0];
+        const glm::vec3 b = simplex.m_points[1];
+        const glm::vec3 c = simplex.m_points[2];
+        const glm::vec3 d = simplex.m_points[3];
+        const glm::vec3 lineAB = b - a;
+        const glm::vec3 lineAC = c - a;
+        const glm::vec3 lineAD = d - a;
+        const glm::vec3 lineAO = -a;
+
+        //Keep whichever face the origin is outside of, the origin is inside if it is outside none of them.
+        if(glm::dot(glm::cross(lineAB, lineAC), lineAO) > 0.0f) {
+            simplex.Set(a, b, c);
+            return EvaluateTriangle(simplex, direction);
+        }
+        if(glm::dot(glm::cross(lineAC, lineAD), lineAO) > 0.0f) {
+            simplex.Set(a, c, d);
+            return EvaluateTriangle(simplex, direction);
+        }
+        if(glm::dot(glm::cross(lineAD, lineAB), lineAO) > 0.0f) {
+            simplex.Set(a, d, b);
+            return EvaluateTriangle(simplex, direction);
+        }
+        return true;
     }
 
 };
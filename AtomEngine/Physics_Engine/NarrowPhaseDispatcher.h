@@ -0,0 +1,62 @@
+#pragma once
+#include "NarrowPhase.h"
+#include "ShapeCollision.h"
+
+/*!
+ * \class NarrowPhaseDispatcher "NarrowPhaseDispatcher.h"
+ * \brief Picks the test for each pair from the shapes of its two colliders.
+ *
+ * Box against box uses the separating axis test, and spheres against spheres or boxes are tested in closed form.
+ * Every other pair is a general convex mesh and goes through GJK and EPA.
+ */
+class NarrowPhaseDispatcher : public NarrowPhase
+{
+public:
+    /*!
+     * \brief Default Constructor
+     */
+    NarrowPhaseDispatcher(){}
+
+    /*!
+     * \brief Default Destructor.
+     */
+    ~NarrowPhaseDispatcher(){}
+
+    /*!
+     * \brief Tests one pair with the test for its shapes.
+     * \param box0 First Collider.
+     * \param box1 Second Collider.
+     * \param separatingAxis The axis the pair was last found apart along, only used by GJK.
+     * \param manifold Receives the contact.
+     * \param worker The calling job's worker.
+     * \return Returns true if the colliders are touching.
+     */
+    bool Collide(AABB& box0, AABB& box1, glm::vec3& separatingAxis, ContactManifold& manifold, NarrowPhaseWorker& worker) override
+    {
+        const ShapeType shape0 = box0.GetMesh()->GetShapeType();
+        const ShapeType shape1 = box1.GetMesh()->GetShapeType();
+
+        bool touching;
+        if(shape0 == SHAPE_BOX && shape1 == SHAPE_BOX) {
+            touching = ShapeCollision::BoxBox(box0, box1, manifold);
+        }
+        else if(shape0 == SHAPE_SPHERE && shape1 == SHAPE_SPHERE) {
+            touching = ShapeCollision::SphereSphere(box0, box1, manifold);
+        }
+        else if(shape0 == SHAPE_SPHERE && shape1 == SHAPE_BOX) {
+            touching = ShapeCollision::SphereBox(box0, box1, true, manifold);
+        }
+        else if(shape0 == SHAPE_BOX && shape1 == SHAPE_SPHERE) {
+            touching = ShapeCollision::SphereBox(box0, box1, false, manifold);
+        }
+        else {
+            return m_gjk.Collide(box0, box1, separatingAxis, manifold, worker);
+        }
+
+        worker.m_stats.AddAnalyticPair(touching);
+        return touching;
+    }
+
+private:
+    GJK m_gjk;  /*!< Tests pairs of general convex meshes.*/
+};
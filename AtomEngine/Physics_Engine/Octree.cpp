@@ -2,11 +2,340 @@
 
 
 
-Octree::Octree()
+Octree::Octree(DebugRenderer* debugRenderer, const glm::vec3& centre, float halfSize, float looseness, int maxDepth) :
+    BroadPhase(debugRenderer),
+    m_looseness(looseness),
+    m_maxDepth(maxDepth)
 {
+    m_debugRenderer = debugRenderer;
+
+    //Create the root node.
+    OctreeNode root;
+    root.m_centre = centre;
+    root.m_halfSize = halfSize;
+    root.m_parent = NULL_INDEX;
+    root.m_children = NULL_INDEX;
+    root.m_firstObject = NULL_INDEX;
+    root.m_subtreeCount = 0;
+    root.m_depth = 0;
+    m_nodes.push_back(root);
 }
 
 
 Octree::~Octree()
 {
 }
+
+void Octree::Add(AABB* aabb)
+{
+    AssignUniqueID(aabb);
+    uint32_t proxy;
+    //Reuse a released proxy if there is one.
+    if(!m_freeProxies.empty()) {
+        proxy = m_freeProxies.back();
+        m_freeProxies.pop_back();
+    }
+    else {
+        proxy = static_cast<uint32_t>(m_proxies.size());
+        m_proxies.emplace_back();
+    }
+
+    m_proxies[proxy].m_aabb = aabb;
+    aabb->m_proxyID = proxy;
+
+    Insert(proxy, ROOT);
+}
+
+void Octree::Remove(AABB* aabb)
+{
+    const uint32_t proxy = aabb->m_proxyID;
+
+    const uint32_t node = Unlink(proxy);
+    Collapse(node);
+
+    m_proxies[proxy].m_aabb = nullptr;
+    aabb->m_proxyID = AABB::NULL_PROXY;
+    m_freeProxies.push_back(proxy);
+}
+
+void Octree::Relocate(AABB* aabb)
+{
+    m_proxies[aabb->m_proxyID].m_aabb = aabb;
+}
+
+void Octree::Clear()
+{
+    for(OctreeProxy& proxy : m_proxies) {
+        if(proxy.m_aabb) {
+            proxy.m_aabb->m_proxyID = AABB::NULL_PROXY;
+        }
+    }
+    m_proxies.clear();
+    m_freeProxies.clear();
+
+    //Keep only the root.
+    m_nodes.resize(1);
+    m_nodes[ROOT].m_children = NULL_INDEX;
+    m_nodes[ROOT].m_firstObject = NULL_INDEX;
+    m_nodes[ROOT].m_subtreeCount = 0;
+    m_freeBlocks.clear();
+}
+
+void Octree::Update()
+{
+    for(uint32_t i = 0; i < m_proxies.size(); i++) {
+        OctreeProxy& proxy = m_proxies[i];
+        if(!proxy.m_aabb || proxy.m_aabb->IsSleeping()) {
+            continue;
+        }
+
+        //Objects that still fit are updated in place.
+        const uint32_t node = proxy.m_node;
+        if(node == ROOT || LooseContains(m_nodes[node], *proxy.m_aabb)) {
+            continue;
+        }
+
+        //Climb to the first ancestor that holds the object.
+        uint32_t start = m_nodes[node].m_parent;
+        while(start != ROOT && !LooseContains(m_nodes[start], *proxy.m_aabb)) {
+            start = m_nodes[start].m_parent;
+        }
+
+        //Move it before collapsing so the path it is moving into is not freed.
+        Unlink(i);
+        Insert(i, start);
+        Collapse(node);
+    }
+
+    if(m_showDebug) {
+        m_debugStack.clear();
+        m_debugStack.push_back(ROOT);
+        while(!m_debugStack.empty()) {
+            const OctreeNode& node = m_nodes[m_debugStack.back()];
+            m_debugStack.pop_back();
+
+            const glm::vec3 extents(node.m_halfSize * m_looseness * 2.0f);
+
+            glm::mat4 trans = glm::mat4(1.0f);
+            trans = glm::translate(trans, node.m_centre);
+            trans = glm::scale(trans, extents);
+            m_debugRenderer->AddToBuffer(&GetDebugCuboid(), GetDebugCuboid().GetColor(), trans);
+
+            if(node.m_children != NULL_INDEX) {
+                for(uint32_t c = 0; c < 8; c++) {
+                    if(m_nodes[node.m_children + c].m_subtreeCount > 0) {
+                        m_debugStack.push_back(node.m_children + c);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Octree::CalculatePairs(PairManager& pairs)
+{
+    m_checksMade = 0;
+
+    for(uint32_t i = 0; i < m_proxies.size(); i++) {
+        if(m_proxies[i].m_aabb) {
+            FindPairs(i, pairs);
+        }
+    }
+}
+
+void Octree::GatherAABBs(std::vector<AABB*>& aabbs)
+{
+    aabbs.clear();
+    for(const OctreeProxy& proxy : m_proxies) {
+        if(proxy.m_aabb) {
+            aabbs.push_back(proxy.m_aabb);
+        }
+    }
+}
+
+bool Octree::LooseContains(const OctreeNode& node, const AABB& aabb) const
+{
+    const glm::vec3 looseHalfSize(node.m_halfSize * m_looseness);
+    return aabb.m_minBounds >= node.m_centre - looseHalfSize && aabb.m_maxBounds <= node.m_centre + looseHalfSize;
+}
+
+bool Octree::LooseOverlaps(const OctreeNode& node, const AABB& aabb) const
+{
+    const glm::vec3 looseHalfSize(node.m_halfSize * m_looseness);
+    return aabb.m_maxBounds >= node.m_centre - looseHalfSize && aabb.m_minBounds <= node.m_centre + looseHalfSize;
+}
+
+void Octree::Insert(uint32_t proxy, uint32_t start)
+{
+    const AABB& aabb = *m_proxies[proxy].m_aabb;
+    const glm::vec3 centre = (aabb.m_minBounds + aabb.m_maxBounds) * 0.5f;
+    const glm::vec3 halfExtents = aabb.GetExtents() * 0.5f;
+    const float radius = (std::max)(halfExtents.x, (std::max)(halfExtents.y, halfExtents.z));
+
+    //Find the deepest level whose loose boxes can hold the object wherever its centre falls in a cell.
+    int targetDepth = 0;
+    float halfSize = m_nodes[ROOT].m_halfSize;
+    while(targetDepth < m_maxDepth && radius <= (m_looseness - 1.0f) * halfSize * 0.5f) {
+        halfSize *= 0.5f;
+        targetDepth++;
+    }
+
+    //Descend following the octant of the centre.
+    uint32_t node = start;
+    while(m_nodes[node].m_depth < targetDepth) {
+        const OctreeNode& n = m_nodes[node];
+        const uint32_t octant = (centre.x >= n.m_centre.x ? 1 : 0) | (centre.y >= n.m_centre.y ? 2 : 0) | (centre.z >= n.m_centre.z ? 4 : 0);
+
+        //Test the child's loose box before creating it.
+        OctreeNode child;
+        child.m_halfSize = n.m_halfSize * 0.5f;
+        child.m_centre = n.m_centre + glm::vec3(octant & 1 ? child.m_halfSize : -child.m_halfSize,
+                                                octant & 2 ? child.m_halfSize : -child.m_halfSize,
+                                                octant & 4 ? child.m_halfSize : -child.m_halfSize);
+        if(!LooseContains(child, aabb)) {
+            break;
+        }
+
+        if(n.m_children == NULL_INDEX) {
+            Split(node);
+        }
+        node = m_nodes[node].m_children + octant;
+    }
+
+    //Link the proxy at the front of the node's list.
+    OctreeProxy& p = m_proxies[proxy];
+    OctreeNode& target = m_nodes[node];
+    p.m_node = node;
+    p.m_prev = NULL_INDEX;
+    p.m_next = target.m_firstObject;
+    if(target.m_firstObject != NULL_INDEX) {
+        m_proxies[target.m_firstObject].m_prev = proxy;
+    }
+    target.m_firstObject = proxy;
+
+    for(uint32_t n = node; n != NULL_INDEX; n = m_nodes[n].m_parent) {
+        m_nodes[n].m_subtreeCount++;
+    }
+}
+
+uint32_t Octree::Unlink(uint32_t proxy)
+{
+    OctreeProxy& p = m_proxies[proxy];
+    const uint32_t node = p.m_node;
+
+    if(p.m_prev != NULL_INDEX) {
+        m_proxies[p.m_prev].m_next = p.m_next;
+    }
+    else {
+        m_nodes[node].m_firstObject = p.m_next;
+    }
+    if(p.m_next != NULL_INDEX) {
+        m_proxies[p.m_next].m_prev = p.m_prev;
+    }
+    p.m_node = NULL_INDEX;
+
+    for(uint32_t n = node; n != NULL_INDEX; n = m_nodes[n].m_parent) {
+        m_nodes[n].m_subtreeCount--;
+    }
+    return node;
+}
+
+void Octree::Collapse(uint32_t node)
+{
+    if(m_nodes[node].m_subtreeCount > 0) {
+        return;
+    }
+
+    //Find the highest empty node, everything below it can go back to the pool.
+    uint32_t highest = node;
+    while(highest != ROOT && m_nodes[m_nodes[highest].m_parent].m_subtreeCount == 0) {
+        highest = m_nodes[highest].m_parent;
+    }
+    FreeChildren(highest);
+}
+
+void Octree::FreeChildren(uint32_t node)
+{
+    const uint32_t block = m_nodes[node].m_children;
+    if(block == NULL_INDEX) {
+        return;
+    }
+    for(uint32_t c = 0; c < 8; c++) {
+        FreeChildren(block + c);
+    }
+    m_nodes[node].m_children = NULL_INDEX;
+    m_freeBlocks.push_back(block);
+}
+
+void Octree::Split(uint32_t node)
+{
+    uint32_t block;
+    if(!m_freeBlocks.empty()) {
+        block = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+    }
+    else {
+        block = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.resize(m_nodes.size() + 8);
+    }
+
+    const OctreeNode& parent = m_nodes[node];
+    const float halfSize = parent.m_halfSize * 0.5f;
+    for(uint32_t c = 0; c < 8; c++) {
+        OctreeNode& child = m_nodes[block + c];
+        child.m_centre = parent.m_centre + glm::vec3(c & 1 ? halfSize : -halfSize,
+                                                     c & 2 ? halfSize : -halfSize,
+                                                     c & 4 ? halfSize : -halfSize);
+        child.m_halfSize = halfSize;
+        child.m_parent = node;
+        child.m_children = NULL_INDEX;
+        child.m_firstObject = NULL_INDEX;
+        child.m_subtreeCount = 0;
+        child.m_depth = parent.m_depth + 1;
+    }
+    m_nodes[node].m_children = block;
+}
+
+void Octree::FindPairs(uint32_t proxy, PairManager& pairs)
+{
+    const AABB& aabb = *m_proxies[proxy].m_aabb;
+
+    m_searchStack.clear();
+    m_searchStack.push_back(ROOT);
+    while(!m_searchStack.empty()) {
+        const uint32_t node = m_searchStack.back();
+        m_searchStack.pop_back();
+
+        //Only the root can hold objects outside its loose box, so every other node can be culled by it.
+        if(node != ROOT && !LooseOverlaps(m_nodes[node], aabb)) {
+            continue;
+        }
+
+        //Each pair is tested once, from the proxy with the lower id.
+        for(uint32_t other = m_nodes[node].m_firstObject; other != NULL_INDEX; other = m_proxies[other].m_next) {
+            if(other > proxy) {
+                TestPair(proxy, other, pairs);
+            }
+        }
+
+        const uint32_t block = m_nodes[node].m_children;
+        if(block != NULL_INDEX) {
+            for(uint32_t c = 0; c < 8; c++) {
+                if(m_nodes[block + c].m_subtreeCount > 0) {
+                    m_searchStack.push_back(block + c);
+                }
+            }
+        }
+    }
+}
+
+void Octree::TestPair(uint32_t a, uint32_t b, PairManager& pairs)
+{
+    AABB* aabbA = m_proxies[a].m_aabb;
+    AABB* aabbB = m_proxies[b].m_aabb;
+
+    m_checksMade++;
+    if(aabbA->Collides(aabbB)) {
+        pairs.AddPair(aabbA, aabbB);
+    }
+}
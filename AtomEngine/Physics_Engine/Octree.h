@@ -1,11 +1,214 @@
 #pragma once
-class Octree
+#include "BroadPhase.h"
+#include <vector>
+#include <cstdint>
+#include "AABB.h"
+
+/*!
+ * \struct OctreeNode "Octree.h"
+ * \brief A single cell of the loose octree.
+ *
+ * Children are always allocated as a block of 8 consecutive nodes in the pool, so a node only needs
+ * the index of its first child. Child octants are numbered with x in bit 0, y in bit 1 and z in bit 2.
+ */
+struct OctreeNode
+{
+    glm::vec3 m_centre;         /*!< Centre of the cell.*/
+    float m_halfSize;           /*!< Half the width of the tight cell, the loose cell is this times the looseness.*/
+    uint32_t m_parent;          /*!< Index of the parent node.*/
+    uint32_t m_children;        /*!< Index of the first of 8 children, NULL_INDEX if the node has none.*/
+    uint32_t m_firstObject;     /*!< First proxy stored directly in this node.*/
+    uint32_t m_subtreeCount;    /*!< Number of proxies stored in this node and all nodes below it.*/
+    int32_t m_depth;            /*!< Depth of the node, the root is 0.*/
+};
+
+/*!
+ * \struct OctreeProxy "Octree.h"
+ * \brief Loose octree record of a single AABB.
+ *
+ * Proxies in the same node form an intrusive doubly linked list so they can be unlinked in constant time.
+ */
+struct OctreeProxy
+{
+    AABB* m_aabb;       /*!< The AABB this proxy tracks, nullptr once removed.*/
+    uint32_t m_node;    /*!< Index of the node holding this proxy.*/
+    uint32_t m_prev;    /*!< Previous proxy in the same node.*/
+    uint32_t m_next;    /*!< Next proxy in the same node.*/
+};
+
+/*!
+ * \class Octree "Octree.h"
+ * \brief Loose octree broadphase.
+ *
+ * Every cell of a loose octree holds objects in a box larger than the cell itself by the looseness factor,
+ * so an object can be stored at the depth its size suits instead of being pushed up the tree whenever it
+ * straddles a cell boundary. Huge static objects sit near the root and small dynamic ones sit deep in the tree,
+ * which keeps the tree useful when object sizes vary a lot.
+ * Each object is only tested against the objects in nodes whose loose boxes it overlaps.
+ * Nodes come from a pool in blocks of 8, and objects are only moved when they no longer fit their node.
+ */
+class Octree : public BroadPhase
 {
 public:
-    Octree();
-    ~Octree();
+    /*!
+     * \brief Constructor
+     * \param debugRenderer The renderer to draw debug cells with.
+     * \param centre The centre of the root cell.
+     * \param halfSize Half the width of the root cell.
+     * \param looseness How many times larger than its cell each node's loose box is, must be more than 1.
+     * \param maxDepth The deepest level nodes can be created at.
+     */
+    Octree(DebugRenderer* debugRenderer, const glm::vec3& centre = glm::vec3(0.0f), float halfSize = 512.0f, float looseness = 2.0f, int maxDepth = 8);
+
+    /*!
+     * \brief Default Destructor
+     */
+    virtual ~Octree();
+
+    /*!
+     * \brief Adds an AABB to the tree.
+     * \param aabb The AABB to add.
+     */
+    void Add(AABB* aabb) override;
+
+    /*!
+     * \brief Removes an AABB from the tree.
+     * \param aabb The AABB to remove.
+     */
+    void Remove(AABB* aabb) override;
+
+    /*!
+     * \brief Points the proxy of an AABB at its new address.
+     * \param aabb The AABB, which has moved in memory since it was added.
+     */
+    void Relocate(AABB* aabb) override;
+
+    /*!
+     * \brief Removes every AABB and every node apart from the root.
+     */
+    void Clear() override;
+
+    /*!
+     * \brief Updates the tree.
+     *
+     * Objects that still fit the loose box of their node stay where they are. Any that have left it climb
+     * to the first ancestor that holds them and are reinserted from there.
+     */
+    void Update() override;
+
+    /*!
+     * \brief Calculates The Collision Pairs.
+     * \param pairs The pair manager to report every overlapping pair to.
+     */
+    void CalculatePairs(PairManager& pairs) override;
+
+    /*!
+     * \brief Gets the number of checks made this frame.
+     * \return Returns the number of checks made this frame.
+     */
+    int GetChecksMade() override {
+        return m_checksMade;
+    }
+
+    /*!
+     * \brief Gets whether the debug rendering should show or not.
+     */
+    bool* GetShowDebug() override {
+        return &m_showDebug;
+    }
+
+    /*!
+     * \brief Sets how many times larger than its cell each node's loose box is.
+     * \param looseness The looseness factor, must be more than 1.
+     *
+     * Only affects objects inserted or moved after the change.
+     */
+    void SetLooseness(float looseness) {
+        m_looseness = looseness;
+    }
+
+    /*!
+     * \brief Sets the deepest level nodes can be created at.
+     * \param maxDepth The maximum depth.
+     *
+     * Only affects objects inserted or moved after the change.
+     */
+    void SetMaxDepth(int maxDepth) {
+        m_maxDepth = maxDepth;
+    }
+
+protected:
+    void GatherAABBs(std::vector<AABB*>& aabbs) override;
 
 private:
+    static constexpr uint32_t NULL_INDEX = 0xFFFFFFFF;
+    static constexpr uint32_t ROOT = 0;
+
+    float m_looseness;      /*!< How many times larger than its cell each node's loose box is.*/
+    int m_maxDepth;         /*!< The deepest level nodes can be created at.*/
+    int m_checksMade = 0;   /*!< A counter for how many actual checks were performed during this broadphase.*/
+    bool m_showDebug = false;
+
+    std::vector<OctreeNode> m_nodes;        /*!< Pool of nodes, the root is always the first.*/
+    std::vector<uint32_t> m_freeBlocks;     /*!< First index of each released block of 8 nodes.*/
+    std::vector<OctreeProxy> m_proxies;     /*!< All proxies, indexed by the AABB proxy id.*/
+    std::vector<uint32_t> m_freeProxies;    /*!< Released proxy ids ready for reuse.*/
+    std::vector<uint32_t> m_searchStack;    /*!< Traversal stack reused when searching for pairs.*/
+    std::vector<uint32_t> m_debugStack;     /*!< Traversal stack reused when drawing the tree.*/
+
+    /*!
+     * \brief Tests if an AABB lies inside a node's loose box.
+     */
+    bool LooseContains(const OctreeNode& node, const AABB& aabb) const;
+
+    /*!
+     * \brief Tests if an AABB overlaps a node's loose box.
+     */
+    bool LooseOverlaps(const OctreeNode& node, const AABB& aabb) const;
+
+    /*!
+     * \brief Inserts a proxy, descending from a node.
+     * \param proxy The proxy to insert.
+     * \param start The node to start from, the proxy must fit inside it unless it is the root.
+     *
+     * Descends towards the depth that suits the size of the AABB, following the octant of its centre for as
+     * long as the child's loose box still holds it. Children are created as needed.
+     */
+    void Insert(uint32_t proxy, uint32_t start);
+
+    /*!
+     * \brief Unlinks a proxy from its node.
+     * \param proxy The proxy to unlink.
+     * \return Returns the node the proxy was unlinked from.
+     */
+    uint32_t Unlink(uint32_t proxy);
+
+    /*!
+     * \brief Frees the children of the highest empty node above and including a node.
+     * \param node The node to start from.
+     */
+    void Collapse(uint32_t node);
+
+    /*!
+     * \brief Returns all nodes below a node to the pool.
+     */
+    void FreeChildren(uint32_t node);
+
+    /*!
+     * \brief Creates the 8 children of a node.
+     */
+    void Split(uint32_t node);
+
+    /*!
+     * \brief Finds every pair between a proxy and the proxies with a higher id.
+     * \param proxy The proxy to search with.
+     * \param pairs The pair manager to report pairs to.
+     */
+    void FindPairs(uint32_t proxy, PairManager& pairs);
 
+    /*!
+     * \brief Tests two proxies and reports them if they collide.
+     */
+    void TestPair(uint32_t a, uint32_t b, PairManager& pairs);
 };
 
@@ -0,0 +1,204 @@
+#include "OverlapKernels.h"
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#include <cpuid.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+    inline uint32_t CountTrailingZeros(uint32_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+    }
+
+    /*!
+     * \brief Writes the index of every set bit of a lane mask to the hits.
+     * \param mask One bit per lane, set where the boxes overlap.
+     * \param first The index of the box in the first lane.
+     */
+    inline uint32_t WriteHits(uint32_t mask, uint32_t first, uint32_t* hits)
+    {
+        uint32_t count = 0;
+        while(mask) {
+            hits[count++] = first + CountTrailingZeros(mask);
+            mask &= mask - 1;
+        }
+        return count;
+    }
+
+    /*!
+     * \brief Clears the lanes of a block that fall outside the range being tested.
+     */
+    inline uint32_t MaskRange(uint32_t mask, uint32_t block, uint32_t width, uint32_t begin, uint32_t end)
+    {
+        if(block < begin) {
+            mask &= ~((1u << (begin - block)) - 1);
+        }
+        if(block + width > end) {
+            mask &= (1u << (end - block)) - 1;
+        }
+        return mask;
+    }
+
+    void CPUID(int info[4], int function, int subFunction)
+    {
+#ifdef _MSC_VER
+        __cpuidex(info, function, subFunction);
+#else
+        unsigned int regs[4] = { 0, 0, 0, 0 };
+        __cpuid_count(function, subFunction, regs[0], regs[1], regs[2], regs[3]);
+        for(int i = 0; i < 4; i++) {
+            info[i] = static_cast<int>(regs[i]);
+        }
+#endif
+    }
+
+    /*!
+     * \brief Reads which register states the operating system saves on a context switch.
+     */
+    uint64_t ReadXCR0()
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        uint32_t low, high;
+        __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+        return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+    }
+
+    OverlapKernels::InstructionSet DetectInstructionSet()
+    {
+        int info[4];
+        CPUID(info, 0, 0);
+        const int maxFunction = info[0];
+
+        CPUID(info, 1, 0);
+        const bool sse2 = (info[3] & (1 << 26)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if(!sse2) {
+            return OverlapKernels::SCALAR;
+        }
+
+        //AVX registers can only be used if the OS saves them.
+        if(osxsave && avx && (ReadXCR0() & 0x6) == 0x6) {
+            if(maxFunction >= 7) {
+                CPUID(info, 7, 0);
+                if(info[1] & (1 << 5)) {
+                    return OverlapKernels::AVX2;
+                }
+            }
+            return OverlapKernels::AVX;
+        }
+        return OverlapKernels::SSE;
+    }
+}
+
+namespace OverlapKernels {
+
+    uint32_t OverlapScalar(const BoundsStore& store, uint32_t index, uint32_t begin, uint32_t end, uint32_t* hits)
+    {
+        const float minX = store.MinX()[index], minY = store.MinY()[index], minZ = store.MinZ()[index];
+        const float maxX = store.MaxX()[index], maxY = store.MaxY()[index], maxZ = store.MaxZ()[index];
+
+        uint32_t count = 0;
+        for(uint32_t i = begin; i < end; i++) {
+            if(store.MinX()[i] <= maxX && store.MaxX()[i] >= minX &&
+               store.MinY()[i] <= maxY && store.MaxY()[i] >= minY &&
+               store.MinZ()[i] <= maxZ && store.MaxZ()[i] >= minZ) {
+                hits[count++] = i;
+            }
+        }
+        return count;
+    }
+
+    uint32_t OverlapSSE(const BoundsStore& store, uint32_t index, uint32_t begin, uint32_t end, uint32_t* hits)
+    {
+        const __m128 minX = _mm_set1_ps(store.MinX()[index]);
+        const __m128 minY = _mm_set1_ps(store.MinY()[index]);
+        const __m128 minZ = _mm_set1_ps(store.MinZ()[index]);
+        const __m128 maxX = _mm_set1_ps(store.MaxX()[index]);
+        const __m128 maxY = _mm_set1_ps(store.MaxY()[index]);
+        const __m128 maxZ = _mm_set1_ps(store.MaxZ()[index]);
+
+        //Start on an aligned block, lanes before the range are masked off.
+        uint32_t count = 0;
+        for(uint32_t block = begin & ~3u; block < end; block += 4) {
+            __m128 overlap = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(store.MinX() + block), maxX),
+                                        _mm_cmpge_ps(_mm_load_ps(store.MaxX() + block), minX));
+            overlap = _mm_and_ps(overlap, _mm_cmple_ps(_mm_load_ps(store.MinY() + block), maxY));
+            overlap = _mm_and_ps(overlap, _mm_cmpge_ps(_mm_load_ps(store.MaxY() + block), minY));
+            overlap = _mm_and_ps(overlap, _mm_cmple_ps(_mm_load_ps(store.MinZ() + block), maxZ));
+            overlap = _mm_and_ps(overlap, _mm_cmpge_ps(_mm_load_ps(store.MaxZ() + block), minZ));
+
+            const uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(overlap));
+            if(mask) {
+                count += WriteHits(MaskRange(mask, block, 4, begin, end), block, hits + count);
+            }
+        }
+        return count;
+    }
+
+    TARGET_AVX2 uint32_t OverlapAVX2(const BoundsStore& store, uint32_t index, uint32_t begin, uint32_t end, uint32_t* hits)
+    {
+        const __m256 minX = _mm256_set1_ps(store.MinX()[index]);
+        const __m256 minY = _mm256_set1_ps(store.MinY()[index]);
+        const __m256 minZ = _mm256_set1_ps(store.MinZ()[index]);
+        const __m256 maxX = _mm256_set1_ps(store.MaxX()[index]);
+        const __m256 maxY = _mm256_set1_ps(store.MaxY()[index]);
+        const __m256 maxZ = _mm256_set1_ps(store.MaxZ()[index]);
+
+        uint32_t count = 0;
+        for(uint32_t block = begin & ~7u; block < end; block += 8) {
+            __m256 overlap = _mm256_and_ps(_mm256_cmp_ps(_mm256_load_ps(store.MinX() + block), maxX, _CMP_LE_OQ),
+                                           _mm256_cmp_ps(_mm256_load_ps(store.MaxX() + block), minX, _CMP_GE_OQ));
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_load_ps(store.MinY() + block), maxY, _CMP_LE_OQ));
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_load_ps(store.MaxY() + block), minY, _CMP_GE_OQ));
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_load_ps(store.MinZ() + block), maxZ, _CMP_LE_OQ));
+            overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_load_ps(store.MaxZ() + block), minZ, _CMP_GE_OQ));
+
+            const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(overlap));
+            if(mask) {
+                count += WriteHits(MaskRange(mask, block, 8, begin, end), block, hits + count);
+            }
+        }
+        return count;
+    }
+
+    InstructionSet GetInstructionSet()
+    {
+        static const InstructionSet set = DetectInstructionSet();
+        return set;
+    }
+
+    OverlapFunction GetOverlapFunction(InstructionSet set)
+    {
+        switch((std::min)(set, GetInstructionSet())) {
+            case AVX2:
+                return &OverlapAVX2;
+            case AVX:
+            case SSE:
+                return &OverlapSSE;
+            default:
+                return &OverlapScalar;
+        }
+    }
+
+    OverlapFunction GetOverlapFunction()
+    {
+        return GetOverlapFunction(GetInstructionSet());
+    }
+}
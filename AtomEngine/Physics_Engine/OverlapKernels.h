@@ -0,0 +1,56 @@
+#pragma once
+
+#ifdef BUILDING_DLL
+#define ATOM_API __declspec(dllexport)
+#else
+#define ATOM_API __declspec(dllimport)
+#endif
+
+#include "BoundsStore.h"
+
+namespace OverlapKernels {
+
+    /*!
+     * \enum InstructionSet
+     * The widest instruction set the kernels can use on this CPU.
+     */
+    enum InstructionSet {
+        SCALAR = 0,     /*!< One box at a time.*/
+        SSE,            /*!< Four boxes at a time.*/
+        AVX,            /*!< Eight values at a time, but only with floating point instructions, the boxes are tested with SSE.*/
+        AVX2            /*!< Eight boxes at a time.*/
+    };
+
+    /*!
+     * \brief Tests one box in the store against a range of boxes in the store.
+     * \param store The bounds being tested.
+     * \param index The box tested against the range.
+     * \param begin The first box of the range.
+     * \param end One past the last box of the range.
+     * \param hits Receives the index of every box in the range that overlaps, must hold at least end - begin entries.
+     * \return Returns the number of overlapping boxes written to hits.
+     */
+    typedef uint32_t(*OverlapFunction)(const BoundsStore& store, uint32_t index, uint32_t begin, uint32_t end, uint32_t* hits);
+
+    ATOM_API uint32_t OverlapScalar(const BoundsStore& store, uint32_t index, uint32_t begin, uint32_t end, uint32_t* hits);
+    ATOM_API uint32_t OverlapSSE(const BoundsStore& store, uint32_t index, uint32_t begin, uint32_t end, uint32_t* hits);
+    ATOM_API uint32_t OverlapAVX2(const BoundsStore& store, uint32_t index, uint32_t begin, uint32_t end, uint32_t* hits);
+
+    /*!
+     * \brief Finds the widest instruction set supported by the CPU and the operating system.
+     *
+     * CPUID is only read the first time this is called.
+     */
+    ATOM_API InstructionSet GetInstructionSet();
+
+    /*!
+     * \brief Gets the kernel for an instruction set.
+     * \param set The instruction set, if it is not supported the widest one that is will be used.
+     */
+    ATOM_API OverlapFunction GetOverlapFunction(InstructionSet set);
+
+    /*!
+     * \brief Gets the fastest kernel supported by this CPU.
+     */
+    ATOM_API OverlapFunction GetOverlapFunction();
+}
@@ -10,6 +10,8 @@ bool POD_Mesh::LoadMesh(const std::string& meshName)
         m_meshName = resource->m_meshName;
         m_minimumBounds = resource->m_minimumBounds;
         m_maximumBounds = resource->m_maximumBounds;
+        m_hull = resource->m_hull;
+        m_shapeType = resource->m_shapeType;
     }
     else if (ModelLoader::LoadModel(meshName)) {
         Logger::Instance()->LogInfo("Successfully Loaded: " + meshName);
@@ -19,6 +21,8 @@ bool POD_Mesh::LoadMesh(const std::string& meshName)
         m_meshName = resource->m_meshName;
         m_minimumBounds = resource->m_minimumBounds;
         m_maximumBounds = resource->m_maximumBounds;
+        m_hull = resource->m_hull;
+        m_shapeType = resource->m_shapeType;
     }
     else {
         return false;
@@ -58,3 +62,15 @@ bool POD_Mesh::LoadMesh(const std::string& meshName)
     }
     return true;
 }
+
+void POD_Mesh::BuildConvexHull()
+{
+    std::vector<glm::vec3> points;
+    for(auto sub : m_subMeshList) {
+        for(const auto& vertex : sub->m_vertices) {
+            points.push_back(vertex.m_position);
+        }
+    }
+    m_hull = std::make_shared<ConvexHull>(points);
+    ClassifyShape();
+}
@@ -7,9 +7,14 @@
 #endif
 
 #include <vector>
+#include <cmath>
+#include <memory>
+#include <limits>
+#include <algorithm>
 #include "Types.h"
 #include "Buffer.h"
 #include "POD_Transform.h"
+#include "ConvexHull.h"
 
 class POD_SubMesh
 {
@@ -58,6 +63,16 @@ protected:
     Buffer m_instanceBuffer;
 };
 
+/*!
+ * \enum ShapeType
+ * The shape a mesh's convex hull makes, so the narrow phase can use an exact test for simple shapes.
+ */
+enum ShapeType {
+    SHAPE_CONVEX = 0,   /*!< Any other convex hull, tested with GJK.*/
+    SHAPE_BOX,          /*!< The hull is the mesh's bounding box.*/
+    SHAPE_SPHERE        /*!< Every hull vertex lies on a sphere filling the mesh's bounds.*/
+};
+
 class ATOM_API POD_Mesh
 {
 public:
@@ -81,27 +96,107 @@ public:
         return m_subMeshList;
     }
 
-    inline glm::vec3 Support(POD_Transform& transform, glm::vec3 direction)
+    inline const ConvexHull* GetConvexHull() const {
+        return m_hull.get();
+    }
+
+    /*!
+     * \brief Gets the shape the mesh's hull was found to make when it was built.
+     */
+    inline ShapeType GetShapeType() const {
+        return m_shapeType;
+    }
+
+    /*!
+     * \brief Overrides the shape found when the hull was built.
+     * \param shapeType The shape, a box or sphere fills the mesh's bounds.
+     */
+    inline void SetShapeType(ShapeType shapeType) {
+        m_shapeType = shapeType;
+    }
+
+    /*!
+     * \brief Gets the centre of the mesh's bounds in local space.
+     */
+    inline glm::vec3 GetLocalCentre() const {
+        return (m_minimumBounds + m_maximumBounds) * 0.5f;
+    }
+
+    /*!
+     * \brief Gets half the size of the mesh's bounds in local space.
+     */
+    inline glm::vec3 GetLocalHalfExtents() const {
+        return (m_maximumBounds - m_minimumBounds) * 0.5f;
+    }
+
+    /*!
+     * \brief Builds the convex hull of every submesh's vertices.
+     *
+     * Called once when the mesh is loaded, copies of the mesh share the hull.
+     */
+    void BuildConvexHull();
+
+    /*!
+     * \brief Gets the point of the mesh furthest in a direction.
+     * \param transform The transform of the mesh.
+     * \param direction The direction in world space, does not need to be normalised.
+     *
+     * The direction is taken into the mesh's local space once, the hull is searched there and only the
+     * furthest vertex is transformed back, so nothing is allocated.
+     */
+    inline glm::vec3 Support(POD_Transform& transform, const glm::vec3& direction)
     {
-        std::vector<glm::vec3> verts;
-        for(auto mesh : m_subMeshList) {
-            for(auto vertex : mesh->m_vertices) {
-                auto vert = glm::mat3(transform.GetMatrix()) * vertex.m_position;
-                vert += transform.GetPosition();
-                verts.push_back(vert);
-            }
+        const glm::mat3 linear(transform.GetMatrix());
+        const glm::vec3 localDirection = glm::transpose(linear) * direction;
+
+        glm::vec3 furthestPoint(0.0f);
+        if(m_hull && !m_hull->IsEmpty()) {
+            furthestPoint = m_hull->GetSupport(localDirection);
         }
-        float furthestDistance = -std::numeric_limits<float>::infinity();
-        glm::vec3 furthestPoint(furthestDistance);
-        for(auto vert : verts) {
-            auto tmp = glm::dot(vert, direction);
-            if(tmp > furthestDistance) {
-                furthestDistance = tmp;
-                furthestPoint = vert;
+        else {
+            //Meshes without a hull scan every vertex.
+            float furthestDistance = -std::numeric_limits<float>::infinity();
+            for(auto mesh : m_subMeshList) {
+                for(const auto& vertex : mesh->m_vertices) {
+                    const float distance = glm::dot(vertex.m_position, localDirection);
+                    if(distance > furthestDistance) {
+                        furthestDistance = distance;
+                        furthestPoint = vertex.m_position;
+                    }
+                }
             }
         }
 
-        return furthestPoint;
+        return linear * furthestPoint + transform.GetPosition();
+    }
+
+    static constexpr uint32_t MAX_FEATURE_POINTS = 32;  /*!< The most points GetSupportFeature returns.*/
+
+    /*!
+     * \brief Gets the vertices of the mesh within a tolerance of the furthest in a direction.
+     * \param transform The transform of the mesh.
+     * \param direction The direction in world space, normalised so the tolerance is in world units.
+     * \param tolerance How far behind the furthest vertex a vertex may be and still be returned.
+     * \param points Receives the vertices in world space.
+     * \param maxPoints The most points to write.
+     * \return Returns the number of points written, one for a vertex, two for an edge and more for a face.
+     */
+    inline uint32_t GetSupportFeature(POD_Transform& transform, const glm::vec3& direction, float tolerance, glm::vec3* points, uint32_t maxPoints)
+    {
+        if(!m_hull || m_hull->IsEmpty()) {
+            points[0] = Support(transform, direction);
+            return 1;
+        }
+
+        const glm::mat3 linear(transform.GetMatrix());
+        const glm::vec3 position = transform.GetPosition();
+        //Dot products against the local direction are distances along the world direction, so the tolerance carries over.
+        uint32_t indices[MAX_FEATURE_POINTS];
+        const uint32_t count = m_hull->GetSupportFeature(glm::transpose(linear) * direction, tolerance, indices, (std::min)(maxPoints, MAX_FEATURE_POINTS));
+        for(uint32_t i = 0; i < count; i++) {
+            points[i] = linear * m_hull->GetVertex(indices[i]) + position;
+        }
+        return count;
     }
 
 protected:
@@ -110,5 +205,53 @@ protected:
 
     std::string m_meshName;
     std::vector<POD_SubMesh*> m_subMeshList;
+    std::shared_ptr<ConvexHull> m_hull;     /*!< The convex hull of every submesh, shared with the loaded resource.*/
+    ShapeType m_shapeType = SHAPE_CONVEX;   /*!< The shape the hull makes.*/
+
+    /*!
+     * \brief Finds if the hull is a box or a sphere filling the bounds.
+     *
+     * A box hull has only the eight corners of the bounds. A sphere hull has many vertices, all the same distance
+     * from the centre, and bounds the same size on every axis.
+     */
+    inline void ClassifyShape()
+    {
+        m_shapeType = SHAPE_CONVEX;
+        if(!m_hull || m_hull->IsEmpty()) {
+            return;
+        }
+
+        const glm::vec3 centre = GetLocalCentre();
+        const glm::vec3 halfExtents = GetLocalHalfExtents();
+        const float size = (std::max)((std::max)(halfExtents.x, halfExtents.y), halfExtents.z);
+        if(size <= 0.0f) {
+            return;
+        }
+
+        const uint32_t count = m_hull->GetVertexCount();
+        if(count == 8) {
+            bool corners = true;
+            for(uint32_t i = 0; i < count && corners; i++) {
+                const glm::vec3 offset = glm::abs(m_hull->GetVertex(i) - centre) - halfExtents;
+                corners = glm::all(glm::lessThanEqual(glm::abs(offset), glm::vec3(SHAPE_TOLERANCE * size)));
+            }
+            if(corners) {
+                m_shapeType = SHAPE_BOX;
+            }
+            return;
+        }
+
+        const float smallest = (std::min)((std::min)(halfExtents.x, halfExtents.y), halfExtents.z);
+        if(count >= 20 && size - smallest <= SHAPE_TOLERANCE * size) {
+            for(uint32_t i = 0; i < count; i++) {
+                if(std::abs(glm::length(m_hull->GetVertex(i) - centre) - size) > SHAPE_TOLERANCE * size) {
+                    return;
+                }
+            }
+            m_shapeType = SHAPE_SPHERE;
+        }
+    }
+
+    static constexpr float SHAPE_TOLERANCE = 0.01f;  /*!< How far, relative to its size, a hull can be from a box or sphere and still count as one.*/
 };
 
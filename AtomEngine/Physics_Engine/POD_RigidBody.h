@@ -6,10 +6,18 @@ class POD_RigidBody
 {
 public:
     friend class PhysicsMovementSystem;
+    friend class ContactSolverSystem;
+    friend class IslandSystem;
+    friend class BodyStore;
 
     POD_RigidBody(POD_Transform& transformIn) :
         m_mass(1.0f),
         m_gravity(false),
+        m_continuous(false),
+        m_friction(0.5f),
+        m_restitution(0.0f),
+        m_sleeping(false),
+        m_sleepTime(0.0f),
         m_linearMomentum(glm::vec3(0,0,0)),
         m_angularMomentum(glm::vec3(0,0,0)),
         m_transform(transformIn)
@@ -20,30 +28,52 @@ public:
     ~POD_RigidBody(){}
 
     inline void ApplyForce(glm::vec3 force) {
+        WakeUp();
         m_linearMomentum += force;
     }
 
     inline void ApplyForce(float x, float y, float z) {
+        WakeUp();
         m_linearMomentum += glm::vec3(x, y, z);
     }
 
     inline void ApplyForceAtPosition(glm::vec3 force, glm::vec3 position) {
+        WakeUp();
         m_linearMomentum += force;
         m_angularMomentum += glm::cross(position - m_transform.GetPosition(), force);
     }
 
     inline void ApplyTorque(glm::vec3 torque) {
+        WakeUp();
         m_angularMomentum += torque;
     }
 
     inline void ApplyTorque(float x, float y, float z) {
+        WakeUp();
         m_angularMomentum += glm::vec3(x, y, z);
     }
 
+    inline bool IsSleeping() const {
+        return m_sleeping;
+    }
+
+    /*
+     * Wakes the body, and restarts the time it has to stay still for before it can sleep again.
+     * The rest of its island is woken when islands are next built.
+     */
+    inline void WakeUp() {
+        m_sleeping = false;
+        m_sleepTime = 0.0f;
+    }
+
     inline float GetMass() {
         return m_mass;
     }
 
+    inline glm::vec3 GetLinearVelocity() const {
+        return m_linearMomentum / m_mass;
+    }
+
     inline void SetMass(float mass) {
         m_mass = mass;
         CalculateInertiaTensorIntegral();
@@ -57,6 +87,46 @@ public:
         m_gravity = true;
     }
 
+    inline bool IsContinuous() const {
+        return m_continuous;
+    }
+
+    /*
+     * Opts the body in to continuous collision detection, for small fast bodies that
+     * would otherwise pass through thin ones in a single step.
+     */
+    inline void SetContinuous(bool enable = true) {
+        m_continuous = enable;
+    }
+
+    inline float GetFriction() const {
+        return m_friction;
+    }
+
+    inline void SetFriction(float friction) {
+        m_friction = friction;
+    }
+
+    inline float GetRestitution() const {
+        return m_restitution;
+    }
+
+    /*
+     * How much of the speed the body hits something at it bounces back with,
+     * zero for no bounce and one for a perfect bounce.
+     */
+    inline void SetRestitution(float restitution) {
+        m_restitution = restitution;
+    }
+
+    inline const glm::vec3& GetSweepPosition() const {
+        return m_sweepPosition;
+    }
+
+    inline const glm::quat& GetSweepRotation() const {
+        return m_sweepRotation;
+    }
+
 protected:
 
     inline void CalculateInertiaTensorIntegral() {
@@ -83,6 +153,27 @@ protected:
 
     bool m_gravity;
 
+    /*
+     * Continuous bodies record the pose they started each step at,
+     * so collision detection can sweep them from there to where they ended.
+     */
+    bool m_continuous;
+    glm::vec3 m_sweepPosition;
+    glm::quat m_sweepRotation;
+
+    /*
+     * Surface properties used by the contact solver.
+     */
+    float m_friction;
+    float m_restitution;
+
+    /*
+     * Sleeping bodies are not moved until something wakes them.
+     * The sleep time is how long, in seconds, the body has stayed under the sleep thresholds.
+     */
+    bool m_sleeping;
+    float m_sleepTime;
+
     /*
      * Inertia Tensor:
      * Describes the body density throughout the object
@@ -0,0 +1,339 @@
+#pragma once
+#include "AABB.h"
+#include "ContactManifold.h"
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+typedef std::pair<AABB*, AABB*> CollisionPair;
+
+/*!
+ * \enum PairState
+ * The point in its lifetime a pair has reached this frame.
+ */
+enum PairState {
+    PAIR_BEGIN = 0,     /*!< The pair started overlapping this frame.*/
+    PAIR_STAY           /*!< The pair was already overlapping last frame.*/
+};
+
+/*!
+ * \struct PairEntry "PairManager.h"
+ * \brief A pair of overlapping AABB's that persists for as long as they overlap.
+ *
+ * Anything stored in the entry survives from frame to frame, so the narrow phase and gameplay can keep
+ * data about a pair without looking it up again. The pair is identified by the unique IDs of its AABB's,
+ * the pointers are only updated to wherever the AABB's are now.
+ */
+struct PairEntry
+{
+    AABB* m_first;          /*!< The AABB with the lower unique ID.*/
+    AABB* m_second;         /*!< The AABB with the higher unique ID.*/
+    uint32_t m_firstID;     /*!< The unique ID of the first AABB.*/
+    uint32_t m_secondID;    /*!< The unique ID of the second AABB.*/
+    uint32_t m_frame;       /*!< The last frame the broad phase reported this pair.*/
+    PairState m_state;      /*!< Whether the pair began this frame or was already overlapping.*/
+    bool m_touching;        /*!< Result of the last narrow phase test of this pair.*/
+    glm::vec3 m_separatingAxis; /*!< Axis the last narrow phase test found the pair apart along, zero if it did not find one.*/
+    ContactCache m_contactCache;    /*!< Impulses from the last time the pair's contact was solved.*/
+};
+
+/*!
+ * \class PairManager "PairManager.h"
+ * \brief Keeps the set of overlapping pairs from one frame to the next.
+ *
+ * The broad phase reports pairs with AddPair between BeginFrame and EndFrame. Each pair is keyed on the
+ * unique IDs of its two AABB's in order, and looked up in an open addressing hash table with linear probing, so
+ * a pair that was already overlapping is found and stamped with the frame rather than created again.
+ * Addresses are not used as keys, as the ECS reuses them for other AABB's when components are removed or moved.
+ * At the end of the frame any pair that was not stamped has stopped overlapping, and is moved to the ended list.
+ * AABB's removed or moved by the ECS are only recorded, and their pairs are dropped or repointed together in one
+ * pass the next time the pairs are read, so removing or moving many AABB's does not walk every pair for each one.
+ * Pairs live in one dense array so the narrow phase can walk them without chasing pointers, nothing is
+ * allocated once the array and table are large enough.
+ */
+class PairManager
+{
+public:
+    /*!
+     * \brief Default Constructor
+     */
+    PairManager() {
+        m_table.assign(INITIAL_CAPACITY, EMPTY);
+    }
+
+    /*!
+     * \brief Default Destructor
+     */
+    ~PairManager() = default;
+
+    /*!
+     * \brief Starts a new frame of pairs.
+     */
+    void BeginFrame() {
+        ApplyPendingChanges();
+        m_frame++;
+        m_endedPairs.clear();
+    }
+
+    /*!
+     * \brief Reports a pair as overlapping this frame.
+     * \param a The first AABB.
+     * \param b The second AABB.
+     *
+     * Both AABB's are marked as potentially colliding. Reporting the same pair twice in one frame has no effect.
+     */
+    void AddPair(AABB* a, AABB* b) {
+        if(b->GetUniqueID() < a->GetUniqueID()) {
+            std::swap(a, b);
+        }
+        a->IsColliding() = AABB::POTENTIAL;
+        b->IsColliding() = AABB::POTENTIAL;
+        const uint32_t first = a->GetUniqueID();
+        const uint32_t second = b->GetUniqueID();
+
+        uint32_t slot = Hash(first, second) & Mask();
+        while(m_table[slot] != EMPTY) {
+            PairEntry& entry = m_pairs[m_table[slot]];
+            if(entry.m_firstID == first && entry.m_secondID == second) {
+                if(entry.m_frame != m_frame) {
+                    entry.m_frame = m_frame;
+                    entry.m_state = PAIR_STAY;
+                }
+                entry.m_first = a;
+                entry.m_second = b;
+                return;
+            }
+            slot = (slot + 1) & Mask();
+        }
+
+        //Keep the table at most half full so probe runs stay short.
+        if((m_pairs.size() + 1) * 2 > m_table.size()) {
+            Rehash(static_cast<uint32_t>(m_table.size() * 2));
+            slot = Hash(first, second) & Mask();
+            while(m_table[slot] != EMPTY) {
+                slot = (slot + 1) & Mask();
+            }
+        }
+
+        m_table[slot] = static_cast<uint32_t>(m_pairs.size());
+        m_pairs.push_back({ a, b, first, second, m_frame, PAIR_BEGIN, false, glm::vec3(0.0f), ContactCache() });
+    }
+
+    /*!
+     * \brief Ends the frame, moving every pair that was not reported to the ended list.
+     */
+    void EndFrame() {
+        ApplyPendingChanges();
+        uint32_t i = 0;
+        while(i < m_pairs.size()) {
+            if(m_pairs[i].m_frame != m_frame) {
+                m_endedPairs.emplace_back(m_pairs[i].m_first, m_pairs[i].m_second);
+                //The last pair is moved into this place, so test the same index again.
+                RemovePair(i);
+            }
+            else {
+                i++;
+            }
+        }
+    }
+
+    /*!
+     * \brief Removes every pair of an AABB that is leaving the broad phase, without reporting them as ended.
+     * \param aabb The AABB, it is only read for its unique ID.
+     *
+     * The pairs are dropped with every other change the next time the pairs are read.
+     */
+    void RemoveAABB(const AABB* aabb) {
+        m_removedIDs.push_back(aabb->GetUniqueID());
+    }
+
+    /*!
+     * \brief Points every pair of an AABB at its new address.
+     * \param aabb The AABB at its new address.
+     *
+     * The pairs are repointed with every other change the next time the pairs are read.
+     */
+    void RelocateAABB(AABB* aabb) {
+        m_relocations.emplace_back(aabb->GetUniqueID(), aabb);
+    }
+
+    /*!
+     * \brief Removes every pair without reporting them as ended.
+     */
+    void Clear() {
+        m_pairs.clear();
+        m_endedPairs.clear();
+        m_removedIDs.clear();
+        m_relocations.clear();
+        std::fill(m_table.begin(), m_table.end(), EMPTY);
+    }
+
+    /*!
+     * \brief Finds the entry for a pair.
+     * \return Returns the entry, or nullptr if the pair is not overlapping.
+     */
+    PairEntry* Find(const AABB* a, const AABB* b) {
+        ApplyPendingChanges();
+        if(b->GetUniqueID() < a->GetUniqueID()) {
+            std::swap(a, b);
+        }
+        const uint32_t slot = FindSlot(a->GetUniqueID(), b->GetUniqueID());
+        return slot == EMPTY ? nullptr : &m_pairs[m_table[slot]];
+    }
+
+    /*!
+     * \brief Gets every pair overlapping this frame, both those that began and those that stayed.
+     */
+    std::vector<PairEntry>& GetPairs() {
+        ApplyPendingChanges();
+        return m_pairs;
+    }
+
+    /*!
+     * \brief Gets every pair that stopped overlapping this frame.
+     *
+     * Either AABB may have been removed from the broad phase this frame, so they should only be used to identify the pair.
+     */
+    const std::vector<CollisionPair>& GetEndedPairs() const {
+        return m_endedPairs;
+    }
+
+    /*!
+     * \brief Gets the number of pairs overlapping this frame.
+     */
+    size_t GetPairCount() {
+        ApplyPendingChanges();
+        return m_pairs.size();
+    }
+
+private:
+    static constexpr uint32_t EMPTY = 0xFFFFFFFF;       /*!< Marks an unused slot in the table.*/
+    static constexpr uint32_t INITIAL_CAPACITY = 1024;  /*!< Number of slots the table starts with, always a power of two.*/
+
+    uint32_t m_frame = 0;                       /*!< Stamp of the current frame.*/
+    std::vector<PairEntry> m_pairs;             /*!< Dense array of every overlapping pair.*/
+    std::vector<uint32_t> m_table;              /*!< Open addressing table of indices into the pairs.*/
+    std::vector<CollisionPair> m_endedPairs;    /*!< Pairs that stopped overlapping this frame.*/
+    std::vector<uint32_t> m_removedIDs;         /*!< Unique IDs of AABB's removed since the pairs were last read.*/
+    std::vector<std::pair<uint32_t, AABB*>> m_relocations;  /*!< AABB's moved since the pairs were last read, in the order they moved.*/
+
+    uint32_t Mask() const {
+        return static_cast<uint32_t>(m_table.size() - 1);
+    }
+
+    /*!
+     * \brief Hashes an ordered pair of AABB unique IDs.
+     */
+    static uint32_t Hash(uint32_t first, uint32_t second) {
+        uint64_t key = ((static_cast<uint64_t>(first) << 32) | second) * 0x9E3779B97F4A7C15ull;
+        key ^= key >> 32;
+        key *= 0xD6E8FEB86659FD93ull;
+        key ^= key >> 32;
+        return static_cast<uint32_t>(key);
+    }
+
+    /*!
+     * \brief Finds the slot holding a pair.
+     * \return Returns the slot, or EMPTY if the pair is not in the table.
+     */
+    uint32_t FindSlot(uint32_t first, uint32_t second) const {
+        uint32_t slot = Hash(first, second) & Mask();
+        while(m_table[slot] != EMPTY) {
+            const PairEntry& entry = m_pairs[m_table[slot]];
+            if(entry.m_firstID == first && entry.m_secondID == second) {
+                return slot;
+            }
+            slot = (slot + 1) & Mask();
+        }
+        return EMPTY;
+    }
+
+    /*!
+     * \brief Drops the pairs of removed AABB's and repoints the pairs of moved ones, in one pass over the pairs.
+     */
+    void ApplyPendingChanges() {
+        if(m_removedIDs.empty() && m_relocations.empty()) {
+            return;
+        }
+
+        std::sort(m_removedIDs.begin(), m_removedIDs.end());
+        //An AABB moved more than once ends up at its last address, which stays last once sorted.
+        std::stable_sort(m_relocations.begin(), m_relocations.end(), [](const std::pair<uint32_t, AABB*>& a, const std::pair<uint32_t, AABB*>& b) {
+            return a.first < b.first;
+        });
+
+        uint32_t i = 0;
+        while(i < m_pairs.size()) {
+            PairEntry& pair = m_pairs[i];
+            if(std::binary_search(m_removedIDs.begin(), m_removedIDs.end(), pair.m_firstID) ||
+               std::binary_search(m_removedIDs.begin(), m_removedIDs.end(), pair.m_secondID)) {
+                //The last pair is moved into this place, so test the same index again.
+                RemovePair(i);
+                continue;
+            }
+            pair.m_first = FindRelocation(pair.m_firstID, pair.m_first);
+            pair.m_second = FindRelocation(pair.m_secondID, pair.m_second);
+            i++;
+        }
+        m_removedIDs.clear();
+        m_relocations.clear();
+    }
+
+    /*!
+     * \brief Finds the latest address of a moved AABB.
+     * \param id The unique ID of the AABB.
+     * \param current The address to keep if the AABB has not moved.
+     */
+    AABB* FindRelocation(uint32_t id, AABB* current) const {
+        auto it = std::upper_bound(m_relocations.begin(), m_relocations.end(), id, [](uint32_t value, const std::pair<uint32_t, AABB*>& entry) {
+            return value < entry.first;
+        });
+        return (it != m_relocations.begin() && (it - 1)->first == id) ? (it - 1)->second : current;
+    }
+
+    /*!
+     * \brief Removes a pair from the table and the array.
+     * \param index The index of the pair in the array.
+     *
+     * The slot is emptied by shifting later entries of the probe run back, so no tombstones are left behind.
+     * The last pair in the array is then moved into the gap.
+     */
+    void RemovePair(uint32_t index) {
+        uint32_t hole = FindSlot(m_pairs[index].m_firstID, m_pairs[index].m_secondID);
+        uint32_t next = (hole + 1) & Mask();
+        while(m_table[next] != EMPTY) {
+            const PairEntry& entry = m_pairs[m_table[next]];
+            const uint32_t home = Hash(entry.m_firstID, entry.m_secondID) & Mask();
+            //Entries whose probe run passes through the hole can move into it.
+            if(((next - home) & Mask()) >= ((next - hole) & Mask())) {
+                m_table[hole] = m_table[next];
+                hole = next;
+            }
+            next = (next + 1) & Mask();
+        }
+        m_table[hole] = EMPTY;
+
+        const uint32_t last = static_cast<uint32_t>(m_pairs.size() - 1);
+        if(index != last) {
+            m_table[FindSlot(m_pairs[last].m_firstID, m_pairs[last].m_secondID)] = index;
+            m_pairs[index] = m_pairs[last];
+        }
+        m_pairs.pop_back();
+    }
+
+    /*!
+     * \brief Resizes the table and reinserts every pair.
+     * \param capacity The new number of slots, must be a power of two.
+     */
+    void Rehash(uint32_t capacity) {
+        m_table.assign(capacity, EMPTY);
+        for(uint32_t i = 0; i < m_pairs.size(); i++) {
+            uint32_t slot = Hash(m_pairs[i].m_firstID, m_pairs[i].m_secondID) & Mask();
+            while(m_table[slot] != EMPTY) {
+                slot = (slot + 1) & Mask();
+            }
+            m_table[slot] = i;
+        }
+    }
+};
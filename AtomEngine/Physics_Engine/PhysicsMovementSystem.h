@@ -1,13 +1,27 @@
 #pragma once
+#include <vector>
+#include <utility>
+#include <algorithm>
 #include "ECS_System.h"
 #include "RigidBodyComponent.h"
 #include "TransformComponent.h"
+#include "BodyStore.h"
+#include "IntegrationKernels.h"
+#include "ThreadPool.h"
 #include "ProfilerManager.h"
 
+/*!
+ * \brief Moves every awake rigid body by its momentum, and adds gravity to it.
+ *
+ * Awake bodies are copied into a BodyStore and integrated eight at a time by the widest kernel the CPU supports.
+ * The bodies are split into jobs of whole blocks of eight, and each job copies its bodies in, integrates them and
+ * writes them back to their transforms and rigid bodies together, so no two jobs ever touch the same body.
+ */
 class PhysicsMovementSystem : public BaseECSSystem
 {
 public:
-    PhysicsMovementSystem() : BaseECSSystem()
+    PhysicsMovementSystem() : BaseECSSystem(),
+        m_integrate(IntegrationKernels::GetIntegrateFunction())
     {
         AddComponentType(TransformComponent::ID);
         AddComponentType(RigidBodyComponent::ID);
@@ -16,32 +30,57 @@ public:
     virtual void UpdateComponents(float deltaTime, std::vector<std::vector<BaseECSComponent*>>& componentArrays) override
     {
         Profiler::Instance()->Start("Update All Rigid Bodies");
+        m_bodies.clear();
         for (uint32_t i = 0; i < componentArrays[0].size(); i++)
         {
-            POD_Transform& transform = ((TransformComponent*)componentArrays[0][i])->m_transform;
             POD_RigidBody& body = ((RigidBodyComponent*)componentArrays[1][i])->m_rigidBody;
-
-            if(body.UsesGravity()) {
-                body.ApplyForce(glm::vec3(0, (-9.81f * body.m_mass), 0) * deltaTime);
+            if(!body.IsSleeping()) {
+                m_bodies.emplace_back(&((TransformComponent*)componentArrays[0][i])->m_transform, &body);
             }
+        }
 
-            auto velocity = (body.m_linearMomentum / body.m_mass) * deltaTime;
-
-            transform.Translate(velocity);
-
-            auto rotationMatrix = transform.GetRotationMatrix();
-
-            auto inverseInertia = rotationMatrix * body.m_inverseInertiaTensorIntegral * glm::transpose(rotationMatrix);
-
-            auto angularVelocity = (inverseInertia * body.m_angularMomentum) * deltaTime;
-
-            auto q = glm::quat(0, angularVelocity.x, angularVelocity.y, angularVelocity.z);
+        const uint32_t count = static_cast<uint32_t>(m_bodies.size());
+        const uint32_t blockCount = (count + BodyStore::WIDTH - 1) / BodyStore::WIDTH;
+        m_store.Resize(count);
+        ParallelFor(blockCount, GetParallelJobCount(blockCount, BLOCKS_PER_JOB), [this, count, deltaTime](uint32_t, uint32_t firstBlock, uint32_t lastBlock) {
+            //Bodies are worked through a tile at a time, so they are still in the cache when they are written back.
+            for(uint32_t block = firstBlock; block < lastBlock; block += BLOCKS_PER_TILE) {
+                const uint32_t begin = block * BodyStore::WIDTH;
+                const uint32_t padded = (std::min)(block + BLOCKS_PER_TILE, lastBlock) * BodyStore::WIDTH;
+                const uint32_t end = (std::min)(padded, count);
+                for(uint32_t i = begin; i < end; i++) {
+                    POD_Transform& transform = *m_bodies[i].first;
+                    POD_RigidBody& body = *m_bodies[i].second;
+                    if(body.IsContinuous()) {
+                        body.m_sweepPosition = transform.GetPosition();
+                        body.m_sweepRotation = transform.GetRotation();
+                    }
+                    m_store.Set(i, transform, body);
+                }
 
-            auto spin = 0.5f * (q * transform.GetRotation());
+                //The last block is integrated whole, its padding is at rest and never written back.
+                m_integrate(m_store, begin, padded, deltaTime);
 
-            transform.SetRotation(transform.GetRotation() + spin);
-        }
+                for(uint32_t i = begin; i < end; i++) {
+                    m_store.Get(i, *m_bodies[i].first, *m_bodies[i].second);
+                }
+            }
+        });
         Profiler::Instance()->End("Update All Rigid Bodies");
     }
 
+    /*!
+     * \brief Forces a narrower integration kernel, for comparing them.
+     */
+    void SetInstructionSet(OverlapKernels::InstructionSet set) {
+        m_integrate = IntegrationKernels::GetIntegrateFunction(set);
+    }
+
+private:
+    static constexpr uint32_t BLOCKS_PER_JOB = 32;  /*!< The fewest blocks of eight bodies worth giving a job of their own.*/
+    static constexpr uint32_t BLOCKS_PER_TILE = 8;  /*!< The blocks copied in, integrated and written back together.*/
+
+    IntegrationKernels::IntegrateFunction m_integrate;                  /*!< The kernel bodies are integrated with.*/
+    BodyStore m_store;                                                  /*!< The awake bodies, copied in each step.*/
+    std::vector<std::pair<POD_Transform*, POD_RigidBody*>> m_bodies;    /*!< The awake bodies, in the order they are stored.*/
 };
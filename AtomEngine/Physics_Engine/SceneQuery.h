@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cmath>
+#include <cfloat>
+#include <GLM/glm.hpp>
+
+#include "AABB.h"
+
+/*!
+ * \struct Ray "SceneQuery.h"
+ * \brief A ray cast into the broad phase.
+ *
+ * The direction is normalised so hit distances are in world units. The inverse direction is kept for the slab test,
+ * with zero components replaced by a huge value so boxes lying exactly on the ray's plane do not produce NaNs.
+ */
+struct Ray
+{
+    /*!
+     * \brief Constructor
+     * \param origin Where the ray starts.
+     * \param direction Which way the ray points, does not need to be normalised.
+     * \param maxDistance How far along the ray hits are reported.
+     */
+    Ray(const glm::vec3& origin, const glm::vec3& direction, float maxDistance = FLT_MAX) :
+        m_origin(origin),
+        m_direction(glm::normalize(direction)),
+        m_maxDistance(maxDistance)
+    {
+        for(int i = 0; i < 3; i++) {
+            m_inverseDirection[i] = std::fabs(m_direction[i]) > 1e-12f ? 1.0f / m_direction[i] : std::copysign(1e30f, m_direction[i]);
+        }
+    }
+
+    /*!
+     * \brief Gets the point a distance along the ray.
+     */
+    glm::vec3 GetPoint(float distance) const {
+        return m_origin + m_direction * distance;
+    }
+
+    glm::vec3 m_origin;             /*!< Where the ray starts.*/
+    glm::vec3 m_direction;          /*!< Normalised direction of the ray.*/
+    glm::vec3 m_inverseDirection;   /*!< One over each component of the direction.*/
+    float m_maxDistance;            /*!< How far along the ray hits are reported.*/
+};
+
+/*!
+ * \struct RaycastHit "SceneQuery.h"
+ * \brief Where a ray entered an AABB.
+ */
+struct RaycastHit
+{
+    AABB* m_aabb = nullptr;         /*!< The AABB that was hit.*/
+    float m_distance = 0.0f;        /*!< Distance along the ray, zero if the ray started inside the AABB.*/
+    glm::vec3 m_point{ 0.0f };      /*!< The point the ray entered the AABB.*/
+    glm::vec3 m_normal{ 0.0f };     /*!< The face normal where the ray entered, zero if the ray started inside the AABB.*/
+};
+
+/*!
+ * \struct Frustum "SceneQuery.h"
+ * \brief Six planes bounding a view volume, with normals facing inwards.
+ */
+struct Frustum
+{
+    /*!
+     * \enum FrustumTest
+     * Where a box lies relative to the frustum.
+     */
+    enum FrustumTest {
+        OUTSIDE = 0,    /*!< The box is entirely outside one of the planes.*/
+        INTERSECTS,     /*!< The box crosses at least one plane.*/
+        INSIDE          /*!< The box is inside every plane.*/
+    };
+
+    /*!
+     * \brief Extracts the planes from a view projection matrix.
+     * \param viewProjection The projection matrix multiplied by the view matrix, using OpenGL clip space.
+     */
+    static Frustum FromMatrix(const glm::mat4& viewProjection) {
+        //Rows of the matrix, glm stores columns.
+        glm::vec4 rows[4];
+        for(int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        }
+
+        Frustum frustum;
+        frustum.m_planes[0] = rows[3] + rows[0];    //Left
+        frustum.m_planes[1] = rows[3] - rows[0];    //Right
+        frustum.m_planes[2] = rows[3] + rows[1];    //Bottom
+        frustum.m_planes[3] = rows[3] - rows[1];    //Top
+        frustum.m_planes[4] = rows[3] + rows[2];    //Near
+        frustum.m_planes[5] = rows[3] - rows[2];    //Far
+
+        for(glm::vec4& plane : frustum.m_planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    /*!
+     * \brief Finds where a box lies relative to the frustum.
+     * \param min The minimum corner of the box.
+     * \param max The maximum corner of the box.
+     *
+     * Only the corner furthest along each plane normal is tested to see if the box is outside, and the nearest
+     * corner to see if it is inside, so each plane costs two dot products.
+     */
+    FrustumTest TestBox(const glm::vec3& min, const glm::vec3& max) const {
+        FrustumTest result = INSIDE;
+        for(const glm::vec4& plane : m_planes) {
+            const glm::vec3 normal(plane);
+            const glm::vec3 furthest(normal.x >= 0.0f ? max.x : min.x, normal.y >= 0.0f ? max.y : min.y, normal.z >= 0.0f ? max.z : min.z);
+            if(glm::dot(normal, furthest) + plane.w < 0.0f) {
+                return OUTSIDE;
+            }
+            const glm::vec3 nearest(normal.x >= 0.0f ? min.x : max.x, normal.y >= 0.0f ? min.y : max.y, normal.z >= 0.0f ? min.z : max.z);
+            if(glm::dot(normal, nearest) + plane.w < 0.0f) {
+                result = INTERSECTS;
+            }
+        }
+        return result;
+    }
+
+    glm::vec4 m_planes[6];  /*!< Left, right, bottom, top, near and far planes as normal and distance.*/
+};
+
+namespace SceneQuery {
+
+    /*!
+     * \brief Finds where a ray enters a box using the slab test.
+     * \param ray The ray.
+     * \param min The minimum corner of the box.
+     * \param max The maximum corner of the box.
+     * \param maxDistance Hits beyond this distance are ignored.
+     * \param distance Receives the entry distance, zero if the ray starts inside the box.
+     * \return Returns true if the ray hits the box within the distance.
+     */
+    inline bool RayIntersectsBox(const Ray& ray, const glm::vec3& min, const glm::vec3& max, float maxDistance, float& distance) {
+        const glm::vec3 t1 = (min - ray.m_origin) * ray.m_inverseDirection;
+        const glm::vec3 t2 = (max - ray.m_origin) * ray.m_inverseDirection;
+        const glm::vec3 tNear = glm::min(t1, t2);
+        const glm::vec3 tFar = glm::max(t1, t2);
+
+        const float enter = (std::max)((std::max)(tNear.x, tNear.y), (std::max)(tNear.z, 0.0f));
+        const float exit = (std::min)((std::min)(tFar.x, tFar.y), (std::min)(tFar.z, maxDistance));
+        distance = enter;
+        return enter <= exit;
+    }
+
+    /*!
+     * \brief Fills in a hit for a ray that enters an AABB.
+     * \param ray The ray.
+     * \param aabb The AABB that was hit.
+     * \param distance The entry distance found by RayIntersectsBox.
+     */
+    inline RaycastHit MakeHit(const Ray& ray, AABB* aabb, float distance) {
+        RaycastHit hit;
+        hit.m_aabb = aabb;
+        hit.m_distance = distance;
+        hit.m_point = ray.GetPoint(distance);
+
+        //The face entered is on the axis whose slab was entered last.
+        if(distance > 0.0f) {
+            const glm::vec3 t1 = (aabb->GetMinBounds() - ray.m_origin) * ray.m_inverseDirection;
+            const glm::vec3 t2 = (aabb->GetMaxBounds() - ray.m_origin) * ray.m_inverseDirection;
+            const glm::vec3 tNear = glm::min(t1, t2);
+            const int axis = tNear.x >= tNear.y ? (tNear.x >= tNear.z ? 0 : 2) : (tNear.y >= tNear.z ? 1 : 2);
+            hit.m_normal[axis] = ray.m_direction[axis] > 0.0f ? -1.0f : 1.0f;
+        }
+        return hit;
+    }
+
+    /*!
+     * \brief Tests if two boxes overlap.
+     */
+    inline bool BoxesOverlap(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB) {
+        return minA.x <= maxB.x && maxA.x >= minB.x &&
+               minA.y <= maxB.y && maxA.y >= minB.y &&
+               minA.z <= maxB.z && maxA.z >= minB.z;
+    }
+}
@@ -0,0 +1,294 @@
+#pragma once
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include "ContactGeneration.h"
+
+/*!
+ * Exact collision tests for boxes and spheres.
+ *
+ * Meshes classified as a box or a sphere when their hull was built are tested here in closed form rather than
+ * with GJK, filling the same contact manifold. The shapes fill the mesh's bounds, placed by its transform.
+ */
+namespace ShapeCollision {
+
+    /*!
+     * \struct OrientedBox "ShapeCollision.h"
+     * \brief A box in world space, with unit axes and half the size along each.
+     */
+    struct OrientedBox
+    {
+        glm::vec3 m_centre;         /*!< The centre in world space.*/
+        glm::vec3 m_axes[3];        /*!< The unit axes of the box in world space.*/
+        glm::vec3 m_halfExtents;    /*!< Half the size of the box along each axis.*/
+    };
+
+    /*!
+     * \struct Sphere "ShapeCollision.h"
+     * \brief A sphere in world space.
+     */
+    struct Sphere
+    {
+        glm::vec3 m_centre;     /*!< The centre in world space.*/
+        float m_radius;         /*!< The radius in world space.*/
+    };
+
+    const float EDGE_BIAS = 0.95f;          /*!< An edge axis must overlap less than this fraction of the best face axis to be used.*/
+    const float PARALLEL_TOLERANCE = 1e-3f; /*!< Edge pairs whose cross product is shorter than this are parallel and skipped.*/
+
+    /*!
+     * \brief Gets the box filling a collider's mesh bounds.
+     */
+    inline OrientedBox MakeBox(const AABB& aabb) {
+        POD_Transform& transform = *aabb.GetTransform();
+        const POD_Mesh& mesh = *aabb.GetMesh();
+        const glm::mat3 linear(transform.GetMatrix());
+        const glm::mat3 rotation = transform.GetRotationMatrix();
+
+        OrientedBox box;
+        box.m_centre = linear * mesh.GetLocalCentre() + transform.GetPosition();
+        for(int i = 0; i < 3; i++) {
+            box.m_axes[i] = rotation[i];
+        }
+        box.m_halfExtents = mesh.GetLocalHalfExtents() * glm::abs(transform.GetScale());
+        return box;
+    }
+
+    /*!
+     * \brief Gets the sphere filling a collider's mesh bounds.
+     *
+     * A sphere scaled differently on each axis is an ellipsoid, the largest scale is used so it is never missed.
+     */
+    inline Sphere MakeSphere(const AABB& aabb) {
+        POD_Transform& transform = *aabb.GetTransform();
+        const POD_Mesh& mesh = *aabb.GetMesh();
+        const glm::vec3 halfExtents = mesh.GetLocalHalfExtents();
+        const glm::vec3 scale = glm::abs(transform.GetScale());
+
+        Sphere sphere;
+        sphere.m_centre = glm::mat3(transform.GetMatrix()) * mesh.GetLocalCentre() + transform.GetPosition();
+        sphere.m_radius = (std::max)((std::max)(halfExtents.x, halfExtents.y), halfExtents.z) * (std::max)((std::max)(scale.x, scale.y), scale.z);
+        return sphere;
+    }
+
+    /*!
+     * \brief Gets the corners of a box within a tolerance of the furthest in a direction.
+     * \param box The box.
+     * \param direction The unit direction.
+     * \param tolerance How far behind the furthest corner a corner may be.
+     * \param points Receives the corners, one for a vertex, two for an edge and four for a face.
+     * \return Returns the number of corners.
+     */
+    inline uint32_t GetBoxFeature(const OrientedBox& box, const glm::vec3& direction, float tolerance, glm::vec3* points) {
+        float signs[3];
+        bool free[3];
+        float alignments[3];
+        for(int i = 0; i < 3; i++) {
+            const float along = glm::dot(box.m_axes[i], direction);
+            signs[i] = along >= 0.0f ? 1.0f : -1.0f;
+            alignments[i] = std::abs(along);
+            //Flipping the corner along this axis moves it back by twice the half extent times the alignment.
+            free[i] = 2.0f * box.m_halfExtents[i] * alignments[i] <= tolerance;
+        }
+        //A feature never spans the box along the axis nearest the direction, which a thin box's tolerance could allow.
+        const int nearest = alignments[0] >= alignments[1] ? (alignments[0] >= alignments[2] ? 0 : 2) : (alignments[1] >= alignments[2] ? 1 : 2);
+        free[nearest] = false;
+
+        uint32_t count = 0;
+        for(int corner = 0; corner < 8; corner++) {
+            glm::vec3 point = box.m_centre;
+            bool matches = true;
+            for(int i = 0; i < 3 && matches; i++) {
+                const float sign = (corner & (1 << i)) ? 1.0f : -1.0f;
+                matches = free[i] || sign == signs[i];
+                point += box.m_axes[i] * (box.m_halfExtents[i] * sign);
+            }
+            if(matches) {
+                points[count++] = point;
+            }
+        }
+        return count;
+    }
+
+    /*!
+     * \brief Tests two boxes with the separating axis test.
+     * \param box0 The first collider.
+     * \param box1 The second collider.
+     * \param manifold Receives the contact if they overlap.
+     * \return Returns true if the boxes overlap.
+     *
+     * The three face axes of each box and the nine cross products of their edges are tested, stopping at the
+     * first that separates them. Otherwise the axis they overlap least along is the contact normal, preferring
+     * face axes, and the contact points are found by clipping the two boxes' features.
+     */
+    inline bool BoxBox(AABB& box0, AABB& box1, ContactManifold& manifold) {
+        const OrientedBox a = MakeBox(box0);
+        const OrientedBox b = MakeBox(box1);
+        const glm::vec3 offset = b.m_centre - a.m_centre;
+
+        //The rotation from b's frame to a's, and the offset in a's frame.
+        float rotation[3][3];
+        float absolute[3][3];
+        glm::vec3 t;
+        for(int i = 0; i < 3; i++) {
+            for(int j = 0; j < 3; j++) {
+                rotation[i][j] = glm::dot(a.m_axes[i], b.m_axes[j]);
+                absolute[i][j] = std::abs(rotation[i][j]) + FLT_EPSILON;
+            }
+            t[i] = glm::dot(offset, a.m_axes[i]);
+        }
+
+        float bestOverlap = FLT_MAX;
+        glm::vec3 bestAxis(0.0f);
+        //Returns false if the axis separates the boxes, otherwise keeps it if it is the shallowest so far.
+        auto testAxis = [&](float distance, float radiusA, float radiusB, float length, const glm::vec3& axis, bool isEdge) {
+            const float overlap = (radiusA + radiusB - std::abs(distance)) / length;
+            if(overlap < 0.0f) {
+                return false;
+            }
+            if(overlap < bestOverlap * (isEdge ? EDGE_BIAS : 1.0f)) {
+                bestOverlap = overlap;
+                bestAxis = distance < 0.0f ? -axis / length : axis / length;
+            }
+            return true;
+        };
+
+        const glm::vec3& ha = a.m_halfExtents;
+        const glm::vec3& hb = b.m_halfExtents;
+        for(int i = 0; i < 3; i++) {
+            const float radiusB = hb.x * absolute[i][0] + hb.y * absolute[i][1] + hb.z * absolute[i][2];
+            if(!testAxis(t[i], ha[i], radiusB, 1.0f, a.m_axes[i], false)) {
+                return false;
+            }
+        }
+        for(int j = 0; j < 3; j++) {
+            const float radiusA = ha.x * absolute[0][j] + ha.y * absolute[1][j] + ha.z * absolute[2][j];
+            const float distance = t.x * rotation[0][j] + t.y * rotation[1][j] + t.z * rotation[2][j];
+            if(!testAxis(distance, radiusA, hb[j], 1.0f, b.m_axes[j], false)) {
+                return false;
+            }
+        }
+        for(int i = 0; i < 3; i++) {
+            const int i1 = (i + 1) % 3;
+            const int i2 = (i + 2) % 3;
+            for(int j = 0; j < 3; j++) {
+                const int j1 = (j + 1) % 3;
+                const int j2 = (j + 2) % 3;
+                const float length = std::sqrt((std::max)(1.0f - rotation[i][j] * rotation[i][j], 0.0f));
+                if(length < PARALLEL_TOLERANCE) {
+                    continue;
+                }
+                const float radiusA = ha[i1] * absolute[i2][j] + ha[i2] * absolute[i1][j];
+                const float radiusB = hb[j1] * absolute[i][j2] + hb[j2] * absolute[i][j1];
+                const float distance = t[i2] * rotation[i1][j] - t[i1] * rotation[i2][j];
+                if(!testAxis(distance, radiusA, radiusB, length, glm::cross(a.m_axes[i], b.m_axes[j]), true)) {
+                    return false;
+                }
+            }
+        }
+
+        manifold.m_first = &box0;
+        manifold.m_second = &box1;
+        manifold.m_normal = bestAxis;
+        manifold.m_depth = bestOverlap;
+
+        const float sizeA = 2.0f * glm::length(ha);
+        const float sizeB = 2.0f * glm::length(hb);
+        glm::vec3 featureA[8];
+        glm::vec3 featureB[8];
+        const uint32_t countA = GetBoxFeature(a, bestAxis, ContactGeneration::FEATURE_TOLERANCE * sizeA, featureA);
+        const uint32_t countB = GetBoxFeature(b, -bestAxis, ContactGeneration::FEATURE_TOLERANCE * sizeB, featureB);
+        ContactGeneration::GenerateFromFeatures(featureA, countA, featureB, countB, sizeA, sizeB, manifold);
+        return true;
+    }
+
+    /*!
+     * \brief Tests two spheres.
+     * \param box0 The first collider.
+     * \param box1 The second collider.
+     * \param manifold Receives the contact if they overlap.
+     * \return Returns true if the spheres overlap.
+     */
+    inline bool SphereSphere(AABB& box0, AABB& box1, ContactManifold& manifold) {
+        const Sphere a = MakeSphere(box0);
+        const Sphere b = MakeSphere(box1);
+        const glm::vec3 offset = b.m_centre - a.m_centre;
+        const float distance = glm::length(offset);
+        const float depth = a.m_radius + b.m_radius - distance;
+        if(depth < 0.0f) {
+            return false;
+        }
+
+        manifold.m_first = &box0;
+        manifold.m_second = &box1;
+        //Spheres at the same centre can be pushed apart in any direction.
+        manifold.m_normal = distance > FLT_EPSILON ? offset / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+        manifold.m_depth = depth;
+        manifold.m_points[0].m_position = a.m_centre + manifold.m_normal * (a.m_radius - depth * 0.5f);
+        manifold.m_points[0].m_depth = depth;
+        manifold.m_pointCount = 1;
+        return true;
+    }
+
+    /*!
+     * \brief Tests a sphere against a box.
+     * \param box0 The first collider.
+     * \param box1 The second collider.
+     * \param sphereFirst Is the first collider the sphere, otherwise the first collider is the box.
+     * \param manifold Receives the contact if they overlap, with the normal pointing from the first collider to the second.
+     * \return Returns true if the sphere and box overlap.
+     *
+     * The sphere's centre is clamped to the box to find the closest point. If the centre is inside the box the
+     * sphere is pushed out through the nearest face.
+     */
+    inline bool SphereBox(AABB& box0, AABB& box1, bool sphereFirst, ContactManifold& manifold) {
+        const Sphere sphere = MakeSphere(sphereFirst ? box0 : box1);
+        const OrientedBox box = MakeBox(sphereFirst ? box1 : box0);
+
+        const glm::vec3 offset = sphere.m_centre - box.m_centre;
+        glm::vec3 local;
+        glm::vec3 closest;
+        for(int i = 0; i < 3; i++) {
+            local[i] = glm::dot(offset, box.m_axes[i]);
+            closest[i] = glm::clamp(local[i], -box.m_halfExtents[i], box.m_halfExtents[i]);
+        }
+
+        glm::vec3 normal;
+        float depth;
+        const glm::vec3 outside = local - closest;
+        const float distanceSquared = glm::dot(outside, outside);
+        if(distanceSquared > FLT_EPSILON) {
+            if(distanceSquared > sphere.m_radius * sphere.m_radius) {
+                return false;
+            }
+            const float distance = std::sqrt(distanceSquared);
+            const glm::vec3 direction = outside / distance;
+            normal = box.m_axes[0] * direction.x + box.m_axes[1] * direction.y + box.m_axes[2] * direction.z;
+            depth = sphere.m_radius - distance;
+        }
+        else {
+            //The centre is inside the box, push out through the nearest face.
+            int axis = 0;
+            float nearest = FLT_MAX;
+            for(int i = 0; i < 3; i++) {
+                const float toFace = box.m_halfExtents[i] - std::abs(local[i]);
+                if(toFace < nearest) {
+                    nearest = toFace;
+                    axis = i;
+                }
+            }
+            normal = box.m_axes[axis] * (local[axis] >= 0.0f ? 1.0f : -1.0f);
+            depth = sphere.m_radius + nearest;
+        }
+
+        //The normal found points from the box to the sphere.
+        manifold.m_first = &box0;
+        manifold.m_second = &box1;
+        manifold.m_normal = sphereFirst ? -normal : normal;
+        manifold.m_depth = depth;
+        manifold.m_points[0].m_position = sphere.m_centre - normal * (sphere.m_radius - depth * 0.5f);
+        manifold.m_points[0].m_depth = depth;
+        manifold.m_pointCount = 1;
+        return true;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <algorithm>
+#include <GLM/glm.hpp>
+#include "AABB.h"
+
+/*!
+ * \struct Simplex "Simplex.h"
+ * \brief Up to four points of the Minkowski difference, newest first.
+ *
+ * Held by value so GJK never allocates, reducing the simplex just overwrites the points that are kept.
+ */
+struct Simplex
+{
+    glm::vec3 m_points[4];  /*!< The points, the most recently added is always first.*/
+    int m_count = 0;        /*!< How many of the points are in use.*/
+
+    /*!
+     * \brief Adds a new point to the front, moving the others back.
+     */
+    void Push(const glm::vec3& point) {
+        m_points[3] = m_points[2];
+        m_points[2] = m_points[1];
+        m_points[1] = m_points[0];
+        m_points[0] = point;
+        m_count = (std::min)(m_count + 1, 4);
+    }
+
+    void Set(const glm::vec3& a) {
+        m_points[0] = a;
+        m_count = 1;
+    }
+
+    void Set(const glm::vec3& a, const glm::vec3& b) {
+        m_points[0] = a;
+        m_points[1] = b;
+        m_count = 2;
+    }
+
+    void Set(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+        m_points[0] = a;
+        m_points[1] = b;
+        m_points[2] = c;
+        m_count = 3;
+    }
+};
+
+/*!
+ * \brief Gets a support point from the Minkowski Difference.
+ * \param box0 The first collider as reference.
+ * \param box1 The second collider as reference.
+ * \param direction The search direction as reference.
+ * 
+ * Uses the Minkowski difference of both colliders and the supplied direction vector to get a support
+ * point for the Simplex. The difference is the second collider minus the first.
+ */
+inline glm::vec3 MinkowskiDifferenceSupport(const AABB& box0, const AABB& box1, const glm::vec3& direction) {
+    //Get the first support from second collider.
+    const glm::vec3 supportA = box1.GetMesh()->Support(*box1.GetTransform(), direction);
+    //Get the second support from first collider.
+    const glm::vec3 supportB = box0.GetMesh()->Support(*box0.GetTransform(), -direction);
+    //Get the difference of the two supports.
+    return supportA - supportB;
+}
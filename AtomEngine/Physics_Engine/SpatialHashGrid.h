@@ -0,0 +1,461 @@
+#pragma once
+#include "BroadPhase.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "AABB.h"
+
+/*!
+ * \struct GridProxy "SpatialHashGrid.h"
+ * \brief Spatial hash grid record of a single AABB.
+ */
+struct GridProxy
+{
+    AABB* m_aabb;           /*!< The AABB this proxy tracks, nullptr once removed.*/
+    glm::ivec3 m_minCell;   /*!< First cell the AABB covers.*/
+    glm::ivec3 m_maxCell;   /*!< Last cell the AABB covers.*/
+    bool m_inGrid;          /*!< Whether the proxy is currently stored in its cells.*/
+};
+
+/*!
+ * \struct GridEntry "SpatialHashGrid.h"
+ * \brief Link in the list of proxies stored in one cell.
+ */
+struct GridEntry
+{
+    uint32_t m_proxy;   /*!< Index of the proxy.*/
+    uint32_t m_next;    /*!< Index of the next entry in the same cell.*/
+};
+
+/*!
+ * \class SpatialHashGrid "SpatialHashGrid.h"
+ * \brief Broadphase that buckets AABB's into a uniform grid of cells stored in a hash table.
+ *
+ * Each AABB is stored in every cell it covers, and only AABB's sharing a cell are tested against each other.
+ * This is close to linear when bodies are of similar size, which is the case the cell size should be chosen for.
+ * The cell size can be given, or derived from the median AABB extent.
+ * Cells live in an open addressing hash table made of flat arrays, and each cell keeps a linked list of
+ * entries taken from a single entry pool. A body is only moved between cells when the range of cells it
+ * covers has changed.
+ */
+class SpatialHashGrid : public BroadPhase
+{
+public:
+    /*!
+     * \brief Default Constructor
+     * \param debugRenderer The renderer to draw debug cells with.
+     * \param cellSize Size of each grid cell, zero or less derives it from the median AABB extent.
+     */
+    SpatialHashGrid(DebugRenderer* debugRenderer, float cellSize = 0.0f) : BroadPhase(debugRenderer),
+        m_cellSize(cellSize),
+        m_autoCellSize(cellSize <= 0.0f)
+    {
+        m_debugRenderer = debugRenderer;
+        ResizeTable(1024);
+    }
+
+    /*!
+     * \brief Default Destructor
+     */
+    virtual ~SpatialHashGrid() = default;
+
+    /*!
+     * \brief Sets the size of each grid cell.
+     * \param cellSize Size of each grid cell, zero or less derives it from the median AABB extent.
+     *
+     * Every proxy is rehashed on the next update.
+     */
+    void SetCellSize(float cellSize) {
+        m_autoCellSize = cellSize <= 0.0f;
+        m_cellSize = cellSize;
+        m_cellSizeProxyCount = 0;
+        RemoveAllFromGrid();
+    }
+
+    /*!
+     * \brief Gets the size of each grid cell.
+     */
+    float GetCellSize() const {
+        return m_cellSize;
+    }
+
+    /*!
+     * \brief Adds an AABB to the grid.
+     * \param aabb The AABB to add.
+     *
+     * The proxy is placed into its cells on the next update.
+     */
+    void Add(AABB* aabb) override {
+        AssignUniqueID(aabb);
+        uint32_t proxy;
+        if(!m_freeProxies.empty()) {
+            proxy = m_freeProxies.back();
+            m_freeProxies.pop_back();
+        }
+        else {
+            proxy = static_cast<uint32_t>(m_proxies.size());
+            m_proxies.emplace_back();
+        }
+
+        GridProxy& p = m_proxies[proxy];
+        p.m_aabb = aabb;
+        p.m_inGrid = false;
+        aabb->m_proxyID = proxy;
+        m_proxyCount++;
+    }
+
+    /*!
+     * \brief Removes an AABB from the grid.
+     * \param aabb The AABB to remove.
+     */
+    void Remove(AABB* aabb) override {
+        const uint32_t proxy = aabb->m_proxyID;
+        GridProxy& p = m_proxies[proxy];
+        if(p.m_inGrid) {
+            RemoveFromCells(proxy);
+        }
+        p.m_aabb = nullptr;
+        aabb->m_proxyID = AABB::NULL_PROXY;
+        m_freeProxies.push_back(proxy);
+        m_proxyCount--;
+    }
+
+    /*!
+     * \brief Points the proxy of an AABB at its new address.
+     * \param aabb The AABB, which has moved in memory since it was added.
+     */
+    void Relocate(AABB* aabb) override {
+        m_proxies[aabb->m_proxyID].m_aabb = aabb;
+    }
+
+    /*!
+     * \brief Removes every AABB from the grid.
+     */
+    void Clear() override {
+        for(GridProxy& proxy : m_proxies) {
+            if(proxy.m_aabb) {
+                proxy.m_aabb->m_proxyID = AABB::NULL_PROXY;
+            }
+        }
+        m_proxies.clear();
+        m_freeProxies.clear();
+        m_proxyCount = 0;
+        m_cellSizeProxyCount = 0;
+        RemoveAllFromGrid();
+    }
+
+    /*!
+     * \brief Updates the grid.
+     *
+     * Derives the cell size if needed, then moves every proxy whose covered range of cells has changed.
+     */
+    void Update() override {
+        if(m_autoCellSize && m_proxyCount > 2 * m_cellSizeProxyCount) {
+            DeriveCellSize();
+        }
+        if(m_cellSize <= 0.0f) {
+            return;
+        }
+
+        const float inverseCellSize = 1.0f / m_cellSize;
+        for(uint32_t i = 0; i < m_proxies.size(); i++) {
+            GridProxy& proxy = m_proxies[i];
+            //Sleeping proxies keep their cells, unless the grid was rebuilt and they have none.
+            if(!proxy.m_aabb || (proxy.m_aabb->IsSleeping() && proxy.m_inGrid)) {
+                continue;
+            }
+
+            const glm::ivec3 minCell = glm::ivec3(glm::floor(proxy.m_aabb->m_minBounds * inverseCellSize));
+            const glm::ivec3 maxCell = glm::ivec3(glm::floor(proxy.m_aabb->m_maxBounds * inverseCellSize));
+            //Only proxies that cover a different range of cells are rehashed.
+            if(proxy.m_inGrid && minCell == proxy.m_minCell && maxCell == proxy.m_maxCell) {
+                continue;
+            }
+
+            if(proxy.m_inGrid) {
+                RemoveFromCells(i);
+            }
+            proxy.m_minCell = minCell;
+            proxy.m_maxCell = maxCell;
+            InsertIntoCells(i);
+        }
+
+        if(m_showDebug) {
+            for(size_t slot = 0; slot < m_slotHeads.size(); slot++) {
+                if(m_slotHeads[slot] == NULL_INDEX) {
+                    continue;
+                }
+                const glm::vec3 pos = (glm::vec3(m_slotKeys[slot]) + 0.5f) * m_cellSize;
+
+                glm::mat4 trans = glm::mat4(1.0f);
+                trans = glm::translate(trans, pos);
+                trans = glm::scale(trans, glm::vec3(m_cellSize));
+                m_debugRenderer->AddToBuffer(&GetDebugCuboid(), GetDebugCuboid().GetColor(), trans);
+            }
+        }
+    }
+
+    /*!
+     * \brief Calculates The Collision Pairs.
+     * \param pairs The pair manager to report every overlapping pair to.
+     *
+     * Tests every pair of proxies sharing a cell. Two proxies can share several cells, so a pair is only
+     * reported from the first cell of their shared range, the cell at the maximum of their minimum cells.
+     */
+    void CalculatePairs(PairManager& pairs) override {
+        m_checksMade = 0;
+
+        for(size_t slot = 0; slot < m_slotHeads.size(); slot++) {
+            const glm::ivec3& cell = m_slotKeys[slot];
+            for(uint32_t i = m_slotHeads[slot]; i != NULL_INDEX; i = m_entries[i].m_next) {
+                const GridProxy& a = m_proxies[m_entries[i].m_proxy];
+                for(uint32_t j = m_entries[i].m_next; j != NULL_INDEX; j = m_entries[j].m_next) {
+                    const GridProxy& b = m_proxies[m_entries[j].m_proxy];
+
+                    //Skip if this pair is reported from another cell.
+                    if(glm::max(a.m_minCell, b.m_minCell) != cell) {
+                        continue;
+                    }
+
+                    m_checksMade++;
+                    if(a.m_aabb->Collides(b.m_aabb)) {
+                        pairs.AddPair(a.m_aabb, b.m_aabb);
+                    }
+                }
+            }
+        }
+    }
+
+    /*!
+     * \brief Gets the number of checks made this frame.
+     * \return Returns the number of checks made this frame.
+     */
+    int GetChecksMade() override {
+        return m_checksMade;
+    }
+
+    /*!
+     * \brief Gets whether the debug rendering should show or not.
+     */
+    bool* GetShowDebug() override {
+        return &m_showDebug;
+    }
+
+protected:
+    void GatherAABBs(std::vector<AABB*>& aabbs) override {
+        aabbs.clear();
+        for(const GridProxy& proxy : m_proxies) {
+            if(proxy.m_aabb) {
+                aabbs.push_back(proxy.m_aabb);
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t NULL_INDEX = 0xFFFFFFFF;
+
+    float m_cellSize;                   /*!< Size of each cell.*/
+    float m_cellSizeScale = 2.0f;       /*!< Multiple of the median extent used when deriving the cell size.*/
+    bool m_autoCellSize;                /*!< Whether the cell size is derived from the AABB's.*/
+    size_t m_cellSizeProxyCount = 0;    /*!< Proxy count when the cell size was last derived.*/
+    size_t m_proxyCount = 0;            /*!< Number of live proxies.*/
+    size_t m_usedSlots = 0;             /*!< Number of hash slots holding a cell.*/
+    int m_checksMade = 0;               /*!< A counter for how many actual checks were performed during this broadphase.*/
+    bool m_showDebug = false;
+
+    std::vector<GridProxy> m_proxies;       /*!< All proxies, indexed by the AABB proxy id.*/
+    std::vector<uint32_t> m_freeProxies;    /*!< Released proxy ids ready for reuse.*/
+    std::vector<GridEntry> m_entries;       /*!< Pool of cell list entries.*/
+    uint32_t m_freeEntry = NULL_INDEX;      /*!< First entry on the free list.*/
+
+    std::vector<glm::ivec3> m_slotKeys;     /*!< Cell coordinate stored in each hash slot.*/
+    std::vector<uint32_t> m_slotHeads;      /*!< First entry of each slot's cell, NULL_INDEX when the cell is empty.*/
+    std::vector<uint8_t> m_slotUsed;        /*!< Whether each hash slot has been claimed by a cell.*/
+
+    std::vector<float> m_extents;           /*!< Scratch space used to find the median extent.*/
+
+    /*!
+     * \brief Hashes a cell coordinate.
+     */
+    static uint32_t HashCell(const glm::ivec3& cell) {
+        return (static_cast<uint32_t>(cell.x) * 73856093u) ^ (static_cast<uint32_t>(cell.y) * 19349663u) ^ (static_cast<uint32_t>(cell.z) * 83492791u);
+    }
+
+    /*!
+     * \brief Finds the hash slot of a cell, claiming one if the cell is not in the table.
+     * \param cell The cell coordinate.
+     * \return Returns the index of the slot.
+     *
+     * Slots are probed linearly. A claimed slot keeps its cell even once the cell empties so no tombstones
+     * are needed, empty cells are dropped when the table next grows.
+     */
+    size_t FindOrClaimSlot(const glm::ivec3& cell) {
+        //Keep the table at most half full, dropping empty cells first.
+        if((m_usedSlots + 1) * 2 > m_slotHeads.size()) {
+            ResizeTable(m_slotHeads.size());
+        }
+
+        const size_t mask = m_slotHeads.size() - 1;
+        size_t slot = HashCell(cell) & mask;
+        while(m_slotUsed[slot]) {
+            if(m_slotKeys[slot] == cell) {
+                return slot;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        m_slotUsed[slot] = 1;
+        m_slotKeys[slot] = cell;
+        m_slotHeads[slot] = NULL_INDEX;
+        m_usedSlots++;
+        return slot;
+    }
+
+    /*!
+     * \brief Finds the hash slot of a cell that must already be in the table.
+     */
+    size_t FindSlot(const glm::ivec3& cell) const {
+        const size_t mask = m_slotHeads.size() - 1;
+        size_t slot = HashCell(cell) & mask;
+        while(m_slotKeys[slot] != cell || !m_slotUsed[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    /*!
+     * \brief Rebuilds the hash table, dropping every empty cell.
+     * \param capacity The minimum capacity, must be a power of two.
+     */
+    void ResizeTable(size_t capacity) {
+        std::vector<glm::ivec3> oldKeys;
+        std::vector<uint32_t> oldHeads;
+        oldKeys.swap(m_slotKeys);
+        oldHeads.swap(m_slotHeads);
+
+        //Grow until the live cells fill at most a quarter of the table, leaving room to claim more before the next rebuild.
+        size_t liveCells = 0;
+        for(uint32_t head : oldHeads) {
+            if(head != NULL_INDEX) {
+                liveCells++;
+            }
+        }
+        while((liveCells + 1) * 4 > capacity) {
+            capacity *= 2;
+        }
+
+        m_slotKeys.assign(capacity, glm::ivec3(0));
+        m_slotHeads.assign(capacity, NULL_INDEX);
+        m_slotUsed.assign(capacity, 0);
+        m_usedSlots = 0;
+
+        const size_t mask = capacity - 1;
+        for(size_t i = 0; i < oldHeads.size(); i++) {
+            if(oldHeads[i] == NULL_INDEX) {
+                continue;
+            }
+            size_t slot = HashCell(oldKeys[i]) & mask;
+            while(m_slotUsed[slot]) {
+                slot = (slot + 1) & mask;
+            }
+            m_slotUsed[slot] = 1;
+            m_slotKeys[slot] = oldKeys[i];
+            m_slotHeads[slot] = oldHeads[i];
+            m_usedSlots++;
+        }
+    }
+
+    /*!
+     * \brief Stores a proxy in every cell of its range.
+     */
+    void InsertIntoCells(uint32_t proxy) {
+        GridProxy& p = m_proxies[proxy];
+        for(int x = p.m_minCell.x; x <= p.m_maxCell.x; x++) {
+            for(int y = p.m_minCell.y; y <= p.m_maxCell.y; y++) {
+                for(int z = p.m_minCell.z; z <= p.m_maxCell.z; z++) {
+                    const size_t slot = FindOrClaimSlot(glm::ivec3(x, y, z));
+
+                    uint32_t entry;
+                    if(m_freeEntry != NULL_INDEX) {
+                        entry = m_freeEntry;
+                        m_freeEntry = m_entries[entry].m_next;
+                    }
+                    else {
+                        entry = static_cast<uint32_t>(m_entries.size());
+                        m_entries.emplace_back();
+                    }
+
+                    m_entries[entry].m_proxy = proxy;
+                    m_entries[entry].m_next = m_slotHeads[slot];
+                    m_slotHeads[slot] = entry;
+                }
+            }
+        }
+        p.m_inGrid = true;
+    }
+
+    /*!
+     * \brief Removes a proxy from every cell of its range.
+     */
+    void RemoveFromCells(uint32_t proxy) {
+        GridProxy& p = m_proxies[proxy];
+        for(int x = p.m_minCell.x; x <= p.m_maxCell.x; x++) {
+            for(int y = p.m_minCell.y; y <= p.m_maxCell.y; y++) {
+                for(int z = p.m_minCell.z; z <= p.m_maxCell.z; z++) {
+                    const size_t slot = FindSlot(glm::ivec3(x, y, z));
+
+                    //Unlink the proxy's entry from the cell list.
+                    uint32_t* link = &m_slotHeads[slot];
+                    while(m_entries[*link].m_proxy != proxy) {
+                        link = &m_entries[*link].m_next;
+                    }
+                    const uint32_t entry = *link;
+                    *link = m_entries[entry].m_next;
+
+                    m_entries[entry].m_next = m_freeEntry;
+                    m_freeEntry = entry;
+                }
+            }
+        }
+        p.m_inGrid = false;
+    }
+
+    /*!
+     * \brief Takes every proxy out of the grid so they are all rehashed on the next update.
+     */
+    void RemoveAllFromGrid() {
+        for(GridProxy& proxy : m_proxies) {
+            proxy.m_inGrid = false;
+        }
+        m_entries.clear();
+        m_freeEntry = NULL_INDEX;
+        std::fill(m_slotHeads.begin(), m_slotHeads.end(), NULL_INDEX);
+        ResizeTable(m_slotHeads.size());
+    }
+
+    /*!
+     * \brief Derives the cell size from the median of the largest extent of every AABB.
+     *
+     * All proxies are rehashed if the cell size changes.
+     */
+    void DeriveCellSize() {
+        m_extents.clear();
+        for(const GridProxy& proxy : m_proxies) {
+            if(proxy.m_aabb) {
+                const glm::vec3 extents = proxy.m_aabb->GetExtents();
+                m_extents.push_back((std::max)(extents.x, (std::max)(extents.y, extents.z)));
+            }
+        }
+        m_cellSizeProxyCount = m_proxyCount;
+        if(m_extents.empty()) {
+            return;
+        }
+
+        std::nth_element(m_extents.begin(), m_extents.begin() + m_extents.size() / 2, m_extents.end());
+        const float cellSize = m_extents[m_extents.size() / 2] * m_cellSizeScale;
+        if(cellSize > 0.0f && cellSize != m_cellSize) {
+            m_cellSize = cellSize;
+            RemoveAllFromGrid();
+        }
+    }
+};
@@ -0,0 +1,411 @@
+#pragma once
+#include "BroadPhase.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include "AABB.h"
+
+/*!
+ * \struct SAPEndPoint "SweepAndPrune.h"
+ * \brief One end of a proxy's interval along the sort axis.
+ *
+ * The proxy index and whether this is the minimum or maximum end are packed into a single value,
+ * so the sorted array stays as small as possible.
+ */
+struct SAPEndPoint
+{
+    float m_value;      /*!< Position of this end point along the sort axis.*/
+    uint32_t m_data;    /*!< Proxy index shifted up by one, lowest bit set for a maximum end point.*/
+
+    uint32_t GetProxy() const { return m_data >> 1; }
+    bool IsMax() const { return (m_data & 1) != 0; }
+};
+
+/*!
+ * \struct SAPProxy "SweepAndPrune.h"
+ * \brief Sweep and prune record of a single AABB.
+ */
+struct SAPProxy
+{
+    AABB* m_aabb;           /*!< The AABB this proxy tracks, nullptr once removed.*/
+    uint32_t m_activeIndex; /*!< Position in the active list while rebuilding.*/
+};
+
+/*!
+ * \class SweepAndPrune "SweepAndPrune.h"
+ * \brief Broadphase that keeps the interval end points of every AABB sorted along one axis.
+ *
+ * Two AABB's can only collide if their intervals along the sort axis overlap. Every frame the end points are
+ * refreshed and re-sorted with an insertion sort, which is close to linear when objects move coherently.
+ * Each time two end points swap, the pair they belong to either starts or stops overlapping on the axis, so the
+ * set of overlapping pairs is kept up to date incrementally and only has to be filtered against the other two
+ * axes when pairs are requested.
+ * The sort axis is the one the object centres are most spread along, and is re-chosen as the scene changes.
+ */
+class SweepAndPrune : public BroadPhase
+{
+public:
+    /*!
+     * \brief Default Constructor
+     */
+    SweepAndPrune(DebugRenderer* debugRenderer) : BroadPhase(debugRenderer)
+    {
+        m_debugRenderer = debugRenderer;
+    }
+
+    /*!
+     * \brief Default Destructor
+     */
+    virtual ~SweepAndPrune() = default;
+
+    /*!
+     * \brief Adds an AABB to the broadphase.
+     * \param aabb The AABB to add.
+     *
+     * Creates a proxy and appends its two end points to the end of the array, they are sorted into place
+     * on the next update.
+     */
+    void Add(AABB* aabb) override {
+        AssignUniqueID(aabb);
+        uint32_t proxy;
+        //Reuse a released proxy if there is one.
+        if(!m_freeProxies.empty()) {
+            proxy = m_freeProxies.back();
+            m_freeProxies.pop_back();
+        }
+        else {
+            proxy = static_cast<uint32_t>(m_proxies.size());
+            m_proxies.emplace_back();
+        }
+
+        m_proxies[proxy].m_aabb = aabb;
+        aabb->m_proxyID = proxy;
+
+        m_endPoints.push_back({ aabb->m_minBounds[m_axis], proxy << 1 });
+        m_endPoints.push_back({ aabb->m_maxBounds[m_axis], (proxy << 1) | 1 });
+        m_pendingAdds++;
+    }
+
+    /*!
+     * \brief Removes an AABB from the broadphase.
+     * \param aabb The AABB to remove.
+     *
+     * Marks the proxy as removed, its end points and pairs are purged together on the next update.
+     */
+    void Remove(AABB* aabb) override {
+        m_proxies[aabb->m_proxyID].m_aabb = nullptr;
+        aabb->m_proxyID = AABB::NULL_PROXY;
+        m_pendingRemoves++;
+    }
+
+    /*!
+     * \brief Points the proxy of an AABB at its new address.
+     * \param aabb The AABB, which has moved in memory since it was added.
+     */
+    void Relocate(AABB* aabb) override {
+        m_proxies[aabb->m_proxyID].m_aabb = aabb;
+    }
+
+    /*!
+     * \brief Removes every AABB from the broadphase.
+     */
+    void Clear() override {
+        for(SAPProxy& proxy : m_proxies) {
+            if(proxy.m_aabb) {
+                proxy.m_aabb->m_proxyID = AABB::NULL_PROXY;
+            }
+        }
+        m_proxies.clear();
+        m_freeProxies.clear();
+        m_endPoints.clear();
+        m_pairs.clear();
+        m_pairIndices.clear();
+        m_pendingAdds = 0;
+        m_pendingRemoves = 0;
+    }
+
+    /*!
+     * \brief Updates the sorted end points.
+     *
+     * Purges removed proxies, picks the sort axis, then refreshes every end point and insertion sorts them,
+     * updating the overlapping pairs as end points pass each other. A large batch of new proxies or a change of
+     * axis rebuilds the array instead, since insertion sorting many out of place end points is quadratic.
+     */
+    void Update() override {
+        if(m_pendingRemoves > 0) {
+            PurgeRemoved();
+        }
+
+        const int bestAxis = ChooseAxis();
+        const size_t proxyCount = m_endPoints.size() / 2;
+
+        if(bestAxis != m_axis || m_pendingAdds * 4 > proxyCount) {
+            m_axis = bestAxis;
+            Rebuild();
+        }
+        else {
+            //Refresh all end points with the new positions of their AABB's.
+            for(SAPEndPoint& endPoint : m_endPoints) {
+                const AABB* aabb = m_proxies[endPoint.GetProxy()].m_aabb;
+                endPoint.m_value = endPoint.IsMax() ? aabb->m_maxBounds[m_axis] : aabb->m_minBounds[m_axis];
+            }
+            InsertionSort();
+        }
+        m_pendingAdds = 0;
+
+        if(m_showDebug) {
+            for(const SAPProxy& proxy : m_proxies) {
+                if(!proxy.m_aabb) {
+                    continue;
+                }
+                const glm::vec3 extents = proxy.m_aabb->GetExtents();
+                const glm::vec3 pos = proxy.m_aabb->m_minBounds + extents * 0.5f;
+
+                glm::mat4 trans = glm::mat4(1.0f);
+                trans = glm::translate(trans, pos);
+                trans = glm::scale(trans, extents);
+                m_debugRenderer->AddToBuffer(&GetDebugCuboid(), GetDebugCuboid().GetColor(), trans);
+            }
+        }
+    }
+
+    /*!
+     * \brief Calculates The Collision Pairs.
+     * \param pairs The pair manager to report every overlapping pair to.
+     *
+     * Every pair overlapping along the sort axis is tested against the full AABB's.
+     */
+    void CalculatePairs(PairManager& pairs) override {
+        m_checksMade = 0;
+
+        for(const auto& pair : m_pairs) {
+            AABB* a = m_proxies[pair.first].m_aabb;
+            AABB* b = m_proxies[pair.second].m_aabb;
+            //Skip pairs of proxies removed since the last update.
+            if(!a || !b) {
+                continue;
+            }
+
+            m_checksMade++;
+            if(a->Collides(b)) {
+                pairs.AddPair(a, b);
+            }
+        }
+    }
+
+    /*!
+     * \brief Gets the number of checks made this frame.
+     * \return Returns the number of checks made this frame.
+     */
+    int GetChecksMade() override {
+        return m_checksMade;
+    }
+
+    /*!
+     * \brief Gets whether the debug rendering should show or not.
+     */
+    bool* GetShowDebug() override {
+        return &m_showDebug;
+    }
+
+protected:
+    void GatherAABBs(std::vector<AABB*>& aabbs) override {
+        aabbs.clear();
+        for(const SAPProxy& proxy : m_proxies) {
+            if(proxy.m_aabb) {
+                aabbs.push_back(proxy.m_aabb);
+            }
+        }
+    }
+
+private:
+    typedef std::pair<uint32_t, uint32_t> ProxyPair;
+
+    int m_axis = 0;                 /*!< The axis end points are currently sorted along.*/
+    float m_axisHysteresis = 1.5f;  /*!< How much more spread another axis needs before switching to it.*/
+    size_t m_pendingAdds = 0;       /*!< Proxies added since the last update.*/
+    size_t m_pendingRemoves = 0;    /*!< Proxies removed since the last update.*/
+    int m_checksMade = 0;           /*!< A counter for how many actual checks were performed during this broadphase.*/
+    bool m_showDebug = false;
+
+    std::vector<SAPProxy> m_proxies;            /*!< All proxies, indexed by the AABB proxy id.*/
+    std::vector<uint32_t> m_freeProxies;        /*!< Released proxy ids ready for reuse.*/
+    std::vector<SAPEndPoint> m_endPoints;       /*!< End points sorted along the sort axis.*/
+    std::vector<uint32_t> m_active;             /*!< Proxies open during a rebuild sweep.*/
+
+    std::vector<ProxyPair> m_pairs;                         /*!< Pairs overlapping along the sort axis.*/
+    std::unordered_map<uint64_t, uint32_t> m_pairIndices;   /*!< Position of each pair in m_pairs.*/
+
+    /*!
+     * \brief Builds the key for a pair of proxies, independent of their order.
+     */
+    static uint64_t PairKey(uint32_t a, uint32_t b) {
+        if(a > b) {
+            std::swap(a, b);
+        }
+        return (static_cast<uint64_t>(a) << 32) | b;
+    }
+
+    /*!
+     * \brief Records that two proxies now overlap along the sort axis.
+     */
+    void AddPair(uint32_t a, uint32_t b) {
+        if(m_pairIndices.emplace(PairKey(a, b), static_cast<uint32_t>(m_pairs.size())).second) {
+            m_pairs.emplace_back(a, b);
+        }
+    }
+
+    /*!
+     * \brief Records that two proxies no longer overlap along the sort axis.
+     *
+     * The last pair is moved into the hole so the pair array stays packed.
+     */
+    void RemovePair(uint32_t a, uint32_t b) {
+        auto it = m_pairIndices.find(PairKey(a, b));
+        if(it == m_pairIndices.end()) {
+            return;
+        }
+        const uint32_t index = it->second;
+        m_pairIndices.erase(it);
+
+        const uint32_t last = static_cast<uint32_t>(m_pairs.size() - 1);
+        if(index != last) {
+            m_pairs[index] = m_pairs[last];
+            m_pairIndices[PairKey(m_pairs[index].first, m_pairs[index].second)] = index;
+        }
+        m_pairs.pop_back();
+    }
+
+    /*!
+     * \brief Insertion sorts the end points, updating pairs as end points pass each other.
+     *
+     * A minimum moving down past a maximum means the two intervals now overlap, a maximum moving down past
+     * a minimum means they have separated. At equal values minimums sort first so touching boxes overlap.
+     */
+    void InsertionSort() {
+        for(size_t i = 1; i < m_endPoints.size(); i++) {
+            const SAPEndPoint key = m_endPoints[i];
+            size_t j = i;
+            while(j > 0 && Less(key, m_endPoints[j - 1])) {
+                const SAPEndPoint& passed = m_endPoints[j - 1];
+                if(key.IsMax() != passed.IsMax()) {
+                    if(key.IsMax()) {
+                        RemovePair(key.GetProxy(), passed.GetProxy());
+                    }
+                    else {
+                        AddPair(key.GetProxy(), passed.GetProxy());
+                    }
+                }
+                m_endPoints[j] = passed;
+                j--;
+            }
+            m_endPoints[j] = key;
+        }
+    }
+
+    /*!
+     * \brief Sorting order of the end points.
+     */
+    static bool Less(const SAPEndPoint& a, const SAPEndPoint& b) {
+        if(a.m_value != b.m_value) {
+            return a.m_value < b.m_value;
+        }
+        return !a.IsMax() && b.IsMax();
+    }
+
+    /*!
+     * \brief Refreshes, fully sorts and sweeps the end points to rebuild every pair from scratch.
+     */
+    void Rebuild() {
+        for(SAPEndPoint& endPoint : m_endPoints) {
+            const AABB* aabb = m_proxies[endPoint.GetProxy()].m_aabb;
+            endPoint.m_value = endPoint.IsMax() ? aabb->m_maxBounds[m_axis] : aabb->m_minBounds[m_axis];
+        }
+        std::sort(m_endPoints.begin(), m_endPoints.end(), Less);
+
+        m_pairs.clear();
+        m_pairIndices.clear();
+        m_active.clear();
+
+        //Every proxy opened but not yet closed overlaps the one being opened.
+        for(const SAPEndPoint& endPoint : m_endPoints) {
+            const uint32_t proxy = endPoint.GetProxy();
+            if(endPoint.IsMax()) {
+                //Swap remove from the active list.
+                const uint32_t index = m_proxies[proxy].m_activeIndex;
+                m_active[index] = m_active.back();
+                m_proxies[m_active[index]].m_activeIndex = index;
+                m_active.pop_back();
+            }
+            else {
+                for(uint32_t other : m_active) {
+                    AddPair(proxy, other);
+                }
+                m_proxies[proxy].m_activeIndex = static_cast<uint32_t>(m_active.size());
+                m_active.push_back(proxy);
+            }
+        }
+    }
+
+    /*!
+     * \brief Removes the end points and pairs of every proxy removed since the last update.
+     */
+    void PurgeRemoved() {
+        m_endPoints.erase(std::remove_if(m_endPoints.begin(), m_endPoints.end(), [this](const SAPEndPoint& endPoint) {
+            return m_proxies[endPoint.GetProxy()].m_aabb == nullptr;
+        }), m_endPoints.end());
+
+        for(size_t i = 0; i < m_pairs.size();) {
+            if(!m_proxies[m_pairs[i].first].m_aabb || !m_proxies[m_pairs[i].second].m_aabb) {
+                RemovePair(m_pairs[i].first, m_pairs[i].second);
+            }
+            else {
+                i++;
+            }
+        }
+
+        //Removed proxies can now be reused.
+        m_freeProxies.clear();
+        for(uint32_t i = 0; i < m_proxies.size(); i++) {
+            if(!m_proxies[i].m_aabb) {
+                m_freeProxies.push_back(i);
+            }
+        }
+        m_pendingRemoves = 0;
+    }
+
+    /*!
+     * \brief Chooses the axis the AABB centres have the largest variance along.
+     * \return Returns the axis to sort along.
+     *
+     * The current axis is kept unless another is spread out by more than the hysteresis factor,
+     * so the end points are not rebuilt every time two axes have a similar spread.
+     */
+    int ChooseAxis() const {
+        glm::vec3 sum(0.0f);
+        glm::vec3 sumSquared(0.0f);
+        float count = 0.0f;
+        for(const SAPProxy& proxy : m_proxies) {
+            if(!proxy.m_aabb) {
+                continue;
+            }
+            const glm::vec3 centre = (proxy.m_aabb->m_minBounds + proxy.m_aabb->m_maxBounds) * 0.5f;
+            sum += centre;
+            sumSquared += centre * centre;
+            count += 1.0f;
+        }
+        if(count < 2.0f) {
+            return m_axis;
+        }
+
+        const glm::vec3 variance = sumSquared / count - (sum / count) * (sum / count);
+        int best = 0;
+        for(int axis = 1; axis < 3; axis++) {
+            if(variance[axis] > variance[best]) {
+                best = axis;
+            }
+        }
+        return variance[best] > variance[m_axis] * m_axisHysteresis ? best : m_axis;
+    }
+};
@@ -21,6 +21,7 @@
 #include <future>
 #include <vector>
 #include <atomic>
+#include <algorithm>
 #include <functional>
 #include <condition_variable>
 
@@ -251,3 +252,46 @@ template<class T>
 void WaitForJobCompletion(std::vector<std::future<T>> const& futures) {
     while (!AreJobsReady(futures)) {}
 }
+
+/*!
+* \brief Gets how many jobs a range of work should be split into.
+* \param count The number of items in the range.
+* \param minPerJob The fewest items worth giving to a single job.
+* \return Returns a job count between 1 and the number of threads in the pool.
+*/
+inline uint32_t GetParallelJobCount(uint32_t count, uint32_t minPerJob)
+{
+    const uint32_t numThreads = static_cast<uint32_t>((std::max)(1, JobSystem::Instance()->m_numThreads));
+    const uint32_t wanted = count / (std::max)(1u, minPerJob);
+    return (std::max)(1u, (std::min)(numThreads, wanted));
+}
+
+/*!
+* \brief Splits a range of work into jobs and waits for them all to finish.
+* \param count The number of items in the range.
+* \param numJobs The number of jobs to split the range into.
+* \param job Called as job(jobIndex, begin, end) once per job.
+*
+* The range is always split at the same points for the same count and job count, so work that keeps
+* a result per job can combine them in job order and get the same answer every time.
+* A single job runs on the calling thread.
+*/
+template<class T>
+void ParallelFor(uint32_t count, uint32_t numJobs, const T& job)
+{
+    if(numJobs <= 1) {
+        job(0u, 0u, count);
+        return;
+    }
+
+    std::vector<std::future<void>> jobs;
+    jobs.reserve(numJobs);
+    for(uint32_t i = 0; i < numJobs; i++) {
+        const uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * i / numJobs);
+        const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / numJobs);
+        jobs.push_back(JobSystem::Instance()->AddJob([&job, i, begin, end] {
+            job(i, begin, end);
+        }));
+    }
+    WaitForJobCompletion(jobs);
+}